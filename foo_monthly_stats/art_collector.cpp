@@ -0,0 +1,346 @@
+#include "stdafx.h"
+#include "art_collector.h"
+#include "base64.h"
+#include "library_index.h"
+#include "preferences.h"
+#include "thumbnail.h"
+#include "thumbnail_cache.h"
+
+namespace fms
+{
+
+    // ---------------------------------------------------------------------------
+    // Helper: check if file path exists using filesystem
+    // ---------------------------------------------------------------------------
+    static bool filePathExists(const char *path, abort_callback &abort)
+    {
+        try
+        {
+            auto fs = filesystem::get(path);
+            if (fs.is_valid())
+            {
+                return fs->file_exists(path, abort);
+            }
+        }
+        catch (const exception_aborted &)
+        {
+            throw;
+        }
+        catch (...)
+        {
+        }
+        return false;
+    }
+
+    // Cover as embedded in the report: a JPEG thumbnail of at most artSize pixels,
+    // or the original image under its real MIME type when that is smaller or
+    // cannot be decoded; false for data that is no known image
+    static bool coverImage(const void *data, size_t size, Thumbnailer &thumbnailer, int artSize,
+                           ThumbnailCache::Entry &cover)
+    {
+        std::vector<uint8_t> jpeg;
+        if (thumbnailer.makeJpeg(data, size, artSize, jpeg) && jpeg.size() < size)
+        {
+            cover.mime = "image/jpeg";
+            cover.data.assign(jpeg.begin(), jpeg.end());
+            return true;
+        }
+        const char *mime = sniffImageMime(data, size);
+        if (!mime)
+            return false;
+        cover.mime = mime;
+        cover.data.assign(static_cast<const char *>(data), size);
+        return true;
+    }
+
+    static std::string dataUri(const ThumbnailCache::Entry &cover)
+    {
+        std::string uri = "data:" + cover.mime + ";base64,";
+        base64Append(uri, cover.data.data(), cover.data.size());
+        return uri;
+    }
+
+    // Front cover of one track; false when it has none. Records the track as the
+    // cover's source for the thumbnail cache.
+    static bool frontCover(const metadb_handle_ptr &track, abort_callback &abort, Thumbnailer &thumbnailer, int artSize,
+                           ThumbnailCache::Entry &cover)
+    {
+        metadb_handle_list handles;
+        handles.add_item(track);
+        pfc::list_single_ref_t<GUID> types(album_art_ids::cover_front);
+        auto inst = album_art_manager_v2::get()->open(handles, types, abort);
+        if (!inst.is_valid())
+            return false;
+        album_art_data_ptr data = inst->query(album_art_ids::cover_front, abort);
+        if (!data.is_valid() || data->get_size() == 0)
+            return false;
+        if (!coverImage(data->get_ptr(), data->get_size(), thumbnailer, artSize, cover))
+            return false;
+        cover.source = track->get_path();
+        return true;
+    }
+
+    // ---------------------------------------------------------------------------
+    // Thumbnail cache (thumbnail_cache.h)
+    // ---------------------------------------------------------------------------
+
+    // Tracks of one album share a cover; tracks without album tags are looked up by file
+    static std::string albumIdentity(const MonthlyEntry &e)
+    {
+        if (!e.album.empty())
+            return e.artist + '\x1f' + e.album;
+        return e.path;
+    }
+
+    // Stats of the file as the metadb last saw it: no file system access
+    static void sourceStats(const char *path, int64_t &size, int64_t &time)
+    {
+        const t_filestats stats = metadb::get()->handle_create(path, 0)->get_filestats();
+        size = static_cast<int64_t>(stats.m_size);
+        time = static_cast<int64_t>(stats.m_timestamp);
+    }
+
+    // Cached cover still valid for its source file? ("" in uri: no cover)
+    static bool cachedCover(const std::string &identity, int artSize, std::string &uri)
+    {
+        ThumbnailCache::Entry cached;
+        if (!ThumbnailCache::get().find(identity, artSize, cached) || cached.source.empty())
+            return false;
+        int64_t size = 0, time = 0;
+        sourceStats(cached.source.c_str(), size, time);
+        if (size != cached.sourceSize || time != cached.sourceTime)
+            return false;
+        uri = cached.mime.empty() ? std::string() : dataUri(cached);
+        return true;
+    }
+
+    static void storeCover(const std::string &identity, int artSize, ThumbnailCache::Entry &cover)
+    {
+        if (cover.source.empty())
+            return;
+        sourceStats(cover.source.c_str(), cover.sourceSize, cover.sourceTime);
+        ThumbnailCache::get().store(identity, artSize, cover);
+    }
+
+    // ---------------------------------------------------------------------------
+    // Album art of one entry (any thread); exception_aborted propagates
+    // ---------------------------------------------------------------------------
+    static std::string findArt(const MonthlyEntry &e, const LibraryIndex &library, abort_callback &abort,
+                               Thumbnailer &thumbnailer, int artSize)
+    {
+        // Step 0: Unchanged album already in the thumbnail cache: no art I/O at all
+        const std::string identity = albumIdentity(e);
+        std::string cachedUri;
+        if (cachedCover(identity, artSize, cachedUri))
+        {
+            FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Cached album art for: " << e.title;
+            return cachedUri;
+        }
+
+        metadb_handle_ptr h;
+
+        // Step 1: Try to create handle from stored path, but verify file exists
+        if (!e.path.empty())
+        {
+            try
+            {
+                if (filePathExists(e.path.c_str(), abort))
+                {
+                    h = metadb::get()->handle_create(e.path.c_str(), 0);
+                    FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Using path handle for: " << e.path;
+                }
+                else
+                {
+                    FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Path file does not exist: " << e.path;
+                }
+            }
+            catch (const exception_aborted &)
+            {
+                throw;
+            }
+            catch (const std::exception &ex)
+            {
+                FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Path validation failed: " << ex.what() << " (path: " << e.path << ")";
+                h = nullptr;
+            }
+        }
+
+        // Step 2: If path failed or file doesn't exist, search library by metadata
+        if (!h.is_valid())
+        {
+            FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Searching library for: '" << e.title << "' - '"
+                                                        << e.artist << "' - '" << e.album << "'";
+
+            // Exact match with trimmed strings, then case-insensitive
+            h = library.find(e.title, e.artist, e.album);
+            if (!h.is_valid())
+            {
+                FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Track not found in library after metadata search";
+                return "";
+            }
+            FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Found match in library: " << h->get_path();
+        }
+
+        // "No cover" is cached against the resolved track, unless a read failed
+        ThumbnailCache::Entry none;
+        none.source = h->get_path();
+
+        // Step 3: Now we have a valid handle, try to get album art
+        ThumbnailCache::Entry cover;
+        try
+        {
+            if (frontCover(h, abort, thumbnailer, artSize, cover))
+            {
+                FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Got album art for: " << e.title;
+                storeCover(identity, artSize, cover);
+                return dataUri(cover);
+            }
+            FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] No album art data for: " << e.title;
+        }
+        catch (const exception_aborted &)
+        {
+            throw;
+        }
+        catch (const std::exception &ex)
+        {
+            FMS_LOG(LogLevel::Warning, LogCategory::Art) << "[fms] Exception getting art for " << e.title << ": " << ex.what();
+            none.source.clear();
+        }
+
+        // Step 4: If art not obtained, try fallback search for alternative versions of the same track
+        if (e.title.empty() || e.artist.empty())
+        {
+            storeCover(identity, artSize, none);
+            return "";
+        }
+        FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Attempting fallback search for alternative versions: '"
+                                                    << e.title << "' by '" << e.artist << "'";
+
+        // Alternative tracks with same title and artist (possibly different album)
+        for (const auto &altItem : library.findByTitleArtist(e.title, e.artist))
+        {
+            try
+            {
+                if (frontCover(altItem, abort, thumbnailer, artSize, cover))
+                {
+                    FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Got album art from fallback (alt album): " << e.title;
+                    storeCover(identity, artSize, cover);
+                    return dataUri(cover);
+                }
+            }
+            catch (const exception_aborted &)
+            {
+                throw;
+            }
+            catch (const std::exception &)
+            {
+                // Ignore errors and continue searching
+                none.source.clear();
+            }
+        }
+        FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Fallback search failed to find album art for: " << e.title;
+        storeCover(identity, artSize, none);
+        return "";
+    }
+
+    // ---------------------------------------------------------------------------
+    // ArtCollector
+    // ---------------------------------------------------------------------------
+    std::shared_ptr<ArtCollector> ArtCollector::start(std::vector<MonthlyEntry> entries, DoneCallback onDone)
+    {
+        std::shared_ptr<ArtCollector> collector(new ArtCollector());
+        collector->m_entries = std::move(entries);
+        collector->m_onDone = std::move(onDone);
+        collector->m_artSize = static_cast<int>(g_cfg_art_size.get());
+
+        // The library may only be enumerated on the main thread; reading the items' tags may not
+        metadb_handle_list items;
+        try
+        {
+            library_manager::get()->get_all_items(items);
+        }
+        catch (const std::exception &ex)
+        {
+            FMS_LOG(LogLevel::Warning, LogCategory::Art) << "[fms] Failed to load library items: " << ex.what();
+        }
+        collector->m_thread = std::thread(&ArtCollector::run, collector.get(), std::move(items));
+        return collector;
+    }
+
+    ArtCollector::~ArtCollector()
+    {
+        m_abort.abort();
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void ArtCollector::run(metadb_handle_list items)
+    {
+        const LibraryIndex library(items);
+        FMS_LOG(LogLevel::Info, LogCategory::Art) << "[fms] Album art: indexed " << (unsigned)library.size() << " library items";
+
+        // Reading and scaling covers is I/O and image decoding of independent files
+        const size_t count = m_entries.size();
+        std::vector<std::string> uris(count);
+        std::atomic<size_t> next{0};
+        auto work = [&]
+        {
+            Thumbnailer thumbnailer; // per thread: WIC objects are not shared across threads
+            for (size_t i = next++; i < count && !m_abort.is_aborting(); i = next++)
+            {
+                try
+                {
+                    uris[i] = findArt(m_entries[i], library, m_abort, thumbnailer, m_artSize);
+                }
+                catch (const exception_aborted &)
+                {
+                    return;
+                }
+                catch (const std::exception &ex)
+                {
+                    FMS_LOG(LogLevel::Warning, LogCategory::Art) << "[fms] Exception getting art for " << m_entries[i].title << ": " << ex.what();
+                }
+                catch (...)
+                {
+                    FMS_LOG(LogLevel::Warning, LogCategory::Art) << "[fms] Unknown exception getting art for: " << m_entries[i].title;
+                }
+                ++m_done;
+            }
+        };
+        const size_t threads = (std::min)(count, (std::max)(size_t(1), (std::min)(size_t(std::thread::hardware_concurrency()), size_t(8))));
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t)
+            pool.emplace_back(work);
+        work();
+        for (auto &t : pool)
+            t.join();
+
+        // Keep the cache within its cap (not after an abort: the user is waiting)
+        if (!m_abort.is_aborting())
+            ThumbnailCache::get().trim();
+
+        // Merged once every lookup has finished
+        ArtMap art;
+        for (size_t i = 0; i < count; ++i)
+            if (!uris[i].empty())
+                art.emplace(m_entries[i].track_crc, std::move(uris[i]));
+        const bool aborted = m_abort.is_aborting();
+        if (aborted)
+        {
+            FMS_LOG(LogLevel::Info, LogCategory::Art) << "[fms] Album art collection aborted after " << m_done.load() << " of "
+                                                      << (unsigned)count << " tracks.";
+        }
+        else
+        {
+            FMS_LOG(LogLevel::Info, LogCategory::Art) << "[fms] Album art collection complete. Found " << (unsigned)art.size() << " of "
+                                                      << (unsigned)count << " covers.";
+        }
+
+        fb2k::inMainThread([onDone = m_onDone, art = std::move(art), aborted]
+                           {
+                               if (onDone)
+                                   onDone(art, aborted);
+                           });
+    }
+
+} // namespace fms
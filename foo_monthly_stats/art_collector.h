@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+#include "db_manager.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // ArtCollector – album art for a report, looked up off the main thread
+    //
+    // start() snapshots the media library on the main thread and returns at
+    // once; a small pool of threads then resolves each entry's track (stored
+    // path, then LibraryIndex) and reads its front cover, several tracks at a
+    // time, and scales it down to the "Artwork Size" preference (thumbnail.h).
+    // Covers of albums already in the ThumbnailCache are reused without
+    // touching album_art_manager_v2 while their source file is unchanged.
+    // abort() cancels the outstanding album_art_manager_v2 calls.
+    // onDone receives track_crc -> data URI on the main thread, also after an
+    // abort (aborted = true, partial map).
+    // -----------------------------------------------------------------------
+    class ArtCollector
+    {
+    public:
+        using ArtMap = std::map<std::string, std::string>;
+        using DoneCallback = std::function<void(const ArtMap &art, bool aborted)>;
+
+        ~ArtCollector();
+
+        static std::shared_ptr<ArtCollector> start(std::vector<MonthlyEntry> entries, DoneCallback onDone);
+
+        void abort() { m_abort.abort(); }
+
+        // Entries looked up so far / in total
+        int done() const { return m_done; }
+        int total() const { return static_cast<int>(m_entries.size()); }
+
+    private:
+        ArtCollector() = default;
+        void run(metadb_handle_list items);
+
+        std::vector<MonthlyEntry> m_entries;
+        DoneCallback m_onDone;
+        int m_artSize = 64; // thumbnail edge in pixels (g_cfg_art_size)
+        abort_callback_impl m_abort;
+        std::atomic<int> m_done{0};
+        std::thread m_thread;
+    };
+
+} // namespace fms
@@ -0,0 +1,146 @@
+#include "stdafx.h"
+#include "auto_reporter.h"
+#include "period.h"
+#include "preferences.h"
+#include "report_exporter.h"
+
+namespace fms
+{
+
+    // Lowers the CPU, I/O and memory priority of the calling thread, so a report
+    // never competes with playback
+    static void enterBackgroundMode()
+    {
+        SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+    }
+
+    AutoReporter &AutoReporter::get()
+    {
+        static AutoReporter instance;
+        return instance;
+    }
+
+    void AutoReporter::start()
+    {
+        m_running = true;
+        m_commitToken = DbManager::get().subscribe([this](const CommitEvent &)
+                                                   { check(); });
+        check();
+    }
+
+    void AutoReporter::stop()
+    {
+        m_running = false;
+        if (m_commitToken)
+        {
+            DbManager::get().unsubscribe(m_commitToken);
+            m_commitToken = 0;
+        }
+        m_collector.reset(); // aborts and waits for the lookups in flight
+        joinThread();
+    }
+
+    void AutoReporter::joinThread()
+    {
+        if (m_thread.joinable())
+            m_thread.join();
+    }
+
+    void AutoReporter::check()
+    {
+        if (!m_running || !g_cfg_auto_report.get() || !m_month.empty())
+            return;
+
+        const std::string last = g_cfg_last_auto_report.get().c_str();
+        const std::string current = DbManager::currentYM();
+        if (last.empty())
+        {
+            // Just switched on: the month running now is the first one reported
+            g_cfg_last_auto_report = addMonths(current, -1).c_str();
+            return;
+        }
+        const std::string month = nextDueReportMonth(last, current);
+        if (month.empty())
+            return;
+
+        m_month = month;
+        joinThread(); // the writer of the month before, already done
+        m_thread = std::thread([this, month]
+                               {
+            enterBackgroundMode();
+            std::vector<MonthlyEntry> monthRows = DbManager::get().queryMonth(month);
+            std::vector<MonthlyEntry> yearRows;
+            if (month.compare(5, 2, "12") == 0)
+                yearRows = DbManager::get().queryYear(month.substr(0, 4));
+            fb2k::inMainThread([this, month, monthRows = std::move(monthRows), yearRows = std::move(yearRows)]() mutable
+                               { collect(month, std::move(monthRows), std::move(yearRows)); }); });
+    }
+
+    void AutoReporter::collect(const std::string &month, std::vector<MonthlyEntry> monthRows,
+                               std::vector<MonthlyEntry> yearRows)
+    {
+        if (!m_running)
+            return;
+        if (monthRows.empty() && yearRows.empty())
+        {
+            finish(month); // nothing played, nothing to report
+            return;
+        }
+
+        // The year's rows include every track of its December
+        m_monthRows = std::move(monthRows);
+        m_yearRows = std::move(yearRows);
+        m_collector = ArtCollector::start(m_yearRows.empty() ? m_monthRows : m_yearRows,
+                                          [this](const ArtCollector::ArtMap &art, bool aborted)
+                                          { onArtCollected(art, aborted); });
+    }
+
+    void AutoReporter::onArtCollected(const ArtCollector::ArtMap &art, bool aborted)
+    {
+        m_collector.reset();
+        if (!m_running)
+            return;
+        if (aborted)
+        {
+            m_month.clear(); // tried again at the next check
+            return;
+        }
+
+        joinThread(); // the query, done since it handed over the rows
+        m_thread = std::thread([this, month = m_month, dir = effectiveReportDir(), monthRows = std::move(m_monthRows),
+                                yearRows = std::move(m_yearRows), art]
+                               {
+            enterBackgroundMode();
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::u8path(dir), ec);
+
+            auto write = [&](const std::string &label, const std::string &fileName, const std::vector<MonthlyEntry> &rows)
+            {
+                if (rows.empty())
+                    return;
+                const std::filesystem::path path = std::filesystem::u8path(dir) / std::filesystem::u8path(fileName);
+                std::string err = ReportExporter::exportHtml(label, rows, path.wstring(), art);
+                if (err.empty())
+                    Log(LogLevel::Info, LogCategory::Report) << "foo_monthly_stats: auto report written to " << path.u8string();
+                else
+                    Log(LogLevel::Warning, LogCategory::Report) << "foo_monthly_stats: auto report failed: " << err;
+            };
+            const std::string year = month.substr(0, 4);
+            write("Monthly Stats – " + month, "report_" + month + ".html", monthRows);
+            write("Yearly Stats – " + year, "report_year_" + year + ".html", yearRows);
+
+            // A failed report is not retried: the log says what went wrong
+            fb2k::inMainThread([this, month]
+                               { finish(month); }); });
+    }
+
+    void AutoReporter::finish(const std::string &month)
+    {
+        if (!m_running)
+            return;
+        g_cfg_last_auto_report = month.c_str();
+        m_month.clear();
+        check(); // the next month when catching up
+    }
+
+} // namespace fms
@@ -0,0 +1,52 @@
+#pragma once
+#include "stdafx.h"
+#include "db_manager.h"
+#include "art_collector.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // AutoReporter – writes last month's report once a new month has begun
+    //
+    // While "Auto Report" is on, check() runs at startup and after every commit,
+    // so the first play of a month reports the month before it (and after
+    // December the year as well). The rows are queried on a background-priority
+    // thread, the covers go through ArtCollector and its thumbnail cache, and
+    // the HTML is written on a background-priority thread into
+    // effectiveReportDir(); the main thread only hands the work on.
+    // g_cfg_last_auto_report holds the month reported last: each month is
+    // reported once, and months missed while foobar2000 was closed follow one
+    // after another.
+    // -----------------------------------------------------------------------
+    class AutoReporter
+    {
+    public:
+        // Subscribes to commits and checks once (on_init, after the DB opened)
+        void start();
+
+        // Aborts a report in progress and waits for it (on_quit, before the DB closes)
+        void stop();
+
+        // Starts the next due report, if any; main thread
+        void check();
+
+        static AutoReporter &get();
+
+    private:
+        void collect(const std::string &month, std::vector<MonthlyEntry> monthRows,
+                     std::vector<MonthlyEntry> yearRows);
+        void onArtCollected(const ArtCollector::ArtMap &art, bool aborted);
+        void finish(const std::string &month);
+        void joinThread();
+
+        std::string m_month;                   // "YYYY-MM" being reported, empty when idle
+        std::vector<MonthlyEntry> m_monthRows; // waiting for their art
+        std::vector<MonthlyEntry> m_yearRows;  // only after December
+        std::shared_ptr<ArtCollector> m_collector;
+        std::thread m_thread; // the query, then the HTML writer
+        int m_commitToken = 0;
+        bool m_running = false;
+    };
+
+} // namespace fms
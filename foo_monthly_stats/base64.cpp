@@ -0,0 +1,200 @@
+#include "core.h"
+#include "base64.h"
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define FMS_BASE64_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define FMS_TARGET_SSSE3
+#define FMS_TARGET_AVX2
+#else
+#define FMS_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define FMS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace fms
+{
+
+    static const char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    // Whole 3-byte groups, then the padded tail
+    static void encodeScalar(const uint8_t *in, size_t size, char *out)
+    {
+        size_t i = 0;
+        for (; i + 3 <= size; i += 3, out += 4)
+        {
+            const uint32_t v = (uint32_t(in[i]) << 16) | (uint32_t(in[i + 1]) << 8) | in[i + 2];
+            out[0] = kAlphabet[v >> 18];
+            out[1] = kAlphabet[(v >> 12) & 63];
+            out[2] = kAlphabet[(v >> 6) & 63];
+            out[3] = kAlphabet[v & 63];
+        }
+        const size_t rest = size - i;
+        if (rest == 0)
+            return;
+        const uint32_t v = (uint32_t(in[i]) << 16) | (rest == 2 ? uint32_t(in[i + 1]) << 8 : 0);
+        out[0] = kAlphabet[v >> 18];
+        out[1] = kAlphabet[(v >> 12) & 63];
+        out[2] = rest == 2 ? kAlphabet[(v >> 6) & 63] : '=';
+        out[3] = '=';
+    }
+
+#ifdef FMS_BASE64_X86
+    // Vector steps after W. Muła and D. Lemire, "Faster Base64 Encoding and
+    // Decoding Using AVX2 Instructions": split 3 bytes into four 6-bit indices
+    // per 32-bit lane, then add the per-range offset to reach the ASCII code.
+
+    FMS_TARGET_SSSE3 static inline __m128i reshuffle128(__m128i in)
+    {
+        in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+        const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+        const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+        const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+        return _mm_or_si128(t1, t3);
+    }
+
+    FMS_TARGET_SSSE3 static inline __m128i translate128(__m128i indices)
+    {
+        // Offset per range: A-Z +65, a-z +71, 0-9 -4, '+' -19, '/' -16
+        const __m128i offsets = _mm_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        range = _mm_sub_epi8(range, _mm_cmpgt_epi8(indices, _mm_set1_epi8(25)));
+        return _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, range));
+    }
+
+    FMS_TARGET_SSSE3 static void encodeSsse3(const uint8_t *in, size_t size, char *out)
+    {
+        size_t i = 0;
+        // 16-byte loads of which 12 bytes are used
+        for (; i + 16 <= size; i += 12, out += 16)
+        {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), translate128(reshuffle128(v)));
+        }
+        encodeScalar(in + i, size - i, out);
+    }
+
+    FMS_TARGET_AVX2 static inline __m256i reshuffle256(__m256i in)
+    {
+        in = _mm256_shuffle_epi8(in, _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                     10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+        const __m256i t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        return _mm256_or_si256(t1, t3);
+    }
+
+    FMS_TARGET_AVX2 static inline __m256i translate256(__m256i indices)
+    {
+        const __m256i offsets = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                                 65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        __m256i range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        range = _mm256_sub_epi8(range, _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25)));
+        return _mm256_add_epi8(indices, _mm256_shuffle_epi8(offsets, range));
+    }
+
+    FMS_TARGET_AVX2 static void encodeAvx2(const uint8_t *in, size_t size, char *out)
+    {
+        size_t i = 0;
+        // Each 128-bit lane takes 12 bytes: loads at +0 and +12, so 28 bytes must be readable
+        for (; i + 28 <= size; i += 24, out += 32)
+        {
+            const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i + 12));
+            const __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), translate256(reshuffle256(v)));
+        }
+        _mm256_zeroupper();
+        encodeSsse3(in + i, size - i, out);
+    }
+
+    static bool cpuHasAvx2()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+            return false;
+        __cpuid(info, 1);
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 6) != 6) // OS saves the YMM registers
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    static bool cpuHasSsse3()
+    {
+#ifdef _MSC_VER
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] & (1 << 9)) != 0;
+#else
+        return __builtin_cpu_supports("ssse3");
+#endif
+    }
+#endif // FMS_BASE64_X86
+
+    namespace
+    {
+        using EncodeFn = void (*)(const uint8_t *, size_t, char *);
+
+        struct Encoder
+        {
+            EncodeFn fn = encodeScalar;
+            const char *name = "scalar";
+
+            Encoder()
+            {
+#ifdef FMS_BASE64_X86
+                if (cpuHasAvx2())
+                {
+                    fn = encodeAvx2;
+                    name = "avx2";
+                }
+                else if (cpuHasSsse3())
+                {
+                    fn = encodeSsse3;
+                    name = "ssse3";
+                }
+#endif
+            }
+        };
+
+        const Encoder &encoder()
+        {
+            static const Encoder instance;
+            return instance;
+        }
+    } // namespace
+
+    void base64Encode(const void *data, size_t size, char *out)
+    {
+        encoder().fn(static_cast<const uint8_t *>(data), size, out);
+    }
+
+    void base64EncodeScalar(const void *data, size_t size, char *out)
+    {
+        encodeScalar(static_cast<const uint8_t *>(data), size, out);
+    }
+
+    void base64Append(std::string &s, const void *data, size_t size)
+    {
+        const size_t at = s.size();
+        s.resize(at + base64Length(size));
+        base64Encode(data, size, &s[at]);
+    }
+
+    const char *base64Implementation()
+    {
+        return encoder().name;
+    }
+
+} // namespace fms
@@ -0,0 +1,29 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // Base64 (RFC 4648, padded) for the covers embedded in reports
+    //
+    // base64Encode writes into a buffer the caller sized with base64Length.
+    // On x86 it uses AVX2 or SSSE3 when the CPU has them (checked once at
+    // run time), 24 or 12 input bytes per step; elsewhere, and for the last
+    // few bytes, the scalar encoder.
+    // -----------------------------------------------------------------------
+    constexpr size_t base64Length(size_t size) { return (size + 2) / 3 * 4; }
+
+    // Writes exactly base64Length(size) characters to out (no terminator)
+    void base64Encode(const void *data, size_t size, char *out);
+
+    // Portable reference implementation (tests and benchmark)
+    void base64EncodeScalar(const void *data, size_t size, char *out);
+
+    // Appends the encoding of data to s
+    void base64Append(std::string &s, const void *data, size_t size);
+
+    // Implementation base64Encode dispatches to: "avx2", "ssse3" or "scalar"
+    const char *base64Implementation();
+
+} // namespace fms
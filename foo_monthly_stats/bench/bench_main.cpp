@@ -0,0 +1,360 @@
+// bench_main.cpp – end-to-end benchmark of the real DbManager and HTML export
+//
+// Builds a synthetic history (HistoryGenerator), records it through postPlay
+// and times the public DbManager entry points, ReportExporter::exportHtml and
+// the base64 encoder used for embedded covers.
+// Prints a table and writes JSON results for regression tracking:
+//
+//   fms_bench [--years N] [--tracks N] [--plays-per-day X] [--seed N]
+//             [--dir PATH] [--out results.json] [--db-stats stats.json]
+
+#include "core.h"
+#include "db_manager.h"
+#include "db_stats.h"
+#include "report_exporter.h"
+#include "base64.h"
+#include "history_generator.h"
+
+using namespace fms;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    uint64_t elapsedUs(Clock::time_point start)
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count());
+    }
+
+    struct Result
+    {
+        std::string name;
+        LatencyHistogram latency;
+        uint64_t rows = 0; // rows returned or written over all iterations
+    };
+
+    class Bench
+    {
+    public:
+        // Times fn once under name; fn returns the rows it produced
+        template <typename Fn>
+        void run(const std::string &name, Fn &&fn)
+        {
+            auto start = Clock::now();
+            uint64_t rows = fn();
+            Result &r = result(name);
+            r.latency.record(elapsedUs(start));
+            r.rows += rows;
+        }
+
+        Result &result(const std::string &name)
+        {
+            for (auto &r : m_results)
+                if (r.name == name)
+                    return r;
+            m_results.push_back(Result{name, {}, 0});
+            return m_results.back();
+        }
+
+        void print() const
+        {
+            printf("%-28s %8s %10s %10s %10s %10s %10s %12s\n", "benchmark", "iters", "total ms", "mean ms", "p50 ms", "p99 ms", "max ms", "rows");
+            for (const auto &r : m_results)
+            {
+                const auto &h = r.latency;
+                printf("%-28s %8llu %10.2f %10.3f %10.3f %10.3f %10.3f %12llu\n", r.name.c_str(),
+                       static_cast<unsigned long long>(h.count()), h.totalUs() / 1000.0,
+                       h.count() ? h.totalUs() / 1000.0 / h.count() : 0.0, h.percentileUs(50) / 1000.0,
+                       h.percentileUs(99) / 1000.0, h.maxUs() / 1000.0, static_cast<unsigned long long>(r.rows));
+            }
+        }
+
+        bool writeJson(const std::string &path, const HistoryConfig &config, size_t plays, uint64_t dbBytes) const
+        {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            if (!out)
+                return false;
+            out << "{\n  \"benchmark\": \"foo_monthly_stats\",\n  \"schema\": 1,\n";
+            out << "  \"config\": {\"seed\": " << config.seed << ", \"years\": " << config.years
+                << ", \"end_year\": " << config.endYear << ", \"tracks\": " << config.tracks
+                << ", \"plays_per_day\": " << config.playsPerDay << ", \"zipf_exponent\": " << config.zipfExponent
+                << ", \"play_events\": " << plays << "},\n";
+            out << "  \"db_bytes\": " << dbBytes << ",\n  \"results\": [";
+            for (size_t i = 0; i < m_results.size(); ++i)
+            {
+                const auto &h = m_results[i].latency;
+                out << (i ? ",\n" : "\n") << "    {\"name\": \"" << m_results[i].name << "\""
+                    << ", \"iterations\": " << h.count() << ", \"rows\": " << m_results[i].rows
+                    << ", \"total_us\": " << h.totalUs() << ", \"mean_us\": " << (h.count() ? h.totalUs() / h.count() : 0)
+                    << ", \"p50_us\": " << h.percentileUs(50) << ", \"p90_us\": " << h.percentileUs(90)
+                    << ", \"p99_us\": " << h.percentileUs(99) << ", \"max_us\": " << h.maxUs() << "}";
+            }
+            out << "\n  ]\n}\n";
+            return static_cast<bool>(out);
+        }
+
+    private:
+        std::vector<Result> m_results; // in run order
+    };
+
+    std::string ym(int year, int month)
+    {
+        char buf[8];
+        snprintf(buf, sizeof(buf), "%04d-%02d", year, month);
+        return buf;
+    }
+
+    uint64_t directoryBytes(const std::filesystem::path &dir)
+    {
+        uint64_t total = 0;
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(dir, ec))
+            if (entry.is_regular_file(ec))
+                total += entry.file_size(ec);
+        return total;
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    HistoryConfig config;
+    std::string dir = (std::filesystem::temp_directory_path() / "fms_bench").string();
+    std::string outPath = "bench_results.json";
+    std::string dbStatsPath;
+    for (int i = 1; i + 1 < argc; i += 2)
+    {
+        std::string arg = argv[i];
+        const char *value = argv[i + 1];
+        if (arg == "--years")
+            config.years = atoi(value);
+        else if (arg == "--tracks")
+            config.tracks = atoi(value);
+        else if (arg == "--plays-per-day")
+            config.playsPerDay = atof(value);
+        else if (arg == "--seed")
+            config.seed = strtoull(value, nullptr, 10);
+        else if (arg == "--dir")
+            dir = value;
+        else if (arg == "--out")
+            outPath = value;
+        else if (arg == "--db-stats")
+            dbStatsPath = value;
+        else
+        {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir, ec);
+    const std::string dbPath = (std::filesystem::path(dir) / "bench.db").string();
+    const int firstYear = config.endYear - config.years + 1;
+
+    Bench bench;
+    DbManager &db = DbManager::get();
+    if (!dbStatsPath.empty())
+        DbStats::get().setEnabled(true);
+
+    // --- Generation ---------------------------------------------------------
+    std::vector<TrackInfo> plays;
+    bench.run("generate", [&]
+              {
+        HistoryGenerator gen(config);
+        plays = gen.plays();
+        return static_cast<uint64_t>(plays.size()); });
+    printf("%zu play events over %d years, %d tracks\n", plays.size(), config.years, config.tracks);
+
+    // --- Recording: everything queued at once, committed by the worker ------
+    bool opened = false;
+    bench.run("open.empty", [&]
+              {
+        opened = db.open(dbPath.c_str());
+        return 0; });
+    if (!opened)
+        return 1;
+    bench.run("insert.bulk", [&]
+              {
+        for (const auto &p : plays)
+            db.postPlay(p);
+        db.close(); // drains the queue
+        return static_cast<uint64_t>(plays.size()); });
+
+    bench.run("open.populated", [&]
+              {
+        opened = db.open(dbPath.c_str());
+        return 0; });
+    if (!opened)
+        return 1;
+
+    // --- Period queries: first call (SQL) and immediate repeat (cache) -------
+    // Repeated right away: a full pass over every period would overflow the
+    // LRU cache and time SQL twice.
+    auto query = [&](const std::string &name, auto fn)
+    {
+        bench.run(name + ".cold", fn);
+        bench.run(name + ".warm", fn);
+    };
+    for (int y = firstYear; y <= config.endYear; ++y)
+        for (int m = 1; m <= 12; ++m)
+            query("queryMonth", [&]
+                  { return static_cast<uint64_t>(db.queryMonth(ym(y, m)).size()); });
+    for (int y = firstYear; y <= config.endYear; ++y)
+        for (int m = 1; m <= 12; m += 3)
+            for (int d = 1; d <= 28; d += 9)
+                query("queryDay", [&]
+                      { return static_cast<uint64_t>(db.queryDay(ym(y, m) + (d < 10 ? "-0" : "-") + std::to_string(d)).size()); });
+    for (int y = firstYear; y <= config.endYear; ++y)
+        query("queryYear", [&]
+              { return static_cast<uint64_t>(db.queryYear(std::to_string(y)).size()); });
+
+    for (int y = firstYear; y <= config.endYear; ++y)
+        bench.run("queryYearByMonth", [&]
+                  {
+            uint64_t rows = 0;
+            for (const auto &[month, entries] : db.queryYearByMonth(std::to_string(y)))
+                rows += entries.size();
+            return rows; });
+
+    for (int y = firstYear; y <= config.endYear; ++y)
+        for (const char *q : {"night", "blue ri", "東京", "a"})
+            bench.run("search", [&]
+                      { return static_cast<uint64_t>(db.search(std::to_string(y), q).size()); });
+
+    // --- Rebuilding aggregates from play_log ---------------------------------
+    // Refreshes run on the worker; each one ends with its CommitEvent
+    std::mutex commitMutex;
+    std::condition_variable commitCv;
+    int commits = 0;
+    const int commitToken = db.subscribe([&](const CommitEvent &)
+                                         {
+        std::lock_guard<std::mutex> lk(commitMutex);
+        ++commits;
+        commitCv.notify_all(); });
+    auto refresh = [&](const std::string &period, bool isYear)
+    {
+        std::unique_lock<std::mutex> lk(commitMutex);
+        const int before = commits;
+        db.postRefreshPeriod(period, isYear);
+        commitCv.wait(lk, [&]
+                      { return commits != before; });
+    };
+    for (int m = 1; m <= 12; ++m)
+        bench.run("refreshPeriod.month", [&]
+                  {
+            refresh(ym(config.endYear, m), false);
+            return 0; });
+    bench.run("refreshPeriod.year", [&]
+              {
+        refresh(std::to_string(config.endYear), true);
+        return 0; });
+    db.unsubscribe(commitToken);
+
+    // --- HTML export of the busiest month and the last year ------------------
+    {
+        std::vector<MonthlyEntry> month = db.queryMonth(ym(config.endYear, 12));
+        std::vector<MonthlyEntry> year = db.queryYear(std::to_string(config.endYear));
+        std::wstring htmlPath = (std::filesystem::path(dir) / "report.html").wstring();
+        for (int i = 0; i < 5; ++i)
+        {
+            bench.run("export.month.desktop", [&]
+                      { return ReportExporter::exportHtml("bench", month, htmlPath).empty() ? month.size() : 0; });
+            bench.run("export.month.smartphone", [&]
+                      { return ReportExporter::exportHtml("bench", month, htmlPath, {}, ReportFormat::Smartphone).empty() ? month.size() : 0; });
+        }
+        bench.run("export.year.desktop", [&]
+                  { return ReportExporter::exportHtml("bench", year, htmlPath).empty() ? year.size() : 0; });
+        bench.run("export.year.paged", [&]
+                  { return ReportExporter::exportHtml("bench", year, htmlPath, {}, ReportFormat::Paged).empty() ? year.size() : 0; });
+
+        // Export Year: twelve months and the year on worker threads, plus the index
+        std::vector<BatchReport> batch;
+        std::vector<MonthlyEntry> yearRows;
+        for (auto &[month, entries] : db.queryYearByMonth(std::to_string(config.endYear), &yearRows))
+            batch.push_back({month, "report_" + month + ".html", std::move(entries)});
+        batch.push_back({"year", "report_year.html", std::move(yearRows)});
+        bench.run("export.year.batch", [&]
+                  { return ReportExporter::exportBatch("bench", batch, htmlPath).empty() ? batch.size() : 0; });
+    }
+
+    // --- Base64 of cover-sized data: dispatched encoder against the scalar one --
+    {
+        std::string covers(64 * 1024 * 1024, '\0');
+        uint64_t state = config.seed | 1;
+        for (auto &c : covers)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            c = static_cast<char>(state);
+        }
+        std::string text(base64Length(covers.size()), '\0');
+        const std::string name = std::string("base64.") + base64Implementation();
+        for (int i = 0; i < 5; ++i)
+        {
+            bench.run(name, [&]
+                      {
+                base64Encode(covers.data(), covers.size(), &text[0]);
+                return covers.size(); });
+            bench.run("base64.scalar.reference", [&]
+                      {
+                base64EncodeScalar(covers.data(), covers.size(), &text[0]);
+                return covers.size(); });
+        }
+    }
+
+    bench.run("removeDuplicates", [&]
+              {
+        db.removeDuplicates();
+        return 0; });
+
+    // --- One play at a time: postPlay until its commit reaches subscribers ----
+    {
+        std::mutex mutex;
+        std::condition_variable cv;
+        int commits = 0;
+        int token = db.subscribe([&](const CommitEvent &)
+                                 {
+            std::lock_guard<std::mutex> lk(mutex);
+            ++commits;
+            cv.notify_all(); });
+        TrackInfo track = plays.empty() ? TrackInfo{} : plays.back();
+        for (int i = 0; i < 200; ++i)
+        {
+            bench.run("insert.single", [&]
+                      {
+                int before;
+                {
+                    std::lock_guard<std::mutex> lk(mutex);
+                    before = commits;
+                }
+                TrackInfo play = track;
+                play.played_at = static_cast<int64_t>(time(nullptr)) * 1000;
+                db.postPlay(play);
+                std::unique_lock<std::mutex> lk(mutex);
+                cv.wait(lk, [&]
+                        { return commits > before; });
+                return 1; });
+        }
+        db.unsubscribe(token);
+    }
+
+    bench.run("close", [&]
+              {
+        db.close();
+        return 0; });
+
+    bench.print();
+    uint64_t dbBytes = directoryBytes(dir);
+    printf("database files: %.1f MB\n", dbBytes / 1048576.0);
+    if (!bench.writeJson(outPath, config, plays.size(), dbBytes))
+    {
+        fprintf(stderr, "could not write %s\n", outPath.c_str());
+        return 1;
+    }
+    printf("results written to %s\n", outPath.c_str());
+    if (!dbStatsPath.empty() && !DbStats::get().writeJson(dbStatsPath))
+        fprintf(stderr, "could not write %s\n", dbStatsPath.c_str());
+    return 0;
+}
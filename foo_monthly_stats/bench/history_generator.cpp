@@ -0,0 +1,208 @@
+#include "core.h"
+#include "history_generator.h"
+#include <cmath>
+
+namespace fms
+{
+
+    // Title words; a few non-ASCII ones so the FTS tokenizer sees real-world input
+    static const char *const kWords[] = {
+        "night", "summer", "blue", "river", "light", "dream", "city", "rain", "fire", "heart",
+        "song", "road", "star", "moon", "ocean", "garden", "echo", "silver", "wild", "home",
+        "café", "naïve", "über", "夜", "空", "花", "東京", "さくら", "Ørsted", "señal"};
+    static const size_t kWordCount = sizeof(kWords) / sizeof(kWords[0]);
+
+    static std::string crcOf(uint64_t v)
+    {
+        char buf[17];
+        snprintf(buf, sizeof(buf), "%016llx", static_cast<unsigned long long>(v));
+        return buf;
+    }
+
+    // Epoch ms of local midnight of a day plus seconds (mktime normalizes overflow)
+    static int64_t localMs(int year, int month, int day, int seconds)
+    {
+        struct tm t{};
+        t.tm_year = year - 1900;
+        t.tm_mon = month - 1;
+        t.tm_mday = day;
+        t.tm_sec = seconds;
+        t.tm_isdst = -1;
+        return static_cast<int64_t>(mktime(&t)) * 1000;
+    }
+
+    HistoryGenerator::HistoryGenerator(const HistoryConfig &config)
+        : m_config(config), m_state(config.seed)
+    {
+        auto words = [this](int n)
+        {
+            std::string s;
+            for (int i = 0; i < n; ++i)
+            {
+                if (i)
+                    s.push_back(' ');
+                s += kWords[next() % kWordCount];
+            }
+            return s;
+        };
+
+        std::vector<std::string> artists(static_cast<size_t>(m_config.artists));
+        for (size_t i = 0; i < artists.size(); ++i)
+            artists[i] = words(1 + static_cast<int>(next() % 2)) + " " + std::to_string(i);
+
+        // Albums belong to artists with a skew: a few artists have most of the library
+        std::vector<double> artistCdf(artists.size());
+        double sum = 0;
+        for (size_t i = 0; i < artists.size(); ++i)
+            artistCdf[i] = (sum += 1.0 / std::pow(static_cast<double>(i + 1), 0.8));
+
+        std::string artist, album;
+        for (int i = 0; i < m_config.tracks; ++i)
+        {
+            if (i % m_config.tracksPerAlbum == 0)
+            {
+                double u = uniform() * sum;
+                size_t a = std::lower_bound(artistCdf.begin(), artistCdf.end(), u) - artistCdf.begin();
+                artist = artists[(std::min)(a, artists.size() - 1)];
+                album = words(1 + static_cast<int>(next() % 3)) + " (" + std::to_string(i / m_config.tracksPerAlbum) + ")";
+            }
+            TrackInfo t;
+            t.path = "/music/" + artist + "/" + album + "/" + std::to_string(i % m_config.tracksPerAlbum + 1) + ".flac";
+            t.track_crc = crcOf(next());
+            t.title = words(1 + static_cast<int>(next() % 4));
+            t.artist = artist;
+            t.album = album;
+            t.length_seconds = 120 + static_cast<double>(next() % 300);
+            t.played_at = 0;
+            m_library.push_back(std::move(t));
+        }
+
+        // Same metadata under a second path (re-rip, moved file): what removeDuplicates merges
+        size_t dups = static_cast<size_t>(m_config.duplicateRate * m_config.tracks);
+        for (size_t i = 0; i < dups; ++i)
+        {
+            TrackInfo t = m_library[next() % m_library.size()];
+            t.path = "/music/old" + t.path.substr(6);
+            t.track_crc = crcOf(next());
+            m_library.push_back(std::move(t));
+        }
+
+        m_byRank.resize(m_library.size());
+        for (size_t i = 0; i < m_byRank.size(); ++i)
+            m_byRank[i] = i;
+        for (size_t i = m_byRank.size(); i > 1; --i)
+            std::swap(m_byRank[i - 1], m_byRank[next() % i]);
+
+        m_zipfCdf.resize(m_library.size());
+        double total = 0;
+        for (size_t r = 0; r < m_zipfCdf.size(); ++r)
+            m_zipfCdf[r] = (total += 1.0 / std::pow(static_cast<double>(r + 1), m_config.zipfExponent));
+        for (auto &c : m_zipfCdf)
+            c /= total;
+    }
+
+    uint64_t HistoryGenerator::next()
+    {
+        uint64_t z = (m_state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    double HistoryGenerator::uniform()
+    {
+        return static_cast<double>(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    int HistoryGenerator::poisson(double mean)
+    {
+        if (mean <= 0)
+            return 0;
+        if (mean > 30)
+        {
+            // Normal approximation (Box-Muller) for large means
+            double u1 = (std::max)(uniform(), 1e-12), u2 = uniform();
+            double n = std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+            return (std::max)(0, static_cast<int>(mean + n * std::sqrt(mean) + 0.5));
+        }
+        double limit = std::exp(-mean), p = 1.0;
+        int k = 0;
+        do
+        {
+            ++k;
+            p *= uniform();
+        } while (p > limit);
+        return k - 1;
+    }
+
+    size_t HistoryGenerator::pickRank()
+    {
+        size_t r = std::lower_bound(m_zipfCdf.begin(), m_zipfCdf.end(), uniform()) - m_zipfCdf.begin();
+        return (std::min)(r, m_zipfCdf.size() - 1);
+    }
+
+    // Tastes change: some tracks move to a random new popularity rank
+    void HistoryGenerator::drift()
+    {
+        size_t swaps = static_cast<size_t>(m_config.monthlyDrift * m_byRank.size());
+        for (size_t i = 0; i < swaps; ++i)
+            std::swap(m_byRank[pickRank()], m_byRank[next() % m_byRank.size()]);
+    }
+
+    std::vector<TrackInfo> HistoryGenerator::plays()
+    {
+        static const int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        std::vector<TrackInfo> result;
+        result.reserve(static_cast<size_t>(2 * m_config.playsPerDay * 366 * m_config.years));
+
+        for (int year = m_config.endYear - m_config.years + 1; year <= m_config.endYear; ++year)
+        {
+            bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+            for (int month = 1; month <= 12; ++month)
+            {
+                drift();
+                int days = daysInMonth[month - 1] + (month == 2 && leap ? 1 : 0);
+                for (int day = 1; day <= days; ++day)
+                {
+                    int64_t midnight = localMs(year, month, day, 0);
+                    struct tm probe{};
+                    time_t t = static_cast<time_t>(midnight / 1000);
+#ifdef _WIN32
+                    localtime_s(&probe, &t);
+#else
+                    localtime_r(&t, &probe);
+#endif
+                    bool weekend = probe.tm_wday == 0 || probe.tm_wday == 6;
+                    if (uniform() < 0.1)
+                        continue; // a day without music
+                    int remaining = poisson(m_config.playsPerDay * (weekend ? 1.5 : 1.0));
+
+                    // Sessions start between 07:00 and 22:00 and play tracks back to back
+                    int clock = 7 * 3600;
+                    while (remaining > 0 && clock < 24 * 3600)
+                    {
+                        clock += static_cast<int>(uniform() * 3 * 3600);
+                        int session = (std::min)(remaining, 1 + static_cast<int>(next() % 25));
+                        for (int i = 0; i < session && clock < 24 * 3600; ++i, --remaining)
+                        {
+                            // Same two events as PlaybackStatsCollector: the play (length 0)
+                            // and, at stop, the seconds actually listened; some tracks are skipped
+                            TrackInfo play = m_library[m_byRank[pickRank()]];
+                            double length = play.length_seconds;
+                            double listened = uniform() < 0.15 ? length * uniform() : length;
+                            play.length_seconds = 0;
+                            play.played_at = localMs(year, month, day, clock);
+                            result.push_back(play);
+                            clock += static_cast<int>(listened) + 1;
+                            play.length_seconds = listened;
+                            play.played_at = localMs(year, month, day, clock);
+                            result.push_back(std::move(play));
+                        }
+                    }
+                }
+            }
+        }
+        return result;
+    }
+
+} // namespace fms
@@ -0,0 +1,58 @@
+#pragma once
+#include "core.h"
+#include "db_manager.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // HistoryConfig – shape of a synthetic listening history
+    // -----------------------------------------------------------------------
+    struct HistoryConfig
+    {
+        uint64_t seed = 1;
+        int years = 5;              // history length, ending on Dec 31 of endYear
+        int endYear = 2025;         // fixed so runs are comparable; past the current year is fine
+        int tracks = 20000;         // library size
+        int tracksPerAlbum = 12;
+        int artists = 1500;
+        double zipfExponent = 1.1;  // track popularity: rank r played with weight 1 / r^s
+        double playsPerDay = 40;    // mean; weekends get 1.5x, some days none
+        double duplicateRate = 0.02; // share of tracks also present under a second path
+        double monthlyDrift = 0.05; // share of popularity ranks reshuffled each month
+    };
+
+    // -----------------------------------------------------------------------
+    // HistoryGenerator – deterministic Zipf-distributed play history
+    //
+    // Uses its own PRNG and distributions (not <random>), so a seed yields the
+    // same library and plays with every compiler and standard library.
+    // Plays come in listening sessions, back to back, in chronological order.
+    // -----------------------------------------------------------------------
+    class HistoryGenerator
+    {
+    public:
+        explicit HistoryGenerator(const HistoryConfig &config);
+
+        const std::vector<TrackInfo> &library() const { return m_library; }
+
+        // Play events of the history in chronological order, two per play like the
+        // recorder posts them: length_seconds 0 when it starts, listened seconds at stop
+        // (played_at in local time)
+        std::vector<TrackInfo> plays();
+
+    private:
+        uint64_t next();         // SplitMix64
+        double uniform();        // [0, 1)
+        int poisson(double mean);
+        size_t pickRank();       // Zipf-distributed rank into m_byRank
+        void drift();
+
+        HistoryConfig m_config;
+        uint64_t m_state;
+        std::vector<TrackInfo> m_library;
+        std::vector<size_t> m_byRank;   // popularity rank -> m_library index
+        std::vector<double> m_zipfCdf;  // cumulative weight per rank, normalized to 1
+    };
+
+} // namespace fms
@@ -0,0 +1,263 @@
+#include "core.h"
+
+namespace fms
+{
+
+    // Sinks are set once at startup but read from the worker and UI threads
+    static std::mutex g_hostMutex;
+    static LogSink g_logSink;
+    static MainThreadDispatcher g_dispatcher;
+
+    // -----------------------------------------------------------------------
+    // Logging
+    // -----------------------------------------------------------------------
+    static std::atomic<int> g_logLevel{static_cast<int>(LogLevel::Info)};
+
+    void setLogSink(LogSink sink)
+    {
+        std::lock_guard<std::mutex> lk(g_hostMutex);
+        g_logSink = std::move(sink);
+    }
+
+    static void writeToSink(const std::string &text)
+    {
+        LogSink sink;
+        {
+            std::lock_guard<std::mutex> lk(g_hostMutex);
+            sink = g_logSink;
+        }
+        if (sink)
+            sink(text);
+        else
+            fprintf(stderr, "%s\n", text.c_str());
+    }
+
+    void setLogLevel(LogLevel level) { g_logLevel = static_cast<int>(level); }
+
+    bool logEnabled(LogLevel level) { return static_cast<int>(level) <= g_logLevel.load(std::memory_order_relaxed); }
+
+    // Bounded multi-producer / single-consumer ring (Vyukov): producers claim a slot
+    // with one CAS on m_head, the writer thread is the only consumer
+    class LogRing
+    {
+    public:
+        static constexpr size_t kSlots = 1024; // power of two
+
+        LogRing()
+        {
+            for (size_t i = 0; i < kSlots; ++i)
+                m_slots[i].seq.store(i, std::memory_order_relaxed);
+        }
+
+        // false when full
+        bool push(std::string &&line)
+        {
+            size_t pos = m_head.load(std::memory_order_relaxed);
+            Slot *slot;
+            for (;;)
+            {
+                slot = &m_slots[pos & (kSlots - 1)];
+                size_t seq = slot->seq.load(std::memory_order_acquire);
+                intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+                if (diff == 0)
+                {
+                    if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (diff < 0)
+                    return false;
+                else
+                    pos = m_head.load(std::memory_order_relaxed);
+            }
+            slot->line = std::move(line);
+            slot->seq.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // Consumer only
+        bool pop(std::string &line)
+        {
+            const size_t pos = m_tail.load(std::memory_order_relaxed);
+            Slot &slot = m_slots[pos & (kSlots - 1)];
+            if (slot.seq.load(std::memory_order_acquire) != pos + 1)
+                return false;
+            line = std::move(slot.line);
+            slot.line.clear();
+            slot.seq.store(pos + kSlots, std::memory_order_release);
+            m_tail.store(pos + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        size_t size() const
+        {
+            return m_head.load(std::memory_order_relaxed) - m_tail.load(std::memory_order_relaxed);
+        }
+
+    private:
+        struct Slot
+        {
+            std::atomic<size_t> seq;
+            std::string line;
+        };
+        Slot m_slots[kSlots];
+        std::atomic<size_t> m_head{0};
+        std::atomic<size_t> m_tail{0};
+    };
+
+    static LogRing g_logRing;
+    static std::atomic<bool> g_logWriterRunning{false};
+    static std::atomic<int> g_logDropped{0}; // lines lost to a full ring
+    static std::thread g_logWriter;
+    static std::mutex g_logWriterMutex;
+    static std::condition_variable g_logWriterCv;
+    static bool g_logWriterStop = false; // guarded by g_logWriterMutex
+
+    // Everything queued as one sink call
+    static void flushLogRing()
+    {
+        std::string batch, line;
+        while (g_logRing.pop(line))
+        {
+            if (!batch.empty())
+                batch += '\n';
+            batch += line;
+        }
+        if (int dropped = g_logDropped.exchange(0))
+        {
+            if (!batch.empty())
+                batch += '\n';
+            batch += "foo_monthly_stats: " + std::to_string(dropped) + " log lines dropped (log queue full)";
+        }
+        if (!batch.empty())
+            writeToSink(batch);
+    }
+
+    static void logWriterThread()
+    {
+        std::unique_lock<std::mutex> lk(g_logWriterMutex);
+        while (!g_logWriterStop)
+        {
+            // Batches whatever arrived in the last 100 ms; a filling ring wakes it early
+            g_logWriterCv.wait_for(lk, std::chrono::milliseconds(100));
+            lk.unlock();
+            flushLogRing();
+            lk.lock();
+        }
+    }
+
+    void startLogWriter()
+    {
+        std::lock_guard<std::mutex> lk(g_logWriterMutex);
+        if (g_logWriter.joinable())
+            return;
+        g_logWriterStop = false;
+        g_logWriter = std::thread(logWriterThread);
+        g_logWriterRunning = true;
+    }
+
+    void stopLogWriter()
+    {
+        std::thread writer;
+        {
+            std::lock_guard<std::mutex> lk(g_logWriterMutex);
+            if (!g_logWriter.joinable())
+                return;
+            g_logWriterRunning = false;
+            g_logWriterStop = true;
+            writer = std::move(g_logWriter);
+        }
+        g_logWriterCv.notify_one();
+        writer.join();
+        flushLogRing(); // lines pushed while the writer was stopping
+    }
+
+    // Per-category one-second windows; approximate under contention, never blocks
+    struct LogRateWindow
+    {
+        std::atomic<int64_t> second{0};
+        std::atomic<int> lines{0};
+        std::atomic<int> suppressed{0};
+    };
+    static LogRateWindow g_logRate[static_cast<int>(LogCategory::Count)];
+
+    static const char *categoryName(LogCategory category)
+    {
+        switch (category)
+        {
+        case LogCategory::Db:
+            return "db";
+        case LogCategory::Recorder:
+            return "recorder";
+        case LogCategory::Art:
+            return "art";
+        case LogCategory::Report:
+            return "report";
+        default:
+            return "general";
+        }
+    }
+
+    static bool logRateAllows(LogCategory category)
+    {
+        LogRateWindow &w = g_logRate[static_cast<int>(category)];
+        const int64_t now = std::chrono::duration_cast<std::chrono::seconds>(
+                                std::chrono::steady_clock::now().time_since_epoch())
+                                .count();
+        int64_t second = w.second.load(std::memory_order_relaxed);
+        if (second != now && w.second.compare_exchange_strong(second, now, std::memory_order_relaxed))
+        {
+            w.lines.store(0, std::memory_order_relaxed);
+            if (int suppressed = w.suppressed.exchange(0))
+                Log(LogLevel::Error, category) << "foo_monthly_stats: " << suppressed << " "
+                                               << categoryName(category) << " log lines suppressed";
+        }
+        if (w.lines.fetch_add(1, std::memory_order_relaxed) < kLogLinesPerSecond)
+            return true;
+        w.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    Log::Log(LogLevel level, LogCategory category)
+        : m_enabled(logEnabled(level) && (level == LogLevel::Error || logRateAllows(category)))
+    {
+    }
+
+    Log::~Log()
+    {
+        if (!m_enabled)
+            return;
+        std::string line = m_line.str();
+        if (!g_logWriterRunning.load(std::memory_order_acquire))
+        {
+            writeToSink(line);
+            return;
+        }
+        if (!g_logRing.push(std::move(line)))
+            g_logDropped.fetch_add(1, std::memory_order_relaxed);
+        else if (g_logRing.size() >= LogRing::kSlots / 2)
+            g_logWriterCv.notify_one();
+    }
+
+    // -----------------------------------------------------------------------
+    // Main-thread dispatch
+    // -----------------------------------------------------------------------
+    void setMainThreadDispatcher(MainThreadDispatcher dispatcher)
+    {
+        std::lock_guard<std::mutex> lk(g_hostMutex);
+        g_dispatcher = std::move(dispatcher);
+    }
+
+    void runInMainThread(std::function<void()> fn)
+    {
+        MainThreadDispatcher dispatcher;
+        {
+            std::lock_guard<std::mutex> lk(g_hostMutex);
+            dispatcher = g_dispatcher;
+        }
+        if (dispatcher)
+            dispatcher(std::move(fn));
+        else
+            fn();
+    }
+
+} // namespace fms
@@ -0,0 +1,138 @@
+#pragma once
+
+// core.h – prelude of the platform-neutral statistics core
+//
+// db_manager, hot_aggregate, query_cache, db_stats, period, listen_timer,
+// thumbnail_cache, base64, html_writer, the MIME sniffing of thumbnail and the
+// HTML part of report_exporter include this
+// instead of stdafx.h: no foobar2000
+// SDK and no Win32, so they also build on Linux (CMakeLists.txt) for tests and
+// benchmarks.
+// What the core needs from its host – a console and the main thread – is
+// injected through setLogSink and setMainThreadDispatcher.
+
+// STL
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <tuple>
+#include <algorithm>
+#include <queue>
+#include <list>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <chrono>
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <filesystem>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <ctime>
+
+// SQLite (amalgamation – included in third_party/sqlite)
+#include <sqlite3.h>
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // Logging – one line per Log object, handed to the sink when it goes out of scope
+    //
+    //   Log() << "foo_monthly_stats: attach " << path.c_str() << " failed";
+    //   FMS_LOG(LogLevel::Debug, LogCategory::Art) << "[fms] Got album art for: " << title;
+    //
+    // Lines above the verbosity level are skipped before anything is formatted
+    // (FMS_LOG does not even evaluate its operands), and each category is
+    // limited to kLogLinesPerSecond lines below Error. While the log writer runs,
+    // lines go through a lock-free ring to a background thread that hands them
+    // to the sink in batches; otherwise the sink is called on the logging thread.
+    //
+    // The component routes lines to the foobar2000 console; without a sink
+    // they go to stderr.
+    // -----------------------------------------------------------------------
+    using LogSink = std::function<void(const std::string &line)>;
+
+    enum class LogLevel
+    {
+        Error,
+        Warning,
+        Info,
+        Debug,
+    };
+
+    enum class LogCategory
+    {
+        General,
+        Db,
+        Recorder,
+        Art,
+        Report,
+        Count
+    };
+
+    constexpr int kLogLinesPerSecond = 50;
+
+    // Replaces the sink (null restores stderr); may be called from any thread
+    void setLogSink(LogSink sink);
+
+    // Most verbose level still logged (default Info)
+    void setLogLevel(LogLevel level);
+    bool logEnabled(LogLevel level);
+
+    // Background batching; stopLogWriter flushes what is queued and logs synchronously again
+    void startLogWriter();
+    void stopLogWriter();
+
+    class Log
+    {
+    public:
+        Log() : Log(LogLevel::Info, LogCategory::General) {}
+        Log(LogLevel level, LogCategory category);
+        ~Log();
+        Log(const Log &) = delete;
+        Log &operator=(const Log &) = delete;
+
+        template <typename T>
+        Log &operator<<(const T &value)
+        {
+            if (m_enabled)
+                m_line << value;
+            return *this;
+        }
+
+    private:
+        bool m_enabled;
+        std::ostringstream m_line;
+    };
+
+#define FMS_LOG(level, category)              \
+    if (!::fms::logEnabled(level))            \
+    {                                         \
+    }                                         \
+    else                                      \
+        ::fms::Log(level, category)
+
+    // -----------------------------------------------------------------------
+    // Main-thread dispatch – how the core reaches the UI thread
+    //
+    // The component installs fb2k::inMainThread; without a dispatcher the
+    // function runs on the calling thread.
+    // -----------------------------------------------------------------------
+    using MainThreadDispatcher = std::function<void(std::function<void()>)>;
+
+    void setMainThreadDispatcher(MainThreadDispatcher dispatcher);
+
+    void runInMainThread(std::function<void()> fn);
+
+} // namespace fms
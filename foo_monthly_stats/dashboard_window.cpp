@@ -4,34 +4,10 @@
 #include "preferences.h"
 #include "resource.h"
 #include "i18n.h"
+#include "db_stats.h"
 
 namespace fms
 {
-    // ---------------------------------------------------------------------------
-    // Playback callback for auto-refresh
-    // ---------------------------------------------------------------------------
-    class DashboardWindow::PlaybackCallbackImpl : public play_callback_impl_base
-    {
-    public:
-        explicit PlaybackCallbackImpl(DashboardWindow *owner)
-            : play_callback_impl_base(flag_on_playback_stop), m_owner(owner)
-        {
-        }
-
-        void on_playback_stop(play_control::t_stop_reason reason) override
-        {
-            // Auto-refresh dashboard when playback stops
-            // Use a timer to delay the update, allowing async DB write to complete
-            if (m_owner && m_owner->IsWindow())
-            {
-                m_owner->SetTimer(1, 200); // 200ms delay
-            }
-        }
-
-    private:
-        DashboardWindow *m_owner;
-    };
-
     DashboardWindow *DashboardWindow::s_instance = nullptr;
 
     // ---------------------------------------------------------------------------
@@ -56,6 +32,12 @@ namespace fms
             s_instance->DestroyWindow();
     }
 
+    void DashboardWindow::WatchBackup()
+    {
+        if (s_instance && s_instance->IsWindow())
+            s_instance->SetTimer(4, 250);
+    }
+
     // ---------------------------------------------------------------------------
     // Window messages
     // ---------------------------------------------------------------------------
@@ -67,10 +49,16 @@ namespace fms
         SetupListColumns();
         UpdatePeriodLabel();
         UpdateExportFormatButton();
+        SendDlgItemMessage(IDC_EDIT_FILTER, EM_SETCUEBANNER, FALSE, (LPARAM)L"Search title / artist / album");
         Populate();
 
-        // Register playback callback for auto-refresh
-        m_playback_callback = std::make_unique<PlaybackCallbackImpl>(this);
+        // Refresh when the worker has committed plays for the displayed period
+        m_commitToken = DbManager::get().subscribe([this](const CommitEvent &event)
+                                                   { OnCommit(event); });
+
+        // A scheduled backup may already be running
+        if (UpdateBackupStatus())
+            SetTimer(4, 250);
 
         return TRUE;
     }
@@ -83,20 +71,21 @@ namespace fms
 
     void DashboardWindow::OnDestroy()
     {
-        KillTimer(1); // Stop any pending timer
+        DbManager::get().unsubscribe(m_commitToken);
         KillTimer(2); // Stop export status restoration timer
         KillTimer(3); // Stop export format toggle status restoration timer
+        KillTimer(4); // Stop backup progress polling
+        KillTimer(5); // Stop filter debounce
+        KillTimer(6); // Stop album art progress polling
+        m_artCollector.reset(); // aborts and waits for the lookups in flight
+        if (m_exportThread.joinable())
+            m_exportThread.join(); // lets an Export Year batch finish its files
         s_instance = nullptr;
     }
 
     void DashboardWindow::OnTimer(UINT_PTR nIDEvent)
     {
-        if (nIDEvent == 1)
-        {
-            KillTimer(1);
-            Populate(); // Refresh after DB write completes
-        }
-        else if (nIDEvent == 2)
+        if (nIDEvent == 2)
         {
             KillTimer(2);
             Populate(); // Restore normal status display (tracks count and listening time)
@@ -106,6 +95,63 @@ namespace fms
             KillTimer(3);
             Populate(); // Restore normal status display after export format toggle
         }
+        else if (nIDEvent == 4)
+        {
+            if (!UpdateBackupStatus())
+            {
+                KillTimer(4);
+                Populate(); // Backup finished: restore normal status display
+            }
+        }
+        else if (nIDEvent == 5)
+        {
+            KillTimer(5);
+            Populate(); // Typing paused: apply the filter
+        }
+        else if (nIDEvent == 6)
+        {
+            UpdateArtStatus();
+        }
+    }
+
+    void DashboardWindow::OnFilterChange(UINT, int, CWindow)
+    {
+        // Debounce: search once typing pauses instead of on every keystroke
+        SetTimer(5, 150);
+    }
+
+    void DashboardWindow::OnCommit(const CommitEvent &event)
+    {
+        // Days are "YYYY-MM-DD"; the displayed period is a prefix of the days it covers
+        for (const auto &day : event.days)
+        {
+            if (day.compare(0, m_period.size(), m_period) == 0)
+            {
+                Populate();
+                return;
+            }
+        }
+    }
+
+    // Returns false when no backup is running
+    bool DashboardWindow::UpdateBackupStatus()
+    {
+        int copied = 0, total = 0;
+        if (!DbManager::get().backupProgress(copied, total))
+            return false;
+        int percent = total > 0 ? static_cast<int>(100LL * copied / total) : 0;
+        std::string msg = "Backing up database... " + std::to_string(percent) + "%";
+        SetStatus(msg.c_str());
+        return true;
+    }
+
+    void DashboardWindow::UpdateArtStatus()
+    {
+        if (!m_artCollector)
+            return;
+        std::string msg = "Collecting album art... " + std::to_string(m_artCollector->done()) + " / " +
+                          std::to_string(m_artCollector->total()) + " (click Cancel to stop)";
+        SetStatus(msg.c_str());
     }
 
     void DashboardWindow::OnModeToggle(UINT, int, CWindow)
@@ -264,19 +310,16 @@ namespace fms
             if (index >= 0 && index < static_cast<int>(m_entries.size()))
             {
                 const auto &entry = m_entries[index];
-                DbManager::get().deleteEntry(entry.ymd, entry.track_crc);
+                DbManager::get().postDeleteEntry(entry.ymd, entry.track_crc);
             }
         }
-
-        // Refresh the display
-        Populate();
+        // The worker's CommitEvent refreshes the display (OnCommit)
     }
 
     void DashboardWindow::OnReset(UINT, int, CWindow)
     {
-        // Recalculate this period from play_log
-        DbManager::get().refreshPeriod(m_period, m_viewMode == YEAR);
-        Populate();
+        // Recalculate this period from play_log; OnCommit repaints once the worker is done
+        DbManager::get().postRefreshPeriod(m_period, m_viewMode == YEAR);
     }
 
     void DashboardWindow::UpdateExportFormatButton()
@@ -284,32 +327,34 @@ namespace fms
         HWND hBtn = GetDlgItem(IDC_BTN_EXPORT_FORMAT);
         if (hBtn)
         {
-            const char *btnText = m_exportFormatIsSmartphone ? "Export: Smartphone (1080x1980)" : "Export: Desktop";
+            const char *btnText = m_exportFormat == ReportFormat::Smartphone ? "Export: Smartphone (1080x1980)"
+                                  : m_exportFormat == ReportFormat::Paged    ? "Export: Paged (large lists)"
+                                                                             : "Export: Desktop";
             SetDlgItemTextA(m_hWnd, IDC_BTN_EXPORT_FORMAT, btnText);
         }
     }
 
     void DashboardWindow::OnToggleExportFormat(UINT, int, CWindow)
     {
-        // Toggle between Desktop and Smartphone format
-        m_exportFormatIsSmartphone = !m_exportFormatIsSmartphone;
+        // Cycle Desktop -> Smartphone -> Paged
+        m_exportFormat = m_exportFormat == ReportFormat::Desktop      ? ReportFormat::Smartphone
+                         : m_exportFormat == ReportFormat::Smartphone ? ReportFormat::Paged
+                                                                      : ReportFormat::Desktop;
         UpdateExportFormatButton();
 
         // Update status message
-        const char *statusMsg = m_exportFormatIsSmartphone
-                                    ? "Smartphone (1080x1980px, Top 5/10)"
-                                    : "Desktop (full)";
+        const char *statusMsg = m_exportFormat == ReportFormat::Smartphone ? "Smartphone (1080x1980px, Top 5/10)"
+                                : m_exportFormat == ReportFormat::Paged    ? "Paged (all tracks, rendered while scrolling)"
+                                                                           : "Desktop (full)";
         SetStatus(statusMsg);
 
         // Schedule restoration of normal status display after 3 seconds
         SetTimer(3, 3000);
     }
 
-    void DashboardWindow::OnExport(UINT, int, CWindow)
+    // Save dialog opening in the Downloads folder with defaultName filled in
+    bool DashboardWindow::AskSavePath(const std::string &defaultName, std::wstring &path)
     {
-        // Use the pre-selected format (m_exportFormatIsSmartphone)
-
-        // Ask user for save location - use Downloads folder as default
         wchar_t htmlBuf[MAX_PATH] = {};
 
         // Get Downloads folder path using SHGetKnownFolderPath
@@ -321,14 +366,7 @@ namespace fms
             CoTaskMemFree(pDownloadPath);
             initialPath += L"\\";
         }
-
-        // Append default filename (with _smartphone suffix if applicable)
-        std::string filenameSuffix = m_viewMode == MONTH ? m_period : ("year_" + m_period);
-        if (m_exportFormatIsSmartphone)
-            filenameSuffix += "_smartphone";
-        std::wstring defaultName = pfc::stringcvt::string_wide_from_utf8(
-            ("report_" + filenameSuffix + ".html").c_str());
-        initialPath += defaultName;
+        initialPath += pfc::stringcvt::string_wide_from_utf8(defaultName.c_str());
         wcsncpy_s(htmlBuf, MAX_PATH, initialPath.c_str(), _TRUNCATE);
 
         OPENFILENAMEW ofn{};
@@ -340,16 +378,118 @@ namespace fms
         ofn.lpstrDefExt = L"html";
         ofn.Flags = OFN_OVERWRITEPROMPT | OFN_NOCHANGEDIR;
         if (!GetSaveFileNameW(&ofn))
+            return false;
+
+        path = htmlBuf;
+        return true;
+    }
+
+    // Suffix of the default file names for the selected format
+    static const char *formatSuffix(ReportFormat format)
+    {
+        return format == ReportFormat::Smartphone ? "_smartphone" : format == ReportFormat::Paged ? "_paged" : "";
+    }
+
+    void DashboardWindow::OnExport(UINT, int, CWindow)
+    {
+        // While album art is being collected the button reads "Cancel"
+        if (m_artCollector)
+        {
+            m_artCollector->abort();
             return;
+        }
 
-        std::wstring htmlPath = htmlBuf;
+        // Use the pre-selected format (m_exportFormat); ask user for save location
+        std::string filenameSuffix = m_viewMode == MONTH ? m_period : ("year_" + m_period);
+        std::wstring htmlPath;
+        if (!AskSavePath("report_" + filenameSuffix + formatSuffix(m_exportFormat) + ".html", htmlPath))
+            return;
 
-        // Collect album art for each entry (runs on main thread, SDK access allowed)
-        std::map<std::string, std::string> artMap = ReportExporter::collectArt(m_entries);
+        m_pendingExport.htmlPath = htmlPath;
+        m_pendingExport.periodLabel = m_viewMode == MONTH ? ("Monthly Stats – " + m_period) : ("Yearly Stats – " + m_period);
+        m_pendingExport.entries = m_entries;
+        m_pendingExport.format = m_exportFormat;
+        StartExport();
+    }
+
+    void DashboardWindow::OnExportYear(UINT, int, CWindow)
+    {
+        if (m_artCollector)
+            return;
 
-        // Generate HTML (Desktop or Smartphone format)
-        std::string periodLabel = m_viewMode == MONTH ? ("Monthly Stats – " + m_period) : ("Yearly Stats – " + m_period);
-        std::string err = ReportExporter::exportHtml(periodLabel, m_entries, htmlPath, artMap, m_exportFormatIsSmartphone);
+        // Every month of the shown year and the year itself, next to an index page
+        const std::string year = m_period.substr(0, 4);
+        const std::string suffix = formatSuffix(m_exportFormat);
+        std::wstring indexPath;
+        if (!AskSavePath("report_" + year + suffix + "_index.html", indexPath))
+            return;
+
+        // One query for the months and the year; the year rows cover every track
+        // of them, so the art is collected once for all reports
+        m_pendingExport.htmlPath = indexPath;
+        m_pendingExport.periodLabel = "Stats – " + year;
+        m_pendingExport.format = m_exportFormat;
+        for (auto &[ym, entries] : DbManager::get().queryYearByMonth(year, &m_pendingExport.entries))
+            m_pendingExport.batch.push_back({"Monthly Stats – " + ym, "report_" + ym + suffix + ".html", std::move(entries)});
+        m_pendingExport.batch.push_back({"Yearly Stats – " + year, "report_year_" + year + suffix + ".html",
+                                         m_pendingExport.entries});
+        StartExport();
+    }
+
+    void DashboardWindow::StartExport()
+    {
+        // Album art is collected in the background; the export continues in OnArtCollected
+        KillTimer(2);
+        static unsigned s_lastExportId = 0;
+        const unsigned exportId = m_exportId = ++s_lastExportId; // tells a closed window's late result apart
+        m_artCollector = ArtCollector::start(m_pendingExport.entries, [exportId](const ArtCollector::ArtMap &art, bool aborted)
+                                             {
+                                                 if (s_instance && s_instance->m_exportId == exportId)
+                                                     s_instance->OnArtCollected(art, aborted);
+                                             });
+        SetDlgItemTextA(m_hWnd, IDC_BTN_EXPORT, "Cancel");
+        ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT_YEAR), FALSE);
+        UpdateArtStatus();
+        SetTimer(6, 200);
+    }
+
+    void DashboardWindow::OnArtCollected(const ArtCollector::ArtMap &art, bool aborted)
+    {
+        KillTimer(6);
+        m_artCollector.reset();
+        SetDlgItemTextA(m_hWnd, IDC_BTN_EXPORT, "Export...");
+        ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT_YEAR), TRUE);
+        PendingExport pending = std::move(m_pendingExport);
+        m_pendingExport = PendingExport();
+        if (aborted)
+        {
+            SetStatus("Export cancelled.");
+            SetTimer(2, 3000);
+            return;
+        }
+
+        // Export Year: the reports share the art and are written in parallel on a
+        // thread of their own; both export buttons wait for it in OnBatchWritten
+        if (!pending.batch.empty())
+        {
+            ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT), FALSE);
+            ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT_YEAR), FALSE);
+            SetStatus(("Writing " + std::to_string(pending.batch.size()) + " reports...").c_str());
+            if (m_exportThread.joinable())
+                m_exportThread.join(); // the batch before, already done
+            const unsigned exportId = m_exportId;
+            m_exportThread = std::thread([exportId, pending = std::move(pending), art]
+                                         {
+                std::string err = ReportExporter::exportBatch(pending.periodLabel, pending.batch, pending.htmlPath, art, pending.format);
+                fb2k::inMainThread([exportId, err = std::move(err), reports = pending.batch.size()]
+                                   {
+                    if (s_instance && s_instance->m_exportId == exportId)
+                        s_instance->OnBatchWritten(err, reports); }); });
+            return;
+        }
+
+        // Generate HTML (Desktop, Smartphone or Paged format)
+        std::string err = ReportExporter::exportHtml(pending.periodLabel, pending.entries, pending.htmlPath, art, pending.format);
         if (!err.empty())
         {
             SetStatus(err.c_str());
@@ -371,7 +511,7 @@ namespace fms
 
         // Calculate total time for export confirmation message
         double totalSeconds = 0.0;
-        for (const auto &e : m_entries)
+        for (const auto &e : pending.entries)
         {
             totalSeconds += e.total_time_seconds;
         }
@@ -379,14 +519,30 @@ namespace fms
         int minutes = static_cast<int>((totalSeconds - hours * 3600) / 60);
         int seconds = static_cast<int>(totalSeconds - hours * 3600 - minutes * 60);
 
-        std::string formatStr = m_exportFormatIsSmartphone ? " (Smartphone format)" : " (Desktop format)";
-        std::string exportMsg = "Export succeeded." + formatStr + " (" + std::to_string(m_entries.size()) +
+        std::string formatStr = pending.format == ReportFormat::Smartphone ? " (Smartphone format)"
+                                : pending.format == ReportFormat::Paged    ? " (Paged format)"
+                                                                           : " (Desktop format)";
+        std::string exportMsg = "Export succeeded." + formatStr + " (" + std::to_string(pending.entries.size()) +
                                 " tracks, " + std::to_string(hours) + "h " + std::to_string(minutes) + "m " + std::to_string(seconds) + "s)";
         SetStatus(exportMsg.c_str());
 
         // Schedule restoration of normal status display after 3 seconds
         SetTimer(2, 3000);
     }
+
+    void DashboardWindow::OnBatchWritten(const std::string &err, size_t reports)
+    {
+        ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT), TRUE);
+        ::EnableWindow(GetDlgItem(IDC_BTN_EXPORT_YEAR), TRUE);
+        if (!err.empty())
+        {
+            SetStatus(err.c_str());
+            return;
+        }
+        std::string exportMsg = "Export succeeded. (" + std::to_string(reports) + " reports and an index page)";
+        SetStatus(exportMsg.c_str());
+        SetTimer(2, 3000);
+    }
     void DashboardWindow::OnPreferences(UINT, int, CWindow)
     {
         // Open preferences page via foobar2000 API
@@ -499,7 +655,14 @@ namespace fms
 
     void DashboardWindow::Populate()
     {
-        if (m_viewMode == MONTH)
+        // Whole refresh incl. the list view; the query part is timed inside DbManager
+        DbStats::Timer timer("ui.populate");
+
+        wchar_t filter[256] = {};
+        GetDlgItemTextW(m_hWnd, IDC_EDIT_FILTER, filter, _countof(filter));
+        if (filter[0])
+            m_entries = DbManager::get().search(m_period, pfc::stringcvt::string_utf8_from_os(filter).get_ptr());
+        else if (m_viewMode == MONTH)
             m_entries = DbManager::get().queryMonth(m_period);
         else if (m_viewMode == DAY)
             m_entries = DbManager::get().queryDay(m_period);
@@ -568,28 +731,106 @@ namespace fms
     // ---------------------------------------------------------------------------
     static const GUID guid_mainmenu_group = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x03}};
     static const GUID guid_cmd_open_stats = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x04}};
+    static const GUID guid_cmd_backup_now = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0c}};
+    static const GUID guid_cmd_record_db_stats = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0e}};
+    static const GUID guid_cmd_dump_db_stats = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0f}};
 
     class FmsMainMenuCmd : public mainmenu_commands
     {
     public:
-        t_uint32 get_command_count() override { return 1; }
-        GUID get_command(t_uint32) override { return guid_cmd_open_stats; }
-        void get_name(t_uint32, pfc::string_base &out) override { out = "Monthly Stats..."; }
-        bool get_description(t_uint32, pfc::string_base &out) override
+        enum
+        {
+            cmd_open_stats,
+            cmd_backup_now,
+            cmd_record_db_stats,
+            cmd_dump_db_stats,
+            cmd_count
+        };
+
+        t_uint32 get_command_count() override { return cmd_count; }
+        GUID get_command(t_uint32 idx) override
         {
-            out = "Open the Monthly Stats dashboard window.";
+            switch (idx)
+            {
+            case cmd_backup_now:
+                return guid_cmd_backup_now;
+            case cmd_record_db_stats:
+                return guid_cmd_record_db_stats;
+            case cmd_dump_db_stats:
+                return guid_cmd_dump_db_stats;
+            default:
+                return guid_cmd_open_stats;
+            }
+        }
+        void get_name(t_uint32 idx, pfc::string_base &out) override
+        {
+            switch (idx)
+            {
+            case cmd_backup_now:
+                out = "Monthly Stats: Backup now";
+                break;
+            case cmd_record_db_stats:
+                out = "Monthly Stats: Record DB statistics";
+                break;
+            case cmd_dump_db_stats:
+                out = "Monthly Stats: Dump stats diagnostics";
+                break;
+            default:
+                out = "Monthly Stats...";
+            }
+        }
+        bool get_description(t_uint32 idx, pfc::string_base &out) override
+        {
+            switch (idx)
+            {
+            case cmd_backup_now:
+                out = "Back up the Monthly Stats database files while playback keeps recording.";
+                break;
+            case cmd_record_db_stats:
+                out = "Record call counts, rows and latency histograms of every Monthly Stats database statement.";
+                break;
+            case cmd_dump_db_stats:
+                out = "Print the recorded Monthly Stats database statistics to the console and write them as JSON next to the database.";
+                break;
+            default:
+                out = "Open the Monthly Stats dashboard window.";
+            }
             return true;
         }
         bool get_display(t_uint32 idx, pfc::string_base &out, t_uint32 &flags) override
         {
             get_name(idx, out);
-            flags = 0;
+            flags = (idx == cmd_record_db_stats && g_cfg_db_stats.get()) ? mainmenu_commands::flag_checked : 0;
             return true;
         }
         GUID get_parent() override { return mainmenu_groups::view; }
-        void execute(t_uint32, mainmenu_commands::ctx_t) override
+        void execute(t_uint32 idx, mainmenu_commands::ctx_t) override
         {
-            DashboardWindow::Open();
+            switch (idx)
+            {
+            case cmd_backup_now:
+                startBackup();
+                DashboardWindow::WatchBackup();
+                return;
+            case cmd_record_db_stats:
+                g_cfg_db_stats = !g_cfg_db_stats.get();
+                if (g_cfg_db_stats.get())
+                    DbStats::get().reset(); // each recording starts from empty tables
+                DbStats::get().setEnabled(g_cfg_db_stats.get());
+                return;
+            case cmd_dump_db_stats:
+            {
+                DbStats::get().dump();
+                std::string path = effectiveDbStatsPath();
+                if (DbStats::get().writeJson(path))
+                    FB2K_console_formatter() << "foo_monthly_stats: DB stats written to " << path.c_str();
+                else
+                    FB2K_console_formatter() << "foo_monthly_stats: Could not write " << path.c_str();
+                return;
+            }
+            default:
+                DashboardWindow::Open();
+            }
         }
     };
 
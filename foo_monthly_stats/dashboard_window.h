@@ -2,6 +2,8 @@
 #include "stdafx.h"
 #include "resource.h"
 #include "db_manager.h"
+#include "art_collector.h"
+#include "report_exporter.h"
 
 namespace fms
 {
@@ -12,6 +14,7 @@ namespace fms
         {IDC_BTN_PREV, 0, 0, 0, 0},        // fixed left-top
         {IDC_STATIC, 0, 0, 0, 0},          // fixed width and position (do not expand)
         {IDC_BTN_NEXT, 0, 0, 0, 0},        // fixed left-top
+        {IDC_EDIT_FILTER, 0, 0, 1, 0},     // stretches with the window width
         {IDC_BTN_DELETE, 1, 0, 1, 0},      // anchored to right, follows right edge
         {IDC_BTN_RESET, 1, 0, 1, 0},       // anchored to right, follows right edge
         // Main list view: expands in all directions
@@ -21,6 +24,7 @@ namespace fms
         {IDC_BTN_EXPORT, 0, 1, 0, 1},        // fixed left, anchored to bottom
         {IDC_BTN_EXPORT_FORMAT, 0, 1, 0, 1}, // fixed position, anchored to bottom
         {IDC_BTN_PREFERENCES, 0, 1, 0, 1},   // fixed position, anchored to bottom
+        {IDC_BTN_EXPORT_YEAR, 0, 1, 0, 1},   // fixed position, anchored to bottom
         {IDC_STATIC_STATUS, 0, 1, 0, 1},     // fixed position, anchored to bottom
     };
 
@@ -48,6 +52,7 @@ namespace fms
 
         static void Open(); // Creates or activates the singleton window
         static void Close();
+        static void WatchBackup(); // Shows backup progress in the status bar while it runs
 
         BEGIN_MSG_MAP_EX(DashboardWindow)
         CHAIN_MSG_MAP_MEMBER(m_resizer)
@@ -62,7 +67,9 @@ namespace fms
         COMMAND_HANDLER_EX(IDC_BTN_RESET, BN_CLICKED, OnReset)
         COMMAND_HANDLER_EX(IDC_BTN_EXPORT_FORMAT, BN_CLICKED, OnToggleExportFormat)
         COMMAND_HANDLER_EX(IDC_BTN_EXPORT, BN_CLICKED, OnExport)
+        COMMAND_HANDLER_EX(IDC_BTN_EXPORT_YEAR, BN_CLICKED, OnExportYear)
         COMMAND_HANDLER_EX(IDC_BTN_PREFERENCES, BN_CLICKED, OnPreferences)
+        COMMAND_HANDLER_EX(IDC_EDIT_FILTER, EN_CHANGE, OnFilterChange)
         NOTIFY_HANDLER_EX(IDC_LIST_TRACKS, LVN_COLUMNCLICK, OnColumnClick)
         END_MSG_MAP()
 
@@ -78,7 +85,9 @@ namespace fms
         void OnReset(UINT, int, CWindow);
         void OnToggleExportFormat(UINT, int, CWindow);
         void OnExport(UINT, int, CWindow);
+        void OnExportYear(UINT, int, CWindow);
         void OnPreferences(UINT, int, CWindow);
+        void OnFilterChange(UINT, int, CWindow);
         LRESULT OnColumnClick(LPNMHDR);
 
         void SetupListColumns();
@@ -86,20 +95,40 @@ namespace fms
         void UpdatePeriodLabel();
         void SetStatus(const char *msg);
         void UpdateExportFormatButton();
+        bool UpdateBackupStatus();
+        void UpdateArtStatus();
+        bool AskSavePath(const std::string &defaultName, std::wstring &path);
+        void StartExport(); // collects the art of m_pendingExport
+        void OnArtCollected(const ArtCollector::ArtMap &art, bool aborted);
+        void OnBatchWritten(const std::string &err, size_t reports);
+        void OnCommit(const CommitEvent &event);
 
         ViewMode m_viewMode = MONTH;
         std::string m_period; // "YYYY-MM", "YYYY", or "YYYY-MM-DD"
         std::vector<MonthlyEntry> m_entries;
         int m_sortCol = 4; // default: sort by plays
         bool m_sortAsc = false;
-        bool m_exportFormatIsSmartphone = false; // Toggle between Desktop and Smartphone HTML export
+        ReportFormat m_exportFormat = ReportFormat::Desktop; // Cycles Desktop -> Smartphone -> Paged
 
         // Dialog resize helper for auto-layout management
         CDialogResizeHelper m_resizer;
 
-        // Playback callback for auto-refresh
-        class PlaybackCallbackImpl;
-        std::unique_ptr<PlaybackCallbackImpl> m_playback_callback;
+        // DbManager commit subscription for auto-refresh
+        int m_commitToken = 0;
+
+        // Export waiting for its album art (the Export button cancels it meanwhile)
+        struct PendingExport
+        {
+            std::wstring htmlPath;             // the index page for a batch
+            std::string periodLabel;           // its title for a batch
+            std::vector<MonthlyEntry> entries; // art is collected for these
+            ReportFormat format = ReportFormat::Desktop;
+            std::vector<BatchReport> batch; // Export Year: every month plus the year
+        };
+        PendingExport m_pendingExport;
+        std::shared_ptr<ArtCollector> m_artCollector;
+        std::thread m_exportThread; // writes an Export Year batch
+        unsigned m_exportId = 0;
 
         static DashboardWindow *s_instance;
     };
@@ -1,5 +1,9 @@
-#include "stdafx.h"
+#include "core.h"
 #include "db_manager.h"
+#include "period.h"
+#include "hot_aggregate.h"
+#include "query_cache.h"
+#include "db_stats.h"
 
 namespace fms
 {
@@ -33,6 +37,49 @@ namespace fms
         return buf;
     }
 
+    // file: URI for ATTACH with query parameters (connection is opened with SQLITE_OPEN_URI)
+    static std::string sqliteUri(const std::string &path, const char *params)
+    {
+        std::string uri = "file:";
+        if (path.size() > 1 && path[1] == ':')
+            uri += "///"; // drive letter: file:///C:/...
+        for (char c : path)
+        {
+            switch (c)
+            {
+            case '\\':
+                uri += '/';
+                break;
+            case '?':
+                uri += "%3f";
+                break;
+            case '#':
+                uri += "%23";
+                break;
+            case '%':
+                uri += "%25";
+                break;
+            default:
+                uri += c;
+            }
+        }
+        uri += '?';
+        uri += params;
+        return uri;
+    }
+
+    static bool attachDatabase(sqlite3 *db, const std::string &file, const std::string &schema)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        std::string sql = "ATTACH DATABASE ? AS " + schema;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+        sqlite3_bind_text(stmt, 1, file.c_str(), -1, SQLITE_TRANSIENT);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        return rc == SQLITE_DONE;
+    }
+
     // -----------------------------------------------------------------------
     // DbManager
     // -----------------------------------------------------------------------
@@ -41,7 +88,7 @@ namespace fms
 
     DbManager &DbManager::get() { return g_instance; }
 
-    DbManager::DbManager() = default;
+    DbManager::DbManager() : m_queryCache(std::make_unique<QueryCache>()) {}
 
     DbManager::~DbManager() { close(); }
 
@@ -50,14 +97,16 @@ namespace fms
         if (m_opened)
             return true;
 
-        int rc = sqlite3_open(dbPath, &m_db);
+        // URI filenames let closed-year partitions be attached with mode=ro
+        int rc = sqlite3_open_v2(dbPath, &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE | SQLITE_OPEN_URI, nullptr);
         if (rc != SQLITE_OK)
         {
-            FB2K_console_formatter() << "foo_monthly_stats: sqlite3_open failed: " << sqlite3_errmsg(m_db);
+            Log() << "foo_monthly_stats: sqlite3_open failed: " << sqlite3_errmsg(m_db);
             sqlite3_close(m_db);
             m_db = nullptr;
             return false;
         }
+        DbStats::get().attach(m_db);
 
         // Performance settings
         sqlite3_exec(m_db, "PRAGMA journal_mode=WAL;", nullptr, nullptr, nullptr);
@@ -65,9 +114,37 @@ namespace fms
 
         ensureSchema();
 
+        m_basePath = dbPath;
+        if (m_basePath.size() > 3 && m_basePath.compare(m_basePath.size() - 3, 3, ".db") == 0)
+            m_basePath.resize(m_basePath.size() - 3);
+
+        // Archive of compacted play_log rows (only present once retention has been applied)
+        m_archivePath = m_basePath + "_archive.db";
+        std::error_code ec;
+        if (std::filesystem::exists(std::filesystem::u8path(m_archivePath), ec))
+            attachArchive();
+
+        openPartitions();
+        rebuildHot();
+
+        // Databases from before the sessions table: derive sessions from the existing log once
+        bool backfillSessions = false;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT NOT EXISTS(SELECT 1 FROM sessions) AND EXISTS(SELECT 1 FROM play_log_all)",
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                    backfillSessions = sqlite3_column_int(stmt, 0) != 0;
+                sqlite3_finalize(stmt);
+            }
+        }
+
         m_running = true;
         m_thread = std::thread(&DbManager::workerThread, this);
         m_opened = true;
+        if (backfillSessions)
+            postSessionRebuild();
         return true;
     }
 
@@ -82,25 +159,282 @@ namespace fms
         }
         if (m_thread.joinable())
             m_thread.join();
+        // Dropped tasks may hold an unfinished backup; end it before the source connection closes
+        std::queue<std::function<void()>>().swap(m_tasks);
+        if (auto job = std::move(m_backupJob))
+            finishBackup(job, false);
+        {
+            std::lock_guard<std::mutex> lk(m_hotMutex);
+            ++m_hotGeneration;
+            std::atomic_store(&m_hot, std::shared_ptr<const HotAggregate>());
+        }
+        m_hotRebuildQueued = false;
+        m_queryCache->invalidateAll();
         if (m_db)
         {
+            DbStats::get().attach(nullptr);
             sqlite3_close(m_db);
             m_db = nullptr;
         }
+        m_archiveAttached = false;
+        {
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            m_partitions.clear();
+        }
+        m_partitionsToClose.clear();
         m_opened = false;
     }
 
-    void DbManager::postPlay(const TrackInfo &info)
+    void DbManager::postPlay(TrackInfo info)
+    {
+        if (!m_opened)
+            return;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_queue.push(std::move(info));
+        }
+        m_cv.notify_one();
+    }
+
+    void DbManager::postCompaction(int keepMonths)
+    {
+        if (!m_opened || keepMonths <= 0)
+            return;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_tasks.push([this, keepMonths]
+                         { compactLog(keepMonths); });
+        }
+        m_cv.notify_one();
+    }
+
+    void DbManager::postRefreshPeriod(const std::string &period, bool isYear)
+    {
+        postEdit([this, period, isYear]
+                 { refreshPeriod(period, isYear); });
+    }
+
+    void DbManager::postDeleteEntry(const std::string &ymd, const std::string &track_crc)
+    {
+        postEdit([this, ymd, track_crc]
+                 { deleteEntry(ymd, track_crc); });
+    }
+
+    // Edits share the worker's connection with the play batches, so they never land
+    // inside a batch transaction; unlike maintenance tasks, close() still runs them
+    void DbManager::postEdit(std::function<void()> edit)
+    {
+        if (!m_opened)
+            return;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_edits.push(std::move(edit));
+        }
+        m_cv.notify_one();
+    }
+
+    void DbManager::setSessionGap(int minutes)
+    {
+        const int64_t gapMs = static_cast<int64_t>((std::max)(minutes, 1)) * 60 * 1000;
+        if (m_sessionGapMs.exchange(gapMs) != gapMs)
+            postSessionRebuild();
+    }
+
+    void DbManager::postSessionRebuild()
     {
         if (!m_opened)
             return;
         {
             std::unique_lock<std::mutex> lk(m_mutex);
-            m_queue.push(info);
+            m_tasks.push([this]
+                         { rebuildSessions(); });
+        }
+        m_cv.notify_one();
+    }
+
+    // -----------------------------------------------------------------------
+    // Online backup
+    // -----------------------------------------------------------------------
+    static constexpr int kBackupPagesPerStep = 64; // ~256 KiB per step at the default page size
+
+    struct DbManager::BackupJob
+    {
+        std::vector<std::pair<std::string, std::string>> files; // schema, destination path
+        size_t index = 0;
+        sqlite3 *dest = nullptr;
+        sqlite3_backup *backup = nullptr;
+        int copiedBefore = 0; // pages of files already finished
+        std::string destDir;
+        std::function<void(bool)> onDone;
+        std::chrono::steady_clock::time_point started;
+
+        void release()
+        {
+            if (backup)
+                sqlite3_backup_finish(backup);
+            if (dest)
+                sqlite3_close(dest);
+            backup = nullptr;
+            dest = nullptr;
+        }
+        ~BackupJob() { release(); }
+    };
+
+    void DbManager::postBackup(const std::string &destDir, std::function<void(bool)> onDone)
+    {
+        if (!m_opened)
+            return;
+        if (m_backupRunning.exchange(true))
+        {
+            Log() << "foo_monthly_stats: a backup is already running";
+            return;
+        }
+        auto job = std::make_shared<BackupJob>();
+        job->destDir = destDir;
+        job->onDone = std::move(onDone);
+        m_backupCopied = 0;
+        m_backupTotal = 0;
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_backupJob = job;
+            m_tasks.push([this, job]
+                         {
+                std::error_code ec;
+                std::filesystem::create_directories(std::filesystem::u8path(job->destDir), ec);
+
+                // Every file-backed schema: main, archive, log_YYYY
+                sqlite3_stmt *stmt = nullptr;
+                if (sqlite3_prepare_v2(m_db, "PRAGMA database_list", -1, &stmt, nullptr) == SQLITE_OK)
+                {
+                    while (sqlite3_step(stmt) == SQLITE_ROW)
+                    {
+                        const char *schema = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+                        const char *file = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+                        if (!schema || !file || !*file || strcmp(schema, "temp") == 0)
+                            continue;
+                        auto name = std::filesystem::u8path(file).filename();
+                        job->files.emplace_back(schema, (std::filesystem::u8path(job->destDir) / name).u8string());
+                    }
+                    sqlite3_finalize(stmt);
+                }
+
+                int total = 0;
+                for (const auto &f : job->files)
+                {
+                    std::string sql = "PRAGMA " + f.first + ".page_count";
+                    if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+                    {
+                        if (sqlite3_step(stmt) == SQLITE_ROW)
+                            total += sqlite3_column_int(stmt, 0);
+                        sqlite3_finalize(stmt);
+                    }
+                }
+                m_backupTotal = total;
+                job->started = std::chrono::steady_clock::now();
+                Log() << "foo_monthly_stats: backup started (" << job->files.size() << " file(s), "
+                      << total << " pages) -> " << job->destDir.c_str();
+                if (job->files.empty())
+                {
+                    Log() << "foo_monthly_stats: nothing to back up (in-memory database)";
+                    finishBackup(job, false);
+                }
+                else
+                    backupStep(job); });
         }
         m_cv.notify_one();
     }
 
+    bool DbManager::backupProgress(int &copiedPages, int &totalPages) const
+    {
+        if (!m_backupRunning)
+            return false;
+        totalPages = m_backupTotal;
+        copiedPages = (std::min)(m_backupCopied.load(), totalPages);
+        return true;
+    }
+
+    void DbManager::backupStep(const std::shared_ptr<BackupJob> &job)
+    {
+        const auto &file = job->files[job->index];
+        const std::string tmpPath = file.second + ".tmp";
+        if (!job->backup)
+        {
+            // Copy into "<name>.tmp" and rename when complete, so an interrupted run never replaces a good backup
+            if (sqlite3_open_v2(tmpPath.c_str(), &job->dest, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) == SQLITE_OK)
+                job->backup = sqlite3_backup_init(job->dest, "main", m_db, file.first.c_str());
+            if (!job->backup)
+            {
+                Log() << "foo_monthly_stats: backup of " << file.first.c_str() << " failed: "
+                      << (job->dest ? sqlite3_errmsg(job->dest) : "cannot open destination");
+                finishBackup(job, false);
+                return;
+            }
+        }
+
+        // Writes made through m_db between steps are mirrored into the destination by SQLite,
+        // so the copy never restarts while plays keep arriving.
+        int rc = sqlite3_backup_step(job->backup, kBackupPagesPerStep);
+        const int pages = sqlite3_backup_pagecount(job->backup);
+        m_backupCopied = job->copiedBefore + (pages - sqlite3_backup_remaining(job->backup));
+
+        if (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED)
+        {
+            // Yield to queued plays before the next batch
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_tasks.push([this, job]
+                         { backupStep(job); });
+            return;
+        }
+
+        rc = sqlite3_backup_finish(job->backup);
+        job->backup = nullptr;
+        sqlite3_close(job->dest);
+        job->dest = nullptr;
+        std::error_code ec;
+        if (rc == SQLITE_OK)
+            std::filesystem::rename(std::filesystem::u8path(tmpPath), std::filesystem::u8path(file.second), ec);
+        if (rc != SQLITE_OK || ec)
+        {
+            Log() << "foo_monthly_stats: backup of " << file.first.c_str() << " failed: "
+                  << (rc != SQLITE_OK ? sqlite3_errstr(rc) : ec.message().c_str());
+            finishBackup(job, false);
+            return;
+        }
+
+        job->copiedBefore += pages;
+        if (++job->index == job->files.size())
+        {
+            finishBackup(job, true);
+            return;
+        }
+        std::unique_lock<std::mutex> lk(m_mutex);
+        m_tasks.push([this, job]
+                     { backupStep(job); });
+    }
+
+    void DbManager::finishBackup(const std::shared_ptr<BackupJob> &job, bool ok)
+    {
+        job->release();
+        if (ok)
+        {
+            auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - job->started).count();
+            Log() << "foo_monthly_stats: backup complete (" << job->files.size() << " file(s), "
+                  << job->copiedBefore << " pages, " << ms << " ms) -> " << job->destDir.c_str();
+        }
+        else if (job->index < job->files.size())
+        {
+            std::error_code ec;
+            std::filesystem::remove(std::filesystem::u8path(job->files[job->index].second + ".tmp"), ec);
+        }
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            m_backupJob.reset();
+        }
+        m_backupRunning = false;
+        if (job->onDone)
+            job->onDone(ok);
+    }
+
     void DbManager::refreshPeriod(const std::string &period, bool isYear)
     {
         if (!m_db)
@@ -109,6 +443,25 @@ namespace fms
         // Determine mode from period string length: 4=Year, 7=Month, 10=Day
         bool isDay = (period.size() == 10);
 
+        // Rows of the period, before the delete and after the recalculation: what changed
+        CommitEvent event;
+        auto collectRows = [&]
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT ymd, track_crc FROM monthly_count WHERE ymd >= ?1 AND ymd < ?1 || '~'",
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                sqlite3_bind_text(stmt, 1, period.c_str(), -1, SQLITE_TRANSIENT);
+                while (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    event.days.insert(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)));
+                    event.track_crcs.insert(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)));
+                }
+                sqlite3_finalize(stmt);
+            }
+        };
+        collectRows();
+
         // 1. Delete existing monthly_count entries for this period
         {
             sqlite3_stmt *stmt = nullptr;
@@ -126,31 +479,96 @@ namespace fms
             }
         }
 
-        // 2. Recalculate from play_log
+        // 2. Recalculate from play_log – only the partition holding this period is scanned,
+        //    via the played_at index (plus legacy rows in main, normally none)
+        int64_t startMs = 0, endMs = 0;
+        if (periodBoundsMs(period, startMs, endMs))
+        {
+            std::vector<std::string> schemas{"main"};
+            int year = std::stoi(period.substr(0, 4));
+            if (hasPartition(year))
+                schemas.push_back("log_" + std::to_string(year));
+
+            for (const auto &schema : schemas)
+            {
+                sqlite3_stmt *stmt = nullptr;
+                std::string sql =
+                    "INSERT INTO monthly_count(ymd, track_crc, path, title, artist, album, length_seconds, playcount, total_time_seconds)"
+                    " SELECT strftime('%Y-%m-%d', datetime(played_at/1000, 'unixepoch', 'localtime')) AS ymd,"
+                    "        track_crc, path, title, artist, album,"
+                    "        MAX(length_seconds) AS length_seconds,"
+                    "        COUNT(*) AS playcount,"
+                    "        SUM(length_seconds) AS total_time_seconds"
+                    " FROM " +
+                    schema + ".play_log"
+                             " WHERE played_at >= ? AND played_at < ?"
+                             " GROUP BY ymd, track_crc, path, title, artist, album"
+                             " ON CONFLICT(ymd, track_crc) DO UPDATE SET playcount=playcount+excluded.playcount,"
+                             "  total_time_seconds=total_time_seconds+excluded.total_time_seconds,"
+                             "  length_seconds=MAX(length_seconds, excluded.length_seconds)";
+
+                if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+                {
+                    sqlite3_bind_int64(stmt, 1, startMs);
+                    sqlite3_bind_int64(stmt, 2, endMs);
+                    sqlite3_step(stmt);
+                    sqlite3_finalize(stmt);
+                }
+                else
+                {
+                    Log() << "foo_monthly_stats: refresh prepare error: " << sqlite3_errmsg(m_db);
+                }
+            }
+        }
+
+        // 3. Add days that only survive as archived aggregates
+        if (m_archiveAttached)
         {
             sqlite3_stmt *stmt = nullptr;
             const char *sql =
                 "INSERT INTO monthly_count(ymd, track_crc, path, title, artist, album, length_seconds, playcount, total_time_seconds)"
-                " SELECT strftime('%Y-%m-%d', datetime(played_at/1000, 'unixepoch', 'localtime')) AS ymd,"
-                "        track_crc, path, title, artist, album,"
-                "        MAX(length_seconds) AS length_seconds,"
-                "        COUNT(*) AS playcount,"
-                "        SUM(length_seconds) AS total_time_seconds"
-                " FROM play_log"
-                " WHERE strftime('%Y-%m-%d', datetime(played_at/1000, 'unixepoch', 'localtime'))"
-                "       LIKE ? ESCAPE '\\'"
-                " GROUP BY ymd, track_crc, path, title, artist, album";
+                " SELECT d.ymd, m.track_crc, m.path, m.title, m.artist, m.album,"
+                "        d.length_seconds, d.playcount, d.total_time_seconds"
+                " FROM archive.daily_log d JOIN archive.track_meta m ON m.id = d.meta_id"
+                " WHERE d.ymd >= ?1 AND d.ymd < ?1 || '~'"
+                " ON CONFLICT(ymd, track_crc) DO UPDATE SET playcount=playcount+excluded.playcount,"
+                "  total_time_seconds=total_time_seconds+excluded.total_time_seconds,"
+                "  length_seconds=MAX(length_seconds, excluded.length_seconds)";
+            if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                // "2026" / "2026-03" / "2026-03-04" prefix range: '~' sorts after every ymd character
+                sqlite3_bind_text(stmt, 1, period.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_step(stmt);
+                sqlite3_finalize(stmt);
+            }
+            else
+            {
+                Log() << "foo_monthly_stats: archive refresh prepare error: " << sqlite3_errmsg(m_db);
+            }
+        }
 
+        // 4. Tags of rows rebuilt from old plays (or the archive) may predate the search index
+        {
+            sqlite3_stmt *stmt = nullptr;
+            const char *sql =
+                "INSERT OR IGNORE INTO tag_index(title, artist, album)"
+                " SELECT DISTINCT COALESCE(title,''), COALESCE(artist,''), COALESCE(album,'') FROM monthly_count"
+                " WHERE ymd >= ?1 AND ymd < ?1 || '~'";
             if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
             {
-                // Year: "2026-%", Month: "2026-03-%", Day: "2026-03-04" (exact)
-                std::string pattern = isYear ? (period + "-%") : isDay ? period
-                                                                       : (period + "-%");
-                sqlite3_bind_text(stmt, 1, pattern.c_str(), -1, SQLITE_TRANSIENT);
+                sqlite3_bind_text(stmt, 1, period.c_str(), -1, SQLITE_TRANSIENT);
                 sqlite3_step(stmt);
                 sqlite3_finalize(stmt);
             }
         }
+
+        // Rows of this period changed: drop cached results that depend on it
+        std::string firstYmd = isDay ? period : isYear ? period + "-01-01" : period + "-01";
+        std::string lastYmd = isDay ? period : isYear ? period + "-12-31" : period + "-31";
+        m_queryCache->markWritten(firstYmd, lastYmd);
+        invalidateHot();
+        collectRows();
+        publishCommit(std::move(event));
     }
 
     void DbManager::deleteEntry(const std::string &ymd, const std::string &track_crc)
@@ -158,34 +576,537 @@ namespace fms
         if (!m_db)
             return;
 
+        bool deleted = false;
         sqlite3_stmt *stmt = nullptr;
         const char *sql = "DELETE FROM monthly_count WHERE ymd = ? AND track_crc = ?";
         if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
         {
             sqlite3_bind_text(stmt, 1, ymd.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_bind_text(stmt, 2, track_crc.c_str(), -1, SQLITE_TRANSIENT);
-            sqlite3_step(stmt);
+            deleted = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(m_db) > 0;
             sqlite3_finalize(stmt);
         }
+        m_queryCache->markWritten(ymd, ymd);
+        invalidateHot();
+        if (deleted)
+            publishCommit(CommitEvent{{ymd}, {track_crc}});
     }
 
     void DbManager::workerThread()
     {
         while (true)
         {
-            TrackInfo item;
+            std::vector<TrackInfo> batch;
+            std::function<void()> task;
             {
                 std::unique_lock<std::mutex> lk(m_mutex);
                 m_cv.wait(lk, [this]
-                          { return !m_queue.empty() || !m_running; });
-                if (!m_running && m_queue.empty())
+                          { return !m_queue.empty() || !m_edits.empty() || !m_tasks.empty() || !m_running; });
+                if (!m_running && m_queue.empty() && m_edits.empty())
+                    break; // pending maintenance tasks are dropped on shutdown
+                // Plays always go first so recording never waits behind maintenance;
+                // everything queued so far is committed as one transaction
+                if (!m_queue.empty())
+                {
+                    while (!m_queue.empty())
+                    {
+                        batch.push_back(std::move(m_queue.front()));
+                        m_queue.pop();
+                    }
+                }
+                else if (!m_edits.empty())
+                {
+                    task = std::move(m_edits.front());
+                    m_edits.pop();
+                }
+                else if (!m_tasks.empty())
+                {
+                    task = std::move(m_tasks.front());
+                    m_tasks.pop();
+                }
+                else
+                    continue;
+            }
+            if (task)
+                task();
+            else
+                insertBatch(batch);
+        }
+    }
+
+    bool DbManager::attachArchive()
+    {
+        if (m_archiveAttached)
+            return true;
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db, "ATTACH DATABASE ? AS archive", -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+        sqlite3_bind_text(stmt, 1, m_archivePath.c_str(), -1, SQLITE_TRANSIENT);
+        int rc = sqlite3_step(stmt);
+        sqlite3_finalize(stmt);
+        if (rc != SQLITE_DONE)
+        {
+            Log() << "foo_monthly_stats: failed to attach archive " << m_archivePath.c_str()
+                  << ": " << sqlite3_errmsg(m_db);
+            return false;
+        }
+
+        // Archive layout: metadata strings are stored once in track_meta, and each
+        // (day, track) keeps only its aggregate – a raw play_log row costs far more.
+        char *errmsg = nullptr;
+        sqlite3_exec(m_db,
+                     "PRAGMA archive.journal_mode=WAL;"
+                     "CREATE TABLE IF NOT EXISTS archive.track_meta ("
+                     "  id        INTEGER PRIMARY KEY,"
+                     "  track_crc TEXT NOT NULL,"
+                     "  path      TEXT NOT NULL DEFAULT '',"
+                     "  title     TEXT NOT NULL DEFAULT '',"
+                     "  artist    TEXT NOT NULL DEFAULT '',"
+                     "  album     TEXT NOT NULL DEFAULT '',"
+                     "  UNIQUE (track_crc, path, title, artist, album)"
+                     ");"
+                     "CREATE TABLE IF NOT EXISTS archive.daily_log ("
+                     "  ymd       TEXT NOT NULL,"
+                     "  meta_id   INTEGER NOT NULL,"
+                     "  length_seconds REAL NOT NULL DEFAULT 0,"
+                     "  playcount INTEGER NOT NULL DEFAULT 0,"
+                     "  total_time_seconds REAL NOT NULL DEFAULT 0,"
+                     "  PRIMARY KEY (ymd, meta_id)"
+                     ") WITHOUT ROWID;",
+                     nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            Log() << "foo_monthly_stats: archive schema error: " << errmsg;
+            sqlite3_free(errmsg);
+            sqlite3_exec(m_db, "DETACH DATABASE archive;", nullptr, nullptr, nullptr);
+            return false;
+        }
+
+        m_archiveAttached = true;
+        return true;
+    }
+
+    void DbManager::compactLog(int keepMonths)
+    {
+        // Cutoff = local midnight on the 1st of the month keepMonths before the current one
+        time_t now = time(nullptr);
+        struct tm local_tm;
+#ifdef _WIN32
+        localtime_s(&local_tm, &now);
+#else
+        localtime_r(&now, &local_tm);
+#endif
+        local_tm.tm_mon -= keepMonths; // mktime normalizes negative months
+        local_tm.tm_mday = 1;
+        local_tm.tm_hour = local_tm.tm_min = local_tm.tm_sec = 0;
+        local_tm.tm_isdst = -1;
+        int64_t cutoff = static_cast<int64_t>(mktime(&local_tm)) * 1000;
+
+        // Sources: legacy rows in main plus every year partition that starts before the cutoff
+        std::vector<int> years;
+        {
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            for (const auto &p : m_partitions)
+                if (localMidnightMs(p.first, 1, 1) < cutoff)
+                    years.push_back(p.first);
+        }
+        std::vector<std::string> schemas{"main"};
+        for (int y : years)
+            schemas.push_back("log_" + std::to_string(y));
+
+        int thisYear = std::stoi(currentYear());
+        int64_t archivedRows = 0;
+        bool partitionsChanged = false;
+        for (size_t i = 0; i < schemas.size(); ++i)
+        {
+            const std::string &schema = schemas[i];
+            int year = (i == 0) ? 0 : years[i - 1];
+
+            int64_t oldRows = 0;
+            {
+                sqlite3_stmt *stmt = nullptr;
+                std::string sql = "SELECT COUNT(*) FROM " + schema + ".play_log WHERE played_at < ?";
+                if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+                {
+                    sqlite3_bind_int64(stmt, 1, cutoff);
+                    if (sqlite3_step(stmt) == SQLITE_ROW)
+                        oldRows = sqlite3_column_int64(stmt, 0);
+                    sqlite3_finalize(stmt);
+                }
+            }
+            if (oldRows == 0)
+                continue;
+            if (!attachArchive())
+                return;
+            // Closed years are attached read-only; reopen for the delete
+            if (year != 0 && !ensureWritablePartition(year))
+                continue;
+
+            // Same aggregation as refreshPeriod, so archived and raw periods recalculate identically
+            const std::string steps[] = {
+                "INSERT OR IGNORE INTO archive.track_meta(track_crc, path, title, artist, album)"
+                " SELECT DISTINCT track_crc, path, COALESCE(title,''), COALESCE(artist,''), COALESCE(album,'')"
+                " FROM " + schema + ".play_log WHERE played_at < ?1",
+
+                "INSERT INTO archive.daily_log(ymd, meta_id, length_seconds, playcount, total_time_seconds)"
+                " SELECT strftime('%Y-%m-%d', datetime(l.played_at/1000, 'unixepoch', 'localtime')) AS ymd, m.id,"
+                "        MAX(l.length_seconds), COUNT(*), SUM(l.length_seconds)"
+                " FROM " + schema + ".play_log l JOIN archive.track_meta m"
+                "   ON m.track_crc = l.track_crc AND m.path = l.path AND m.title = COALESCE(l.title,'')"
+                "  AND m.artist = COALESCE(l.artist,'') AND m.album = COALESCE(l.album,'')"
+                " WHERE l.played_at < ?1"
+                " GROUP BY ymd, m.id"
+                " ON CONFLICT(ymd, meta_id) DO UPDATE SET playcount=playcount+excluded.playcount,"
+                "  total_time_seconds=total_time_seconds+excluded.total_time_seconds,"
+                "  length_seconds=MAX(length_seconds, excluded.length_seconds)",
+
+                "DELETE FROM " + schema + ".play_log WHERE played_at < ?1",
+            };
+
+            sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+            bool ok = true;
+            for (const std::string &sql : steps)
+            {
+                sqlite3_stmt *stmt = nullptr;
+                int rc = sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr);
+                if (rc == SQLITE_OK)
+                {
+                    sqlite3_bind_int64(stmt, 1, cutoff);
+                    rc = sqlite3_step(stmt);
+                    sqlite3_finalize(stmt);
+                }
+                if (rc != SQLITE_DONE && rc != SQLITE_OK)
+                {
+                    Log() << "foo_monthly_stats: play_log compaction error: " << sqlite3_errmsg(m_db);
+                    sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+                    ok = false;
                     break;
-                if (m_queue.empty())
+                }
+            }
+            if (!ok)
+                return;
+            sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+            archivedRows += oldRows;
+
+            if (year == 0 || year >= thisYear)
+                continue;
+
+            // A closed year that is now fully archived no longer needs its own file
+            bool empty = false;
+            {
+                sqlite3_stmt *stmt = nullptr;
+                std::string sql = "SELECT NOT EXISTS(SELECT 1 FROM " + schema + ".play_log)";
+                if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
+                {
+                    if (sqlite3_step(stmt) == SQLITE_ROW)
+                        empty = sqlite3_column_int(stmt, 0) != 0;
+                    sqlite3_finalize(stmt);
+                }
+            }
+            if (empty)
+            {
+                if (sqlite3_exec(m_db, ("DETACH DATABASE " + schema).c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+                {
+                    // Still read through play_log_all: keep the (empty) file, closed once the reader is done
+                    Log() << "foo_monthly_stats: detach " << schema.c_str() << " failed: " << sqlite3_errmsg(m_db);
+                    m_partitionsToClose.insert(year);
                     continue;
-                item = m_queue.front();
-                m_queue.pop();
+                }
+                {
+                    std::lock_guard<std::mutex> lk(m_partitionMutex);
+                    m_partitions.erase(year);
+                }
+                std::error_code ec;
+                std::string path = partitionPath(year);
+                std::filesystem::remove(std::filesystem::u8path(path), ec);
+                std::filesystem::remove(std::filesystem::u8path(path + "-wal"), ec);
+                std::filesystem::remove(std::filesystem::u8path(path + "-shm"), ec);
+                partitionsChanged = true;
+            }
+            else
+            {
+                closePartition(year);
+            }
+        }
+
+        if (partitionsChanged)
+            rebuildLogView();
+        if (archivedRows > 0)
+            Log() << "foo_monthly_stats: archived " << archivedRows << " play_log rows older than "
+                  << keepMonths << " months into " << m_archivePath.c_str();
+    }
+
+    // -----------------------------------------------------------------------
+    // Per-year play_log partitions
+    // -----------------------------------------------------------------------
+    std::string DbManager::partitionPath(int year) const
+    {
+        if (m_basePath.empty() || m_basePath == ":memory:")
+            return ":memory:";
+        return m_basePath + "_" + std::to_string(year) + ".db";
+    }
+
+    void DbManager::openPartitions()
+    {
+        namespace fs = std::filesystem;
+        if (partitionPath(0) != ":memory:")
+        {
+            const fs::path base = fs::u8path(m_basePath);
+            const std::string prefix = base.filename().u8string() + "_";
+            const fs::path dir = base.has_parent_path() ? base.parent_path() : fs::path(".");
+            const int thisYear = std::stoi(currentYear());
+
+            // "<stem>_YYYY.db"
+            std::error_code ec;
+            for (fs::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec))
+            {
+                std::string name = it->path().filename().u8string();
+                if (name.size() != prefix.size() + 7 || name.compare(0, prefix.size(), prefix) != 0 ||
+                    name.compare(name.size() - 3, 3, ".db") != 0)
+                    continue;
+                std::string digits = name.substr(prefix.size(), 4);
+                if (!std::all_of(digits.begin(), digits.end(), [](char c)
+                                 { return c >= '0' && c <= '9'; }))
+                    continue;
+                int year = std::stoi(digits);
+                attachPartition(year, year >= thisYear);
+            }
+        }
+
+        migrateLegacyLog();
+        rebuildLogView();
+    }
+
+    bool DbManager::attachPartition(int year, bool writable)
+    {
+        const bool inMemory = partitionPath(year) == ":memory:";
+        if (inMemory)
+            writable = true; // an in-memory schema would be lost on re-attach
+
+        const std::string schema = "log_" + std::to_string(year);
+        const std::string path = partitionPath(year);
+        bool attached = false;
+        {
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            auto it = m_partitions.find(year);
+            if (it != m_partitions.end())
+            {
+                if (it->second == writable || (inMemory && it->second))
+                    return true;
+                attached = true;
+            }
+        }
+        if (attached)
+        {
+            if (sqlite3_exec(m_db, ("DETACH DATABASE " + schema).c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+            {
+                Log() << "foo_monthly_stats: detach " << schema.c_str() << " failed: " << sqlite3_errmsg(m_db);
+                return false;
+            }
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            m_partitions.erase(year);
+        }
+
+        if (!writable)
+        {
+            // Closed year: leave WAL so the read-only attach needs no -wal/-shm and no checkpoints
+            if (attachDatabase(m_db, path, schema))
+            {
+                sqlite3_exec(m_db, ("PRAGMA " + schema + ".journal_mode=DELETE").c_str(), nullptr, nullptr, nullptr);
+                if (sqlite3_exec(m_db, ("DETACH DATABASE " + schema).c_str(), nullptr, nullptr, nullptr) != SQLITE_OK)
+                {
+                    // A UI statement reads it through play_log_all: it stays attached writable
+                    Log() << "foo_monthly_stats: detach " << schema.c_str() << " failed: " << sqlite3_errmsg(m_db);
+                    sqlite3_exec(m_db, ("PRAGMA " + schema + ".journal_mode=WAL").c_str(), nullptr, nullptr, nullptr);
+                    std::lock_guard<std::mutex> lk(m_partitionMutex);
+                    m_partitions[year] = true;
+                    return false;
+                }
             }
-            insertPlay(item);
+            if (!attachDatabase(m_db, sqliteUri(path, "mode=ro"), schema))
+                writable = true; // e.g. UNC paths the URI form cannot express – fall back to a normal attach
+        }
+        if (writable)
+        {
+            if (!attachDatabase(m_db, path, schema))
+            {
+                Log() << "foo_monthly_stats: attach " << path.c_str() << " failed: " << sqlite3_errmsg(m_db);
+                return false;
+            }
+            // On its own: WAL cannot be entered while a UI statement holds a read
+            // transaction, and the table must be created regardless
+            sqlite3_exec(m_db, ("PRAGMA " + schema + ".journal_mode=WAL").c_str(), nullptr, nullptr, nullptr);
+            const std::string ddl =
+                "PRAGMA " + schema + ".synchronous=NORMAL;"
+                "CREATE TABLE IF NOT EXISTS " + schema + ".play_log ("
+                "  id        INTEGER PRIMARY KEY,"
+                "  track_crc TEXT NOT NULL,"
+                "  path      TEXT NOT NULL DEFAULT '',"
+                "  title     TEXT,"
+                "  artist    TEXT,"
+                "  album     TEXT,"
+                "  length_seconds REAL NOT NULL DEFAULT 0,"
+                "  played_at INTEGER NOT NULL"
+                ");"
+                "CREATE INDEX IF NOT EXISTS " + schema + ".ix_played_at ON play_log(played_at);";
+            char *errmsg = nullptr;
+            sqlite3_exec(m_db, ddl.c_str(), nullptr, nullptr, &errmsg);
+            if (errmsg)
+            {
+                Log() << "foo_monthly_stats: " << schema.c_str() << " schema error: " << errmsg;
+                sqlite3_free(errmsg);
+            }
+        }
+
+        std::lock_guard<std::mutex> lk(m_partitionMutex);
+        m_partitions[year] = writable;
+        return true;
+    }
+
+    bool DbManager::ensureWritablePartition(int year)
+    {
+        bool isNew = false;
+        {
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            auto it = m_partitions.find(year);
+            if (it != m_partitions.end() && it->second)
+                return true;
+            isNew = (it == m_partitions.end());
+        }
+        if (!attachPartition(year, true))
+            return false;
+
+        if (isNew)
+        {
+            // First write of a new year: earlier years are closed from now on
+            // (a back-filled past year leaves the newer ones alone)
+            const int thisYear = std::stoi(currentYear());
+            std::vector<int> toClose;
+            {
+                std::lock_guard<std::mutex> lk(m_partitionMutex);
+                for (const auto &p : m_partitions)
+                    if (p.second && p.first < thisYear && p.first < year)
+                        toClose.push_back(p.first);
+            }
+            for (int y : toClose)
+                closePartition(y);
+            rebuildLogView();
+        }
+        return true;
+    }
+
+    void DbManager::closePartition(int year)
+    {
+        // Fails while a UI statement is stepping over the year; insertBatch tries again
+        if (!attachPartition(year, false))
+            m_partitionsToClose.insert(year);
+    }
+
+    void DbManager::retryPartitionCloses(const std::set<int> &writing)
+    {
+        if (m_partitionsToClose.empty())
+            return;
+        std::set<int> years;
+        for (int year : m_partitionsToClose)
+            if (!writing.count(year))
+                years.insert(year);
+        if (years.empty())
+            return;
+        for (int year : years)
+        {
+            m_partitionsToClose.erase(year);
+            closePartition(year);
+        }
+        // A year left unattached by an earlier failure is back in the view
+        rebuildLogView();
+    }
+
+    bool DbManager::hasPartition(int year)
+    {
+        std::lock_guard<std::mutex> lk(m_partitionMutex);
+        return m_partitions.count(year) != 0;
+    }
+
+    void DbManager::migrateLegacyLog()
+    {
+        // Rows written before partitioning live in main.play_log; move them into their year files once
+        std::vector<int> years;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            const char *sql =
+                "SELECT DISTINCT CAST(strftime('%Y', played_at/1000, 'unixepoch', 'localtime') AS INTEGER)"
+                " FROM main.play_log";
+            if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                while (sqlite3_step(stmt) == SQLITE_ROW)
+                    years.push_back(sqlite3_column_int(stmt, 0));
+                sqlite3_finalize(stmt);
+            }
+        }
+        if (years.empty())
+            return;
+
+        Log() << "foo_monthly_stats: moving play_log into " << years.size() << " yearly partition(s) ...";
+        const int thisYear = std::stoi(currentYear());
+        for (int year : years)
+        {
+            if (!attachPartition(year, true))
+                continue;
+            const std::string schema = "log_" + std::to_string(year);
+            const std::string steps[] = {
+                "INSERT INTO " + schema + ".play_log(track_crc, path, title, artist, album, length_seconds, played_at)"
+                " SELECT track_crc, path, title, artist, album, length_seconds, played_at FROM main.play_log"
+                " WHERE played_at >= ?1 AND played_at < ?2 ORDER BY played_at",
+                "DELETE FROM main.play_log WHERE played_at >= ?1 AND played_at < ?2",
+            };
+
+            sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+            bool ok = true;
+            for (const std::string &sql : steps)
+            {
+                sqlite3_stmt *stmt = nullptr;
+                int rc = sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr);
+                if (rc == SQLITE_OK)
+                {
+                    sqlite3_bind_int64(stmt, 1, localMidnightMs(year, 1, 1));
+                    sqlite3_bind_int64(stmt, 2, localMidnightMs(year + 1, 1, 1));
+                    rc = sqlite3_step(stmt);
+                    sqlite3_finalize(stmt);
+                }
+                if (rc != SQLITE_DONE && rc != SQLITE_OK)
+                {
+                    Log() << "foo_monthly_stats: play_log partition error: " << sqlite3_errmsg(m_db);
+                    ok = false;
+                    break;
+                }
+            }
+            sqlite3_exec(m_db, ok ? "COMMIT;" : "ROLLBACK;", nullptr, nullptr, nullptr);
+
+            if (year < thisYear)
+                closePartition(year);
+        }
+    }
+
+    void DbManager::rebuildLogView()
+    {
+        // play_log_all: every raw play regardless of which file holds it (full-history readers only)
+        std::string sql = "DROP VIEW IF EXISTS temp.play_log_all;"
+                          "CREATE TEMP VIEW play_log_all AS"
+                          " SELECT id, track_crc, path, title, artist, album, length_seconds, played_at FROM main.play_log";
+        {
+            std::lock_guard<std::mutex> lk(m_partitionMutex);
+            for (const auto &p : m_partitions)
+                sql += " UNION ALL SELECT id, track_crc, path, title, artist, album, length_seconds, played_at FROM log_" +
+                       std::to_string(p.first) + ".play_log";
+        }
+        sql += ";";
+        char *errmsg = nullptr;
+        sqlite3_exec(m_db, sql.c_str(), nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            Log() << "foo_monthly_stats: play_log_all view error: " << errmsg;
+            sqlite3_free(errmsg);
         }
     }
 
@@ -209,7 +1130,7 @@ namespace fms
                      nullptr, nullptr, &errmsg);
         if (errmsg)
         {
-            FB2K_console_formatter() << "foo_monthly_stats: play_log schema error: " << errmsg;
+            Log() << "foo_monthly_stats: play_log schema error: " << errmsg;
             sqlite3_free(errmsg);
         }
 
@@ -246,7 +1167,7 @@ namespace fms
             // Migrate from old schema (ym TEXT PRIMARY KEY) to new (ymd TEXT)
             // Strategy: create new table, copy with ym||'-01', swap
             // ---------------------------------------------------------------
-            FB2K_console_formatter() << "foo_monthly_stats: migrating monthly_count schema (ym -> ymd) ...";
+            Log() << "foo_monthly_stats: migrating monthly_count schema (ym -> ymd) ...";
             sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
 
             // Create new table with ymd column
@@ -266,7 +1187,7 @@ namespace fms
                          nullptr, nullptr, &errmsg);
             if (errmsg)
             {
-                FB2K_console_formatter() << "foo_monthly_stats: create new table error: " << errmsg;
+                Log() << "foo_monthly_stats: create new table error: " << errmsg;
                 sqlite3_free(errmsg);
                 sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
             }
@@ -283,14 +1204,14 @@ namespace fms
                              nullptr, nullptr, &errmsg);
                 if (errmsg)
                 {
-                    FB2K_console_formatter() << "foo_monthly_stats: copy data error: " << errmsg;
+                    Log() << "foo_monthly_stats: copy data error: " << errmsg;
                     sqlite3_free(errmsg);
                 }
 
                 sqlite3_exec(m_db, "DROP TABLE monthly_count;", nullptr, nullptr, nullptr);
                 sqlite3_exec(m_db, "ALTER TABLE monthly_count_new RENAME TO monthly_count;", nullptr, nullptr, nullptr);
                 sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
-                FB2K_console_formatter() << "foo_monthly_stats: schema migration complete";
+                Log() << "foo_monthly_stats: schema migration complete";
             }
         }
         else if (!hasYmColumn && !hasYmdColumn)
@@ -312,7 +1233,7 @@ namespace fms
                          nullptr, nullptr, &errmsg);
             if (errmsg)
             {
-                FB2K_console_formatter() << "foo_monthly_stats: monthly_count schema error: " << errmsg;
+                Log() << "foo_monthly_stats: monthly_count schema error: " << errmsg;
                 sqlite3_free(errmsg);
             }
         }
@@ -339,18 +1260,298 @@ namespace fms
                      ");",
                      nullptr, nullptr, nullptr);
 
-        // Remove duplicates on initialization (merge same titles by metadata)
-        removeDuplicates();
+        // Listening sessions, extended by every committed play (see extendSession)
+        sqlite3_exec(m_db,
+                     "CREATE TABLE IF NOT EXISTS sessions ("
+                     "  id        INTEGER PRIMARY KEY,"
+                     "  start_at  INTEGER NOT NULL,"
+                     "  end_at    INTEGER NOT NULL,"
+                     "  plays     INTEGER NOT NULL DEFAULT 0,"
+                     "  listened_seconds REAL NOT NULL DEFAULT 0"
+                     ");"
+                     "CREATE INDEX IF NOT EXISTS ix_sessions_end ON sessions(end_at);"
+                     "CREATE INDEX IF NOT EXISTS ix_sessions_start ON sessions(start_at);",
+                     nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            Log() << "foo_monthly_stats: sessions schema error: " << errmsg;
+            sqlite3_free(errmsg);
+        }
+
+        ensureSearchIndex();
+
+        // Remove duplicates on initialization (merge same titles by metadata)
+        removeDuplicates();
+    }
+
+    // -----------------------------------------------------------------------
+    // Search index: tag_index holds every title/artist/album combination that
+    // monthly_count rows carry (tags as they were when played), tag_fts is an
+    // external-content FTS5 index over it kept in sync by a trigger. Rows are
+    // matched by their own tags, so a retagged track is found under the tags
+    // each period shows for it.
+    // -----------------------------------------------------------------------
+    void DbManager::ensureSearchIndex()
+    {
+        char *errmsg = nullptr;
+        sqlite3_exec(m_db,
+                     // Superseded per-track index (latest tags only)
+                     "DROP TABLE IF EXISTS track_fts;"
+                     "DROP TABLE IF EXISTS track_index;"
+                     "CREATE TABLE IF NOT EXISTS tag_index ("
+                     "  id     INTEGER PRIMARY KEY,"
+                     "  title  TEXT NOT NULL DEFAULT '',"
+                     "  artist TEXT NOT NULL DEFAULT '',"
+                     "  album  TEXT NOT NULL DEFAULT '',"
+                     "  UNIQUE (title, artist, album)"
+                     ");",
+                     nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            Log() << "foo_monthly_stats: tag_index schema error: " << errmsg;
+            sqlite3_free(errmsg);
+            return;
+        }
+
+        bool created = false;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT 1 FROM sqlite_master WHERE name = 'tag_fts'", -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                created = sqlite3_step(stmt) != SQLITE_ROW;
+                sqlite3_finalize(stmt);
+            }
+        }
+
+        // Combinations are only ever added: no delete/update triggers
+        sqlite3_exec(m_db,
+                     "CREATE VIRTUAL TABLE IF NOT EXISTS tag_fts USING fts5("
+                     "  title, artist, album,"
+                     "  content='tag_index', content_rowid='id',"
+                     "  tokenize='unicode61 remove_diacritics 2', prefix='2 3');"
+                     "CREATE TRIGGER IF NOT EXISTS tag_index_ai AFTER INSERT ON tag_index BEGIN"
+                     "  INSERT INTO tag_fts(rowid, title, artist, album) VALUES (new.id, new.title, new.artist, new.album);"
+                     " END;",
+                     nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            // SQLite without FTS5: search falls back to scanning the period's rows
+            Log() << "foo_monthly_stats: full-text index unavailable: " << errmsg;
+            sqlite3_free(errmsg);
+            return;
+        }
+        m_ftsAvailable = true;
+
+        if (created)
+        {
+            // First run with the index: every combination already counted
+            sqlite3_exec(m_db,
+                         "BEGIN TRANSACTION;"
+                         "INSERT OR IGNORE INTO tag_index(title, artist, album)"
+                         " SELECT DISTINCT COALESCE(title,''), COALESCE(artist,''), COALESCE(album,'') FROM monthly_count;"
+                         "INSERT INTO tag_fts(tag_fts) VALUES ('rebuild');"
+                         "COMMIT;",
+                         nullptr, nullptr, &errmsg);
+            if (errmsg)
+            {
+                Log() << "foo_monthly_stats: tag_index backfill error: " << errmsg;
+                sqlite3_free(errmsg);
+                sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            }
+        }
+    }
+
+    void DbManager::indexTags(const TrackInfo &info)
+    {
+        // A known combination leaves the table (and the FTS index) untouched
+        sqlite3_stmt *stmt = nullptr;
+        const char *sql = "INSERT OR IGNORE INTO tag_index(title, artist, album) VALUES(?,?,?)";
+        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, info.title.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, info.artist.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 3, info.album.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    // Key of a row's displayed tags in the search results
+    static std::string tagKey(const std::string &title, const std::string &artist, const std::string &album)
+    {
+        return title + '\x1f' + artist + '\x1f' + album;
+    }
+
+    // Case-insensitive (ASCII) substring test, used when SQLite has no FTS5
+    static bool containsNoCase(const std::string &haystack, const std::string &needle)
+    {
+        auto it = std::search(haystack.begin(), haystack.end(), needle.begin(), needle.end(), [](char a, char b)
+                              { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); });
+        return it != haystack.end();
+    }
+
+    std::vector<MonthlyEntry> DbManager::search(const std::string &period, const std::string &query)
+    {
+        DbStats::Timer timer("query.search");
+        auto all = periodRows(period.size() == 4 ? 'Y' : period.size() == 7 ? 'M' : 'D', period);
+
+        std::vector<std::string> words;
+        {
+            std::istringstream in(query);
+            std::string w;
+            while (in >> w)
+                words.push_back(w);
+        }
+        std::vector<MonthlyEntry> rows;
+        if (words.empty() || all->empty())
+            return *all;
+
+        // SQLite without FTS5: filter the period's rows directly
+        if (!m_ftsAvailable)
+        {
+            std::copy_if(all->begin(), all->end(), std::back_inserter(rows), [&](const MonthlyEntry &e)
+                         {
+                for (const auto &w : words)
+                    if (!containsNoCase(e.title, w) && !containsNoCase(e.artist, w) && !containsNoCase(e.album, w))
+                        return false;
+                return true; });
+            return rows;
+        }
+
+        // Every word as a quoted prefix phrase: "word"* "word"* (implicit AND). Words
+        // shorter than the prefix index ('2 3') are answered by a scan of the term range.
+        std::string match;
+        for (const auto &w : words)
+        {
+            match += match.empty() ? "\"" : " \"";
+            for (char c : w)
+            {
+                if (c == '"')
+                    match += '"';
+                match += c;
+            }
+            match += "\"*";
+        }
+
+        std::unordered_set<std::string> hits;
+        sqlite3_stmt *stmt = nullptr;
+        const char *sql =
+            "SELECT t.title, t.artist, t.album FROM tag_fts JOIN tag_index t ON t.id = tag_fts.rowid"
+            " WHERE tag_fts MATCH ?";
+        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, match.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                hits.insert(tagKey(reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)),
+                                   reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1)),
+                                   reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2))));
+            sqlite3_finalize(stmt);
+        }
+        else
+        {
+            Log() << "foo_monthly_stats: search prepare error: " << sqlite3_errmsg(m_db);
+        }
+
+        // Only matching rows are copied out of the shared period result
+        std::copy_if(all->begin(), all->end(), std::back_inserter(rows), [&](const MonthlyEntry &e)
+                     { return hits.count(tagKey(e.title, e.artist, e.album)) != 0; });
+        return rows;
+    }
+
+    void DbManager::insertBatch(const std::vector<TrackInfo> &batch)
+    {
+        DbStats::Timer timer("worker.insertBatch");
+
+        // ATTACH is not allowed inside a transaction: open the year partitions first.
+        // Newest year first – opening a new year closes older ones, which this batch may also write.
+        std::set<int> years;
+        for (const auto &info : batch)
+            years.insert(localTime(info.played_at).tm_year + 1900);
+        retryPartitionCloses(years);
+        for (auto it = years.rbegin(); it != years.rend(); ++it)
+            ensureWritablePartition(*it);
+
+        CommitEvent event;
+        sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+        for (const auto &info : batch)
+            insertPlay(info, event);
+        if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: play commit error: " << sqlite3_errmsg(m_db);
+            sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            m_queryCache->invalidateAll();
+            invalidateHot();
+            return;
+        }
+
+        for (const auto &day : event.days)
+            m_queryCache->markWritten(day, day);
+        publishCommit(std::move(event));
+    }
+
+    // -----------------------------------------------------------------------
+    // Commit notifications
+    // -----------------------------------------------------------------------
+    int DbManager::subscribe(std::function<void(const CommitEvent &)> callback)
+    {
+        std::lock_guard<std::mutex> lk(m_commitMutex);
+        int token = m_nextSubscriber++;
+        m_subscribers.emplace(token, std::move(callback));
+        return token;
+    }
+
+    void DbManager::unsubscribe(int token)
+    {
+        std::lock_guard<std::mutex> lk(m_commitMutex);
+        m_subscribers.erase(token);
+    }
+
+    void DbManager::publishCommit(CommitEvent &&event)
+    {
+        if (event.days.empty())
+            return;
+        {
+            std::lock_guard<std::mutex> lk(m_commitMutex);
+            m_pendingCommit.days.insert(event.days.begin(), event.days.end());
+            m_pendingCommit.track_crcs.insert(event.track_crcs.begin(), event.track_crcs.end());
+            if (m_deliveryScheduled)
+                return; // merged into the delivery already on its way
+            m_deliveryScheduled = true;
+        }
+        runInMainThread([this]
+                        { deliverCommits(); });
+    }
+
+    void DbManager::deliverCommits()
+    {
+        CommitEvent event;
+        std::vector<std::function<void(const CommitEvent &)>> callbacks;
+        {
+            std::lock_guard<std::mutex> lk(m_commitMutex);
+            std::swap(event, m_pendingCommit);
+            m_deliveryScheduled = false;
+            for (const auto &kv : m_subscribers)
+                callbacks.push_back(kv.second);
+        }
+        for (const auto &cb : callbacks)
+            cb(event);
     }
 
-    void DbManager::insertPlay(const TrackInfo &info)
+    void DbManager::insertPlay(const TrackInfo &info, CommitEvent &event)
     {
-        // 1. Insert into play_log
+        // 1. Determine YYYY-MM-DD from played_at (local time)
+        struct tm local_tm = localTime(info.played_at);
+        char ymd[11];
+        strftime(ymd, sizeof(ymd), "%Y-%m-%d", &local_tm);
+
+        // 2. Insert into the play_log partition of that year (main.play_log if it cannot be attached)
         {
+            const int year = local_tm.tm_year + 1900;
+            const std::string schema = ensureWritablePartition(year) ? "log_" + std::to_string(year) : "main";
             sqlite3_stmt *stmt = nullptr;
-            const char *sql =
-                "INSERT INTO play_log(track_crc,path,title,artist,album,length_seconds,played_at) VALUES(?,?,?,?,?,?,?)";
-            if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
+            const std::string sql =
+                "INSERT INTO " + schema + ".play_log(track_crc,path,title,artist,album,length_seconds,played_at) VALUES(?,?,?,?,?,?,?)";
+            if (sqlite3_prepare_v2(m_db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK)
             {
                 sqlite3_bind_text(stmt, 1, info.track_crc.c_str(), -1, SQLITE_TRANSIENT);
                 sqlite3_bind_text(stmt, 2, info.path.c_str(), -1, SQLITE_TRANSIENT);
@@ -364,17 +1565,6 @@ namespace fms
             }
         }
 
-        // 2. Determine YYYY-MM-DD from played_at (local time)
-        time_t t = static_cast<time_t>(info.played_at / 1000);
-        struct tm local_tm;
-#ifdef _WIN32
-        localtime_s(&local_tm, &t);
-#else
-        localtime_r(&t, &local_tm);
-#endif
-        char ymd[11];
-        strftime(ymd, sizeof(ymd), "%Y-%m-%d", &local_tm);
-
         // 3. Upsert into monthly_count
         {
             sqlite3_stmt *stmt = nullptr;
@@ -399,16 +1589,295 @@ namespace fms
                 int rc = sqlite3_step(stmt);
                 if (rc != SQLITE_DONE && rc != SQLITE_ROW)
                 {
-                    FB2K_console_formatter() << "foo_monthly_stats: monthly_count insert error: "
-                                             << sqlite3_errmsg(m_db) << " (ymd=" << ymd << ")";
+                    Log() << "foo_monthly_stats: monthly_count insert error: "
+                          << sqlite3_errmsg(m_db) << " (ymd=" << ymd << ")";
                 }
                 sqlite3_finalize(stmt);
+                if (rc == SQLITE_DONE)
+                {
+                    event.days.insert(ymd);
+                    event.track_crcs.insert(info.track_crc);
+                    indexTags(info);
+                    extendSession(info);
+                    applyHotPlay(ymd, info, (info.length_seconds == 0.0) ? 1 : 0);
+                }
             }
             else
             {
-                FB2K_console_formatter() << "foo_monthly_stats: monthly_count prepare error: " << sqlite3_errmsg(m_db);
+                Log() << "foo_monthly_stats: monthly_count prepare error: " << sqlite3_errmsg(m_db);
+            }
+        }
+    }
+
+    // -----------------------------------------------------------------------
+    // Listening sessions
+    //
+    // A play event covers [played_at - length_seconds, played_at]: a point when
+    // the track starts (length 0), the listened span when it stops. Spans closer
+    // than the session gap belong to the same session.
+    // -----------------------------------------------------------------------
+    static int64_t playBeginMs(const TrackInfo &info)
+    {
+        return info.played_at - static_cast<int64_t>(info.length_seconds * 1000.0);
+    }
+
+    void DbManager::extendSession(const TrackInfo &info)
+    {
+        const int64_t gap = m_sessionGapMs;
+        const int64_t begin = playBeginMs(info);
+        const int64_t end = info.played_at;
+        const int plays = (info.length_seconds == 0.0) ? 1 : 0;
+
+        // Latest session within reach of the span; ix_sessions_end keeps this to the recent rows
+        int64_t id = 0;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db,
+                                   "SELECT id FROM sessions WHERE end_at >= ?1 - ?3 AND start_at <= ?2 + ?3"
+                                   " ORDER BY end_at DESC LIMIT 1",
+                                   -1, &stmt, nullptr) != SQLITE_OK)
+            {
+                Log() << "foo_monthly_stats: session prepare error: " << sqlite3_errmsg(m_db);
+                return;
+            }
+            sqlite3_bind_int64(stmt, 1, begin);
+            sqlite3_bind_int64(stmt, 2, end);
+            sqlite3_bind_int64(stmt, 3, gap);
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                id = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+
+        sqlite3_stmt *stmt = nullptr;
+        if (id == 0)
+        {
+            // Nothing near: this play opens a new session
+            if (sqlite3_prepare_v2(m_db, "INSERT INTO sessions(start_at,end_at,plays,listened_seconds) VALUES(?,?,?,?)",
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                sqlite3_bind_int64(stmt, 1, begin);
+                sqlite3_bind_int64(stmt, 2, end);
+                sqlite3_bind_int(stmt, 3, plays);
+                sqlite3_bind_double(stmt, 4, info.length_seconds);
+                sqlite3_step(stmt);
+                sqlite3_finalize(stmt);
+            }
+            return;
+        }
+
+        // Grow it by the play, then absorb every other session the grown span now
+        // reaches (a play in the gap between two sessions joins them), as rebuildSessions would
+        ListeningSession add{begin, end, plays, info.length_seconds};
+        while (true)
+        {
+            if (sqlite3_prepare_v2(m_db,
+                                   "UPDATE sessions SET start_at=MIN(start_at,?1), end_at=MAX(end_at,?2),"
+                                   "  plays=plays+?3, listened_seconds=listened_seconds+?4 WHERE id=?5",
+                                   -1, &stmt, nullptr) != SQLITE_OK)
+            {
+                Log() << "foo_monthly_stats: session prepare error: " << sqlite3_errmsg(m_db);
+                return;
+            }
+            sqlite3_bind_int64(stmt, 1, add.start_at);
+            sqlite3_bind_int64(stmt, 2, add.end_at);
+            sqlite3_bind_int64(stmt, 3, add.plays);
+            sqlite3_bind_double(stmt, 4, add.listened_seconds);
+            sqlite3_bind_int64(stmt, 5, id);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+
+            // Other sessions within reach of the grown one: folded into it and removed
+            int64_t merged = 0;
+            const char *reach = " FROM sessions o, sessions s WHERE s.id = ?1 AND o.id <> ?1"
+                                "  AND o.end_at >= s.start_at - ?2 AND o.start_at <= s.end_at + ?2";
+            if (sqlite3_prepare_v2(m_db,
+                                   (std::string("SELECT COUNT(*), MIN(o.start_at), MAX(o.end_at), SUM(o.plays), SUM(o.listened_seconds)") + reach).c_str(),
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                sqlite3_bind_int64(stmt, 1, id);
+                sqlite3_bind_int64(stmt, 2, gap);
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    merged = sqlite3_column_int64(stmt, 0);
+                    add = {sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2),
+                           sqlite3_column_int64(stmt, 3), sqlite3_column_double(stmt, 4)};
+                }
+                sqlite3_finalize(stmt);
+            }
+            if (merged == 0)
+                return;
+            if (sqlite3_prepare_v2(m_db, (std::string("DELETE FROM sessions WHERE id IN (SELECT o.id") + reach + ")").c_str(),
+                                   -1, &stmt, nullptr) != SQLITE_OK)
+                return;
+            sqlite3_bind_int64(stmt, 1, id);
+            sqlite3_bind_int64(stmt, 2, gap);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+    }
+
+    void DbManager::rebuildSessions()
+    {
+        DbStats::Timer timer("worker.rebuildSessions");
+        const int64_t gap = m_sessionGapMs;
+
+        sqlite3_exec(m_db, "BEGIN TRANSACTION;", nullptr, nullptr, nullptr);
+
+        // Sessions older than the raw log (compacted into the archive) cannot be recomputed: keep them
+        int64_t firstBegin = 0;
+        bool hasPlays = false;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT MIN(played_at - CAST(length_seconds * 1000 AS INTEGER)) FROM play_log_all",
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_type(stmt, 0) != SQLITE_NULL)
+                {
+                    firstBegin = sqlite3_column_int64(stmt, 0);
+                    hasPlays = true;
+                }
+                sqlite3_finalize(stmt);
+            }
+        }
+        if (!hasPlays)
+        {
+            sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+            return;
+        }
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "DELETE FROM sessions WHERE end_at >= ?", -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                sqlite3_bind_int64(stmt, 1, firstBegin);
+                sqlite3_step(stmt);
+                sqlite3_finalize(stmt);
+            }
+        }
+
+        // The last kept session may continue into the log
+        ListeningSession cur{0, 0, 0, 0};
+        int64_t curId = 0; // 0 = not yet a row
+        bool haveCur = false;
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, "SELECT id,start_at,end_at,plays,listened_seconds FROM sessions ORDER BY end_at DESC LIMIT 1",
+                                   -1, &stmt, nullptr) == SQLITE_OK)
+            {
+                if (sqlite3_step(stmt) == SQLITE_ROW)
+                {
+                    curId = sqlite3_column_int64(stmt, 0);
+                    cur = {sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2),
+                           sqlite3_column_int64(stmt, 3), sqlite3_column_double(stmt, 4)};
+                    haveCur = true;
+                }
+                sqlite3_finalize(stmt);
+            }
+        }
+
+        sqlite3_stmt *insert = nullptr;
+        sqlite3_stmt *update = nullptr;
+        sqlite3_prepare_v2(m_db, "INSERT INTO sessions(start_at,end_at,plays,listened_seconds) VALUES(?,?,?,?)", -1, &insert, nullptr);
+        sqlite3_prepare_v2(m_db, "UPDATE sessions SET start_at=?,end_at=?,plays=?,listened_seconds=? WHERE id=?", -1, &update, nullptr);
+        auto flush = [&]
+        {
+            sqlite3_stmt *stmt = curId ? update : insert;
+            if (!stmt)
+                return;
+            sqlite3_bind_int64(stmt, 1, cur.start_at);
+            sqlite3_bind_int64(stmt, 2, cur.end_at);
+            sqlite3_bind_int64(stmt, 3, cur.plays);
+            sqlite3_bind_double(stmt, 4, cur.listened_seconds);
+            if (curId)
+                sqlite3_bind_int64(stmt, 5, curId);
+            sqlite3_step(stmt);
+            sqlite3_reset(stmt);
+        };
+
+        sqlite3_stmt *stmt = nullptr;
+        int64_t sessionCount = 0;
+        if (sqlite3_prepare_v2(m_db,
+                               "SELECT played_at - CAST(length_seconds * 1000 AS INTEGER) AS begin_at, played_at, length_seconds"
+                               " FROM play_log_all ORDER BY begin_at",
+                               -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+            {
+                const int64_t begin = sqlite3_column_int64(stmt, 0);
+                const int64_t end = sqlite3_column_int64(stmt, 1);
+                const double seconds = sqlite3_column_double(stmt, 2);
+                if (haveCur && begin <= cur.end_at + gap)
+                {
+                    cur.end_at = (std::max)(cur.end_at, end);
+                }
+                else
+                {
+                    if (haveCur)
+                        flush();
+                    cur = {begin, end, 0, 0};
+                    curId = 0;
+                    haveCur = true;
+                    ++sessionCount;
+                }
+                cur.plays += (seconds == 0.0) ? 1 : 0;
+                cur.listened_seconds += seconds;
             }
+            sqlite3_finalize(stmt);
+        }
+        if (haveCur)
+            flush();
+        sqlite3_finalize(insert);
+        sqlite3_finalize(update);
+
+        if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: session rebuild error: " << sqlite3_errmsg(m_db);
+            sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+            return;
+        }
+        Log() << "foo_monthly_stats: rebuilt " << sessionCount << " listening sessions";
+    }
+
+    SessionStats DbManager::querySessions(const std::string &period)
+    {
+        DbStats::Timer timer("query.sessions");
+        SessionStats stats;
+        int64_t startMs = 0, endMs = 0;
+        if (!m_db || !periodBoundsMs(period, startMs, endMs))
+            return stats;
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db,
+                               "SELECT start_at,end_at,plays,listened_seconds FROM sessions"
+                               " WHERE start_at >= ? AND start_at < ? ORDER BY start_at",
+                               -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: querySessions prepare error: " << sqlite3_errmsg(m_db);
+            return stats;
+        }
+        sqlite3_bind_int64(stmt, 1, startMs);
+        sqlite3_bind_int64(stmt, 2, endMs);
+
+        std::set<std::string> days;
+        int64_t totalMs = 0;
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            ListeningSession s{sqlite3_column_int64(stmt, 0), sqlite3_column_int64(stmt, 1),
+                               sqlite3_column_int64(stmt, 2), sqlite3_column_double(stmt, 3)};
+            struct tm local_tm = localTime(s.start_at);
+            char ymd[11];
+            strftime(ymd, sizeof(ymd), "%Y-%m-%d", &local_tm);
+            days.insert(ymd);
+            totalMs += s.end_at - s.start_at;
+            if (stats.sessions.empty() || s.end_at - s.start_at > stats.longest.end_at - stats.longest.start_at)
+                stats.longest = s;
+            stats.sessions.push_back(s);
         }
+        sqlite3_finalize(stmt);
+
+        stats.activeDays = static_cast<int>(days.size());
+        if (!stats.sessions.empty())
+            stats.averageSeconds = totalMs / 1000.0 / stats.sessions.size();
+        return stats;
     }
 
     void DbManager::removeDuplicates()
@@ -442,7 +1911,7 @@ namespace fms
 
         if (sqlite3_exec(m_db, consolidateSql, nullptr, nullptr, nullptr) != SQLITE_OK)
         {
-            FB2K_console_formatter() << "foo_monthly_stats: consolidate duplicates error: " << sqlite3_errmsg(m_db);
+            Log() << "foo_monthly_stats: consolidate duplicates error: " << sqlite3_errmsg(m_db);
             sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
             return;
         }
@@ -465,11 +1934,11 @@ namespace fms
         if (dupCount > 0)
         {
             // Step 2: Remove old entries for duplicated groups
-            // Find which (title, artist, album) groups had duplicates
+            // Only on the days that were consolidated: other days of the same track keep their rows
             sqlite3_exec(m_db,
                          "DELETE FROM monthly_count "
-                         " WHERE (title, artist, album) IN "
-                         "   (SELECT DISTINCT title, artist, album FROM monthly_count_temp);",
+                         " WHERE (ymd, title, artist, album) IN "
+                         "   (SELECT ymd, title, artist, album FROM monthly_count_temp);",
                          nullptr, nullptr, nullptr);
 
             // Step 3: Insert consolidated entries
@@ -483,17 +1952,234 @@ namespace fms
             // Step 4: Clear temp table
             sqlite3_exec(m_db, "DELETE FROM monthly_count_temp;", nullptr, nullptr, nullptr);
 
-            FB2K_console_formatter() << "foo_monthly_stats: consolidated " << dupCount << " duplicate track entries";
+            Log() << "foo_monthly_stats: consolidated " << dupCount << " duplicate track entries";
         }
 
         sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+        m_queryCache->invalidateAll();
+        invalidateHot();
     }
 
-    std::vector<MonthlyEntry> DbManager::queryMonth(const std::string &ym)
+    // -----------------------------------------------------------------------
+    // Current-period snapshot
+    // -----------------------------------------------------------------------
+    std::shared_ptr<const HotAggregate> DbManager::hotSnapshot()
+    {
+        auto hot = std::atomic_load(&m_hot);
+        // Day rollover without new plays: rebuild for the new day in the background
+        if (hot && m_opened && hot->ymd() != currentYMD() && !m_hotRebuildQueued.exchange(true))
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_tasks.push([this]
+                         { rebuildHot(); });
+            m_cv.notify_one();
+        }
+        return hot;
+    }
+
+    void DbManager::rebuildHot()
+    {
+        DbStats::Timer timer("hot.rebuild");
+        m_hotRebuildQueued = false;
+        uint64_t generation;
+        {
+            std::lock_guard<std::mutex> lk(m_hotMutex);
+            generation = m_hotGeneration;
+        }
+
+        const std::string today = currentYMD();
+        auto hot = std::make_shared<HotAggregate>(today);
+        auto load = [this](const char *sql, const std::string &p1, const std::string &p2, const std::function<void(sqlite3_stmt *)> &row)
+        {
+            sqlite3_stmt *stmt = nullptr;
+            if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+                return false;
+            sqlite3_bind_text(stmt, 1, p1.c_str(), -1, SQLITE_TRANSIENT);
+            if (!p2.empty())
+                sqlite3_bind_text(stmt, 2, p2.c_str(), -1, SQLITE_TRANSIENT);
+            while (sqlite3_step(stmt) == SQLITE_ROW)
+                row(stmt);
+            sqlite3_finalize(stmt);
+            return true;
+        };
+        auto readRow = [](sqlite3_stmt *stmt)
+        {
+            HotAggregate::Row r;
+            r.track_crc = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            r.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+            r.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+            r.artist = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+            r.album = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+            r.length_seconds = sqlite3_column_double(stmt, 5);
+            r.playcount = sqlite3_column_int64(stmt, 6);
+            r.total_time_seconds = sqlite3_column_double(stmt, 7);
+            return r;
+        };
+
+        bool ok = load("SELECT track_crc, path, title, artist, album, length_seconds, playcount, total_time_seconds"
+                       " FROM monthly_count WHERE ymd = ?",
+                       today, "", [&](sqlite3_stmt *stmt)
+                       { hot->addToday(readRow(stmt)); });
+        // Rows of the current month / year before today, grouped like queryMonth / queryYear
+        const struct
+        {
+            HotAggregate::Level level;
+            int prefixLen;
+        } levels[] = {{HotAggregate::MONTH, 7}, {HotAggregate::YEAR, 4}};
+        for (const auto &lv : levels)
+        {
+            std::string sql =
+                "SELECT track_crc, path, title, artist, album,"
+                "       MAX(length_seconds), SUM(playcount), SUM(total_time_seconds)"
+                " FROM monthly_count WHERE SUBSTR(ymd, 1, " +
+                std::to_string(lv.prefixLen) + ") = ? AND ymd <> ?"
+                                               " GROUP BY track_crc, path, title, artist, album";
+            ok = ok && load(sql.c_str(), today.substr(0, lv.prefixLen), today, [&](sqlite3_stmt *stmt)
+                            { hot->addBase(lv.level, readRow(stmt)); });
+        }
+        // Previous periods' play counts for the delta column
+        const struct
+        {
+            HotAggregate::Level level;
+            std::string period;
+        } prevs[] = {{HotAggregate::DAY, previousDay(today)},
+                     {HotAggregate::MONTH, addMonths(today.substr(0, 7), -1)},
+                     {HotAggregate::YEAR, std::to_string(std::stoi(today.substr(0, 4)) - 1)}};
+        for (const auto &pv : prevs)
+        {
+            std::string sql = "SELECT track_crc, SUM(playcount) FROM monthly_count"
+                              " WHERE SUBSTR(ymd, 1, " +
+                              std::to_string(pv.period.size()) + ") = ? GROUP BY track_crc";
+            ok = ok && load(sql.c_str(), pv.period, "", [&](sqlite3_stmt *stmt)
+                            { hot->setPrevious(pv.level, reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0)),
+                                               sqlite3_column_int64(stmt, 1)); });
+        }
+        if (!ok)
+        {
+            Log() << "foo_monthly_stats: current-period snapshot error: " << sqlite3_errmsg(m_db);
+            return;
+        }
+
+        // Publish unless invalidated while loading (e.g. a Reset on the UI thread)
+        std::lock_guard<std::mutex> lk(m_hotMutex);
+        if (generation == m_hotGeneration)
+            std::atomic_store(&m_hot, std::shared_ptr<const HotAggregate>(std::move(hot)));
+    }
+
+    void DbManager::invalidateHot()
     {
-        std::vector<MonthlyEntry> result;
+        {
+            std::lock_guard<std::mutex> lk(m_hotMutex);
+            ++m_hotGeneration;
+            std::atomic_store(&m_hot, std::shared_ptr<const HotAggregate>());
+        }
+        // Queries fall back to SQL until the worker has rebuilt the snapshot
+        if (m_opened && !m_hotRebuildQueued.exchange(true))
+        {
+            std::unique_lock<std::mutex> lk(m_mutex);
+            m_tasks.push([this]
+                         { rebuildHot(); });
+            m_cv.notify_one();
+        }
+    }
+
+    void DbManager::applyHotPlay(const std::string &ymd, const TrackInfo &info, int64_t playcount)
+    {
+        {
+            std::lock_guard<std::mutex> lk(m_hotMutex);
+            auto hot = std::atomic_load(&m_hot);
+            if (!hot)
+                return; // rebuild pending; it will read this row from SQL
+            if (hot->ymd() == ymd)
+            {
+                // Copy-on-write: today's rows are copied, the month/year base is shared
+                auto next = std::make_shared<HotAggregate>(*hot);
+                HotAggregate::Row delta;
+                delta.track_crc = info.track_crc;
+                delta.path = info.path;
+                delta.title = info.title;
+                delta.artist = info.artist;
+                delta.album = info.album;
+                delta.length_seconds = info.length_seconds;
+                delta.playcount = playcount;
+                delta.total_time_seconds = info.length_seconds;
+                next->applyToday(delta);
+                std::atomic_store(&m_hot, std::shared_ptr<const HotAggregate>(std::move(next)));
+                return;
+            }
+            // Older than the previous year: outside every period the snapshot covers
+            if (std::stoi(ymd.substr(0, 4)) < std::stoi(hot->year()) - 1)
+                return;
+        }
+        // A play for another day (midnight rollover or a late stop event) moves the periods;
+        // rebuild once after the current batch rather than per play
+        invalidateHot();
+    }
+
+    // -----------------------------------------------------------------------
+    // Past-period result cache
+    // -----------------------------------------------------------------------
+    void DbManager::cacheRange(char mode, const std::string &period, std::string &key,
+                               std::string &firstYmd, std::string &lastYmd)
+    {
+        // A result also depends on the previous period through prev_playcount
+        key = mode + period;
+        if (mode == 'D')
+        {
+            firstYmd = previousDay(period);
+            lastYmd = period;
+        }
+        else if (mode == 'M')
+        {
+            firstYmd = addMonths(period, -1) + "-01";
+            lastYmd = period + "-31";
+        }
+        else
+        {
+            firstYmd = std::to_string(std::stoi(period) - 1) + "-01-01";
+            lastYmd = period + "-12-31";
+        }
+    }
+
+    std::shared_ptr<const std::vector<MonthlyEntry>> DbManager::periodRows(char mode, const std::string &period)
+    {
+        DbStats::Timer timer("query.periodRows");
         if (!m_db)
-            return result;
+            return std::make_shared<const std::vector<MonthlyEntry>>();
+
+        // Current period: in-memory snapshot
+        if (auto hot = hotSnapshot())
+        {
+            if (mode == 'D' && hot->ymd() == period)
+                return hot->rows(HotAggregate::DAY);
+            if (mode == 'M' && hot->ym() == period)
+                return hot->rows(HotAggregate::MONTH);
+            if (mode == 'Y' && hot->year() == period)
+                return hot->rows(HotAggregate::YEAR);
+        }
+
+        std::string cacheKey, firstYmd, lastYmd;
+        cacheRange(mode, period, cacheKey, firstYmd, lastYmd);
+        uint64_t generation = 0;
+        if (auto cached = m_queryCache->lookup(cacheKey, generation))
+            return cached;
+
+        auto rows = std::make_shared<std::vector<MonthlyEntry>>();
+        bool ok = (mode == 'D')   ? selectDay(period, *rows)
+                  : (mode == 'M') ? selectMonth(period, *rows)
+                                  : selectYear(period, *rows);
+        if (ok)
+            m_queryCache->store(cacheKey, firstYmd, lastYmd, rows, generation);
+        return rows;
+    }
+
+    std::vector<MonthlyEntry> DbManager::queryMonth(const std::string &ym)
+    {
+        return *periodRows('M', ym);
+    }
+
+    bool DbManager::selectMonth(const std::string &ym, std::vector<MonthlyEntry> &result)
+    {
 
         // Aggregate daily rows into monthly totals
         // Use correlated subquery for prev_playcount to avoid JOIN cross-multiplication
@@ -512,20 +2198,11 @@ namespace fms
             " ORDER BY playcount DESC";
 
         // Compute previous month for delta comparison
-        int year = std::stoi(ym.substr(0, 4));
-        int month = std::stoi(ym.substr(5, 2));
-        month--;
-        if (month == 0)
-        {
-            month = 12;
-            year--;
-        }
-        char prevYm[8];
-        snprintf(prevYm, sizeof(prevYm), "%04d-%02d", year, month);
+        std::string prevYm = addMonths(ym, -1);
 
         if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
         {
-            sqlite3_bind_text(stmt, 1, prevYm, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 1, prevYm.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_bind_text(stmt, 2, ym.c_str(), -1, SQLITE_TRANSIENT);
             while (sqlite3_step(stmt) == SQLITE_ROW)
             {
@@ -543,19 +2220,22 @@ namespace fms
                 result.push_back(std::move(e));
             }
             sqlite3_finalize(stmt);
+            return true;
         }
         else
         {
-            FB2K_console_formatter() << "foo_monthly_stats: queryMonth prepare error: " << sqlite3_errmsg(m_db);
+            Log() << "foo_monthly_stats: queryMonth prepare error: " << sqlite3_errmsg(m_db);
         }
-        return result;
+        return false;
     }
 
     std::vector<MonthlyEntry> DbManager::queryDay(const std::string &ymd)
     {
-        std::vector<MonthlyEntry> result;
-        if (!m_db)
-            return result;
+        return *periodRows('D', ymd);
+    }
+
+    bool DbManager::selectDay(const std::string &ymd, std::vector<MonthlyEntry> &result)
+    {
 
         // Single day data
         sqlite3_stmt *stmt = nullptr;
@@ -569,29 +2249,11 @@ namespace fms
             " ORDER BY c.playcount DESC";
 
         // Compute previous day for delta
-        int year = std::stoi(ymd.substr(0, 4));
-        int month = std::stoi(ymd.substr(5, 2));
-        int day = std::stoi(ymd.substr(8, 2));
-        day--;
-        if (day == 0)
-        {
-            month--;
-            if (month == 0)
-            {
-                month = 12;
-                year--;
-            }
-            // Quick approximation: use last day of previous month
-            static const int daysInMonth[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
-            int leap = ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0)) ? 1 : 0;
-            day = daysInMonth[month] + (month == 2 ? leap : 0);
-        }
-        char prevYmd[11];
-        snprintf(prevYmd, sizeof(prevYmd), "%04d-%02d-%02d", year, month, day);
+        std::string prevYmd = previousDay(ymd);
 
         if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) == SQLITE_OK)
         {
-            sqlite3_bind_text(stmt, 1, prevYmd, -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 1, prevYmd.c_str(), -1, SQLITE_TRANSIENT);
             sqlite3_bind_text(stmt, 2, ymd.c_str(), -1, SQLITE_TRANSIENT);
             while (sqlite3_step(stmt) == SQLITE_ROW)
             {
@@ -609,15 +2271,136 @@ namespace fms
                 result.push_back(std::move(e));
             }
             sqlite3_finalize(stmt);
+            return true;
         }
-        return result;
+        return false;
     }
 
     std::vector<MonthlyEntry> DbManager::queryYear(const std::string &year)
     {
-        std::vector<MonthlyEntry> result;
-        if (!m_db)
+        return *periodRows('Y', year);
+    }
+
+    std::map<std::string, std::vector<MonthlyEntry>> DbManager::queryYearByMonth(const std::string &year,
+                                                                                std::vector<MonthlyEntry> *yearRows)
+    {
+        std::map<std::string, std::vector<MonthlyEntry>> result;
+
+        // One scan from the previous December through the year instead of twelve
+        // queryMonth calls; each month's prev_playcount comes from the month before.
+        // The year's rows need the whole previous year for theirs.
+        sqlite3_stmt *stmt = nullptr;
+        const char *sql =
+            "SELECT SUBSTR(ymd, 1, 7) AS ym, track_crc, path, title, artist, album,"
+            "       MAX(length_seconds), SUM(playcount) AS pc, SUM(total_time_seconds)"
+            " FROM monthly_count"
+            " WHERE ymd >= ? AND ymd <= ?"
+            " GROUP BY ym, track_crc, path, title, artist, album"
+            " ORDER BY ym, pc DESC";
+
+        const std::string firstMonth = addMonths(year + "-01", yearRows ? -12 : -1);
+        std::string firstYmd = firstMonth + "-01";
+        std::string lastYmd = year + "-12-31";
+
+        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: queryYearByMonth prepare error: " << sqlite3_errmsg(m_db);
             return result;
+        }
+        sqlite3_bind_text(stmt, 1, firstYmd.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_text(stmt, 2, lastYmd.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            std::string ym = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            MonthlyEntry e;
+            e.ymd = ym + "-01";
+            e.track_crc = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 1));
+            e.path = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 2));
+            e.title = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+            e.artist = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 4));
+            e.album = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 5));
+            e.length_seconds = sqlite3_column_double(stmt, 6);
+            e.playcount = sqlite3_column_int64(stmt, 7);
+            e.total_time_seconds = sqlite3_column_double(stmt, 8);
+            e.prev_playcount = 0;
+            result[ym].push_back(std::move(e));
+        }
+        sqlite3_finalize(stmt);
+
+        // Plays per track of each month, summed over tag variants like selectMonth's subquery
+        std::map<std::string, std::unordered_map<std::string, int64_t>> plays;
+        for (const auto &[ym, rows] : result)
+        {
+            auto &byTrack = plays[ym];
+            for (const auto &e : rows)
+                byTrack[e.track_crc] += e.playcount;
+        }
+        for (auto &[ym, rows] : result)
+        {
+            auto prev = plays.find(addMonths(ym, -1));
+            if (prev == plays.end())
+                continue;
+            for (auto &e : rows)
+            {
+                auto it = prev->second.find(e.track_crc);
+                if (it != prev->second.end())
+                    e.prev_playcount = it->second;
+            }
+        }
+
+        if (yearRows)
+        {
+            // selectYear from the same rows: the year's months merged per track and tags
+            // (rows without plays included, as in its sums), deltas from the previous year
+            std::unordered_map<std::string, int64_t> prevYear;
+            std::map<std::tuple<std::string, std::string, std::string, std::string, std::string>, MonthlyEntry> merged;
+            for (const auto &[ym, rows] : result)
+            {
+                for (const auto &e : rows)
+                {
+                    if (ym < year)
+                    {
+                        prevYear[e.track_crc] += e.playcount;
+                        continue;
+                    }
+                    auto [it, added] = merged.try_emplace(std::make_tuple(e.track_crc, e.path, e.title, e.artist, e.album), e);
+                    if (added)
+                        continue;
+                    MonthlyEntry &m = it->second;
+                    m.length_seconds = (std::max)(m.length_seconds, e.length_seconds);
+                    m.playcount += e.playcount;
+                    m.total_time_seconds += e.total_time_seconds;
+                }
+            }
+            yearRows->clear();
+            for (auto &[key, e] : merged)
+            {
+                if (e.playcount <= 0)
+                    continue;
+                e.ymd = year + "-01-01";
+                auto prev = prevYear.find(e.track_crc);
+                e.prev_playcount = prev != prevYear.end() ? prev->second : 0;
+                yearRows->push_back(std::move(e));
+            }
+            std::stable_sort(yearRows->begin(), yearRows->end(), [](const MonthlyEntry &a, const MonthlyEntry &b)
+                             { return a.playcount > b.playcount; });
+        }
+
+        // Months before the year only provided deltas; rows without plays are not shown
+        result.erase(result.begin(), result.lower_bound(year + "-01"));
+        for (auto it = result.begin(); it != result.end();)
+        {
+            auto &rows = it->second;
+            rows.erase(std::remove_if(rows.begin(), rows.end(), [](const MonthlyEntry &e)
+                                      { return e.playcount <= 0; }),
+                       rows.end());
+            it = rows.empty() ? result.erase(it) : std::next(it);
+        }
+        return result;
+    }
+
+    bool DbManager::selectYear(const std::string &year, std::vector<MonthlyEntry> &result)
+    {
 
         sqlite3_stmt *stmt = nullptr;
         // Use subquery for prev_playcount to avoid double-counting from cross-JOIN
@@ -656,8 +2439,9 @@ namespace fms
                 result.push_back(std::move(e));
             }
             sqlite3_finalize(stmt);
+            return true;
         }
-        return result;
+        return false;
     }
 
     std::string DbManager::currentYM()
@@ -1,8 +1,10 @@
 #pragma once
-#include "stdafx.h"
+#include "core.h"
 
 namespace fms
 {
+    class HotAggregate;
+    class QueryCache;
 
     // -----------------------------------------------------------------------
     // TrackInfo – data recorded for each play event
@@ -35,9 +37,47 @@ namespace fms
         double total_time_seconds; // actual total played time
     };
 
+    // -----------------------------------------------------------------------
+    // CommitEvent – what committed worker transactions changed in monthly_count
+    // -----------------------------------------------------------------------
+    struct CommitEvent
+    {
+        std::set<std::string> days;       // "YYYY-MM-DD"
+        std::set<std::string> track_crcs; // tracks with changed rows
+    };
+
+    // -----------------------------------------------------------------------
+    // ListeningSession – one row of the sessions table: plays whose listening
+    // spans are separated by no more than the session gap
+    // -----------------------------------------------------------------------
+    struct ListeningSession
+    {
+        int64_t start_at;        // UNIX epoch milliseconds
+        int64_t end_at;          // UNIX epoch milliseconds
+        int64_t plays;           // started tracks
+        double listened_seconds; // actual played time
+    };
+
+    // Sessions that started within a period, plus the figures shown for them
+    struct SessionStats
+    {
+        std::vector<ListeningSession> sessions; // ordered by start_at
+        int activeDays{0};                      // local days with at least one session start
+        double averageSeconds{0};               // mean end_at - start_at
+        ListeningSession longest{0, 0, 0, 0};   // by end_at - start_at
+    };
+
     // -----------------------------------------------------------------------
     // DbManager – thread-safe SQLite wrapper
     // All mutating operations are posted to a single worker thread.
+    //
+    // Raw play events are partitioned by (local) year into "<db>_YYYY.db" files
+    // attached as log_YYYY; temp view play_log_all unions them. Closed years are
+    // attached read-only and switched out of WAL mode, so they are never checkpointed.
+    //
+    // The current day/month/year are also kept in memory (HotAggregate) and
+    // served from an atomically swapped snapshot without touching SQLite.
+    // Other periods go through an LRU of results invalidated per written day.
     // -----------------------------------------------------------------------
     class DbManager
     {
@@ -52,20 +92,44 @@ namespace fms
         // Close and join the worker thread.
         void close();
 
-        // Post a play event (non-blocking, returns immediately)
-        void postPlay(const TrackInfo &info);
+        // Post a play event (non-blocking, returns immediately; pass an rvalue to skip the copy)
+        void postPlay(TrackInfo info);
 
         // Refresh a specific period by deleting and recalculating from play_log
         // period: "YYYY-MM" for month or "YYYY" for year
-        void refreshPeriod(const std::string &period, bool isYear);
+        // (runs on the worker after the queued plays, returns immediately; subscribers
+        // get the period's days in a CommitEvent)
+        void postRefreshPeriod(const std::string &period, bool isYear);
 
-        // Delete a specific entry from monthly_count
-        void deleteEntry(const std::string &ymd, const std::string &track_crc);
+        // Delete a specific entry from monthly_count (on the worker, like postRefreshPeriod)
+        void postDeleteEntry(const std::string &ymd, const std::string &track_crc);
 
         // Remove duplicate entries in monthly_count (same title/artist/album with different paths)
         // Consolidates entries with identical metadata into a single track_crc
         void removeDuplicates();
 
+        // Move play_log rows older than keepMonths calendar months into the archive DB
+        // as daily aggregates (runs on the worker thread, returns immediately)
+        void postCompaction(int keepMonths);
+
+        // Copy every attached database file into destDir with the online backup API.
+        // Pages are copied in small batches on the worker, interleaved with queued plays.
+        // onDone(success) is called on the worker thread when the backup ends.
+        void postBackup(const std::string &destDir, std::function<void(bool)> onDone = nullptr);
+
+        // Pages copied / total of the running backup; false when no backup is running
+        bool backupProgress(int &copiedPages, int &totalPages) const;
+
+        // Silence that ends a listening session. Sessions are rebuilt from play_log
+        // on the worker when the value changes after open().
+        void setSessionGap(int minutes);
+
+        // Called on the main thread after queued plays are committed. Commits that
+        // happen before the main thread gets to run are merged into one event.
+        // Returns a token for unsubscribe().
+        int subscribe(std::function<void(const CommitEvent &)> callback);
+        void unsubscribe(int token);
+
         // Query monthly data synchronously (called on main thread for UI)
         std::vector<MonthlyEntry> queryMonth(const std::string &ym);
 
@@ -75,6 +139,20 @@ namespace fms
         // Query yearly data synchronously (aggregates all months in a year)
         std::vector<MonthlyEntry> queryYear(const std::string &year);
 
+        // Every month of a year in one pass, keyed by "YYYY-MM" (months without
+        // plays are left out); each list matches what queryMonth returns for it.
+        // yearRows, when given, receives what queryYear returns, from the same pass.
+        std::map<std::string, std::vector<MonthlyEntry>> queryYearByMonth(const std::string &year,
+                                                                          std::vector<MonthlyEntry> *yearRows = nullptr);
+
+        // Rows of a period ("YYYY", "YYYY-MM" or "YYYY-MM-DD") whose title/artist/album
+        // match every word of query as a prefix (FTS5 index, case/diacritic-insensitive;
+        // SQLite without FTS5 falls back to an ASCII case-insensitive substring match)
+        std::vector<MonthlyEntry> search(const std::string &period, const std::string &query);
+
+        // Listening sessions that started in a period ("YYYY", "YYYY-MM" or "YYYY-MM-DD")
+        SessionStats querySessions(const std::string &period);
+
         // Compute current "YYYY-MM" string
         static std::string currentYM();
 
@@ -90,11 +168,81 @@ namespace fms
     private:
         void workerThread();
         void ensureSchema();
-        void insertPlay(const TrackInfo &info);
+        void insertBatch(const std::vector<TrackInfo> &batch);
+        void insertPlay(const TrackInfo &info, CommitEvent &event);
+        void ensureSearchIndex();
+        void indexTags(const TrackInfo &info);
+        void publishCommit(CommitEvent &&event);
+        void deliverCommits();
+        bool attachArchive();
+        void compactLog(int keepMonths);
+        void postEdit(std::function<void()> edit);
+        void refreshPeriod(const std::string &period, bool isYear);
+        void deleteEntry(const std::string &ymd, const std::string &track_crc);
+
+        // Listening sessions
+        void extendSession(const TrackInfo &info);
+        void postSessionRebuild();
+        void rebuildSessions();
+
+        struct BackupJob;
+        void backupStep(const std::shared_ptr<BackupJob> &job);
+        void finishBackup(const std::shared_ptr<BackupJob> &job, bool ok);
+
+        // Current-period snapshot
+        std::shared_ptr<const HotAggregate> hotSnapshot();
+        void rebuildHot();
+        void invalidateHot();
+        void applyHotPlay(const std::string &ymd, const TrackInfo &info, int64_t playcount);
+
+        // Rows of a period: snapshot for the current one, else cache, else SQL (mode 'D'/'M'/'Y')
+        std::shared_ptr<const std::vector<MonthlyEntry>> periodRows(char mode, const std::string &period);
+        bool selectDay(const std::string &ymd, std::vector<MonthlyEntry> &result);
+        bool selectMonth(const std::string &ym, std::vector<MonthlyEntry> &result);
+        bool selectYear(const std::string &year, std::vector<MonthlyEntry> &result);
+
+        // Past-period result cache: key and the ymd range a result depends on
+        static void cacheRange(char mode, const std::string &period, std::string &key,
+                               std::string &firstYmd, std::string &lastYmd);
+
+        // play_log partitions
+        std::string partitionPath(int year) const;
+        void openPartitions();
+        bool attachPartition(int year, bool writable);
+        bool ensureWritablePartition(int year);
+        void closePartition(int year);
+        void retryPartitionCloses(const std::set<int> &writing);
+        bool hasPartition(int year);
+        void migrateLegacyLog();
+        void rebuildLogView();
 
         sqlite3 *m_db{nullptr};
+        std::string m_basePath;    // DB path without ".db"; sibling files derive from it
+        std::string m_archivePath; // "<db>_archive.db" – daily aggregates of compacted play_log rows
+        std::atomic<bool> m_archiveAttached{false};
+        bool m_ftsAvailable{false}; // tag_fts created (SQLite built with FTS5)
+        std::map<int, bool> m_partitions; // year -> attached writable
+        std::mutex m_partitionMutex;      // guards m_partitions (read from the UI thread)
+        std::set<int> m_partitionsToClose; // closed years still attached writable after a failed detach (worker only)
         std::thread m_thread;
         std::queue<TrackInfo> m_queue;
+        std::queue<std::function<void()>> m_edits; // UI edits of monthly_count, run after pending plays
+        std::queue<std::function<void()>> m_tasks; // maintenance work, runs after pending plays and edits
+        std::atomic<bool> m_backupRunning{false};
+        std::shared_ptr<BackupJob> m_backupJob; // the running backup (guarded by m_mutex)
+        std::atomic<int> m_backupCopied{0};
+        std::atomic<int> m_backupTotal{0};
+        std::shared_ptr<const HotAggregate> m_hot; // null while invalid; read via std::atomic_load
+        std::mutex m_hotMutex;                     // serializes snapshot writers only
+        uint64_t m_hotGeneration{0};               // bumped by invalidateHot (guarded by m_hotMutex)
+        std::atomic<bool> m_hotRebuildQueued{false};
+        std::atomic<int64_t> m_sessionGapMs{30 * 60 * 1000};
+        std::unique_ptr<QueryCache> m_queryCache;
+        std::map<int, std::function<void(const CommitEvent &)>> m_subscribers;
+        int m_nextSubscriber{1};
+        CommitEvent m_pendingCommit;     // merged until the main thread delivers it
+        bool m_deliveryScheduled{false};
+        std::mutex m_commitMutex; // guards subscribers and the pending event
         std::mutex m_mutex;
         std::condition_variable m_cv;
         std::atomic<bool> m_running{false};
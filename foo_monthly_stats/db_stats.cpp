@@ -0,0 +1,282 @@
+#include "core.h"
+#include "db_stats.h"
+
+namespace fms
+{
+
+    // ---------------------------------------------------------------------------
+    // LatencyHistogram
+    // ---------------------------------------------------------------------------
+    int LatencyHistogram::bucketOf(uint64_t us)
+    {
+        if (us < kSubBuckets)
+            return static_cast<int>(us); // exact below the first power of two
+        int exp = kSubBits;
+        while (us >> (exp + 1))
+            ++exp;
+        int sub = static_cast<int>((us >> (exp - kSubBits)) & (kSubBuckets - 1));
+        return (exp - kSubBits + 1) * kSubBuckets + sub;
+    }
+
+    uint64_t LatencyHistogram::bucketUpper(int idx)
+    {
+        if (idx < kSubBuckets)
+            return static_cast<uint64_t>(idx);
+        int exp = idx / kSubBuckets + kSubBits - 1;
+        uint64_t sub = static_cast<uint64_t>(idx % kSubBuckets);
+        uint64_t width = uint64_t(1) << (exp - kSubBits);
+        return ((kSubBuckets + sub) << (exp - kSubBits)) + width - 1;
+    }
+
+    void LatencyHistogram::record(uint64_t us)
+    {
+        ++m_counts[bucketOf(us)];
+        ++m_count;
+        m_total += us;
+        m_max = (std::max)(m_max, us);
+    }
+
+    uint64_t LatencyHistogram::percentileUs(double p) const
+    {
+        if (m_count == 0)
+            return 0;
+        uint64_t target = static_cast<uint64_t>(p / 100.0 * static_cast<double>(m_count) + 0.5);
+        if (target < 1)
+            target = 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < kBuckets; ++i)
+        {
+            seen += m_counts[i];
+            if (seen >= target)
+                return (std::min)(bucketUpper(i), m_max);
+        }
+        return m_max;
+    }
+
+    // ---------------------------------------------------------------------------
+    // DbStats
+    // ---------------------------------------------------------------------------
+    DbStats &DbStats::get()
+    {
+        static DbStats instance;
+        return instance;
+    }
+
+    DbStats::Timer::Timer(const char *name)
+        : m_name(DbStats::get().enabled() ? name : nullptr)
+    {
+        if (m_name)
+            m_start = std::chrono::steady_clock::now();
+    }
+
+    DbStats::Timer::~Timer()
+    {
+        if (!m_name)
+            return;
+        auto us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count();
+        DbStats::get().recordSpan(m_name, static_cast<uint64_t>(us));
+    }
+
+    void DbStats::attach(sqlite3 *db)
+    {
+        if (m_db && m_db != db)
+            sqlite3_trace_v2(m_db, 0, nullptr, nullptr);
+        m_db = db;
+        installTrace();
+    }
+
+    void DbStats::setEnabled(bool enabled)
+    {
+        m_enabled = enabled;
+        installTrace();
+    }
+
+    // Not called with m_mutex held: the trace callback takes it under SQLite's connection mutex
+    void DbStats::installTrace()
+    {
+        if (!m_db)
+            return;
+        if (enabled())
+            sqlite3_trace_v2(m_db, SQLITE_TRACE_STMT | SQLITE_TRACE_PROFILE | SQLITE_TRACE_ROW, &DbStats::traceCallback, this);
+        else
+            sqlite3_trace_v2(m_db, 0, nullptr, nullptr);
+
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_running.clear(); // statements in flight may never report again
+    }
+
+    int DbStats::traceCallback(unsigned type, void *ctx, void *p, void *)
+    {
+        auto now = std::chrono::steady_clock::now();
+        auto *self = static_cast<DbStats *>(ctx);
+        auto *stmt = static_cast<sqlite3_stmt *>(p);
+        std::lock_guard<std::mutex> lk(self->m_mutex);
+        if (type == SQLITE_TRACE_STMT)
+        {
+            // Also fires for each trigger program of the statement: keep the first start
+            self->m_running.emplace(stmt, Running{now, 0});
+            return 0;
+        }
+        auto it = self->m_running.find(stmt);
+        if (type == SQLITE_TRACE_ROW)
+        {
+            if (it != self->m_running.end())
+                ++it->second.rows;
+            return 0;
+        }
+        // SQLITE_TRACE_PROFILE: the statement finished
+        if (it == self->m_running.end())
+            return 0; // started before recording was enabled
+        const char *sql = sqlite3_sql(stmt);
+        Entry &e = self->m_statements[sql ? sql : "?"];
+        e.rows += it->second.rows;
+        e.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - it->second.start).count()));
+        self->m_running.erase(it);
+        return 0;
+    }
+
+    void DbStats::recordSpan(const char *name, uint64_t us)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_spans[name].latency.record(us);
+    }
+
+    void DbStats::reset()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_statements.clear();
+        m_spans.clear();
+        m_running.clear();
+    }
+
+    // SQL on one line with runs of whitespace collapsed
+    static std::string compactSql(const std::string &sql)
+    {
+        std::string out;
+        out.reserve(sql.size());
+        bool space = false;
+        for (char c : sql)
+        {
+            if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+            {
+                space = !out.empty();
+                continue;
+            }
+            if (space)
+                out.push_back(' ');
+            space = false;
+            out.push_back(c);
+        }
+        return out;
+    }
+
+    static std::string jsonString(const std::string &s)
+    {
+        std::string out = "\"";
+        for (char c : s)
+        {
+            switch (c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                }
+                else
+                    out.push_back(c);
+            }
+        }
+        return out + "\"";
+    }
+
+    // Entries sorted by total time, descending
+    template <typename Map>
+    static std::vector<typename Map::const_pointer> byTotalTime(const Map &map)
+    {
+        std::vector<typename Map::const_pointer> rows;
+        for (const auto &kv : map)
+            rows.push_back(&kv);
+        std::sort(rows.begin(), rows.end(), [](auto a, auto b)
+                  { return a->second.latency.totalUs() > b->second.latency.totalUs(); });
+        return rows;
+    }
+
+    void DbStats::dump() const
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        auto line = [](const char *kind, const std::string &name, uint64_t rows, const LatencyHistogram &h)
+        {
+            std::ostringstream os;
+            os << std::fixed << std::setprecision(2);
+            os << kind << " calls=" << h.count() << " rows=" << rows
+               << " total=" << h.totalUs() / 1000.0 << "ms"
+               << " p50=" << h.percentileUs(50) / 1000.0 << "ms"
+               << " p90=" << h.percentileUs(90) / 1000.0 << "ms"
+               << " p99=" << h.percentileUs(99) / 1000.0 << "ms"
+               << " max=" << h.maxUs() / 1000.0 << "ms  " << name;
+            Log() << "foo_monthly_stats: " << os.str().c_str();
+        };
+
+        Log() << "foo_monthly_stats: DB stats – " << (unsigned)m_statements.size() << " statements, "
+              << (unsigned)m_spans.size() << " spans" << (enabled() ? "" : " (recording off)");
+        for (auto kv : byTotalTime(m_spans))
+            line("span", kv->first, kv->second.rows, kv->second.latency);
+        for (auto kv : byTotalTime(m_statements))
+        {
+            std::string sql = compactSql(kv->first);
+            if (sql.size() > 120)
+                sql = sql.substr(0, 117) + "...";
+            line("sql ", sql, kv->second.rows, kv->second.latency);
+        }
+    }
+
+    bool DbStats::writeJson(const std::string &path) const
+    {
+        std::ostringstream os;
+        {
+            std::lock_guard<std::mutex> lk(m_mutex);
+            auto section = [&os](const char *key, const std::map<std::string, Entry> &map, bool sql)
+            {
+                os << "  " << jsonString(key) << ": [";
+                bool first = true;
+                for (auto kv : byTotalTime(map))
+                {
+                    const LatencyHistogram &h = kv->second.latency;
+                    os << (first ? "\n" : ",\n") << "    {"
+                       << "\"name\": " << jsonString(sql ? compactSql(kv->first) : kv->first)
+                       << ", \"calls\": " << h.count()
+                       << ", \"rows\": " << kv->second.rows
+                       << ", \"total_us\": " << h.totalUs()
+                       << ", \"p50_us\": " << h.percentileUs(50)
+                       << ", \"p90_us\": " << h.percentileUs(90)
+                       << ", \"p99_us\": " << h.percentileUs(99)
+                       << ", \"max_us\": " << h.maxUs() << "}";
+                    first = false;
+                }
+                os << (first ? "]" : "\n  ]");
+            };
+            os << "{\n";
+            os << "  \"enabled\": " << (enabled() ? "true" : "false") << ",\n";
+            section("spans", m_spans, false);
+            os << ",\n";
+            section("statements", m_statements, true);
+            os << "\n}\n";
+        }
+
+        std::ofstream out(std::filesystem::u8path(path), std::ios::binary | std::ios::trunc);
+        if (!out)
+            return false;
+        const std::string text = os.str();
+        out.write(text.data(), static_cast<std::streamsize>(text.size()));
+        return static_cast<bool>(out);
+    }
+
+} // namespace fms
@@ -0,0 +1,109 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // LatencyHistogram – log-linear (HDR-style) buckets of microsecond values
+    //
+    // Each power of two is split into 8 linear sub-buckets, so any recorded
+    // value is reported within 12.5% whatever its magnitude, in fixed memory.
+    // -----------------------------------------------------------------------
+    class LatencyHistogram
+    {
+    public:
+        void record(uint64_t us);
+
+        uint64_t count() const { return m_count; }
+        uint64_t totalUs() const { return m_total; }
+        uint64_t maxUs() const { return m_max; }
+
+        // Upper bound of the bucket holding the given percentile (0–100)
+        uint64_t percentileUs(double p) const;
+
+    private:
+        static constexpr int kSubBits = 3;
+        static constexpr int kSubBuckets = 1 << kSubBits;
+        static constexpr int kBuckets = (64 - kSubBits + 1) * kSubBuckets;
+
+        static int bucketOf(uint64_t us);
+        static uint64_t bucketUpper(int idx);
+
+        uint64_t m_counts[kBuckets] = {};
+        uint64_t m_count = 0;
+        uint64_t m_total = 0;
+        uint64_t m_max = 0;
+    };
+
+    // -----------------------------------------------------------------------
+    // DbStats – per-statement call counts, rows and latency of the DB connection
+    //
+    // Statements are timed with sqlite3_trace_v2, keyed by their SQL text: from
+    // SQLITE_TRACE_STMT (first step) to SQLITE_TRACE_PROFILE (done or reset) on
+    // the steady clock, since the profile's own elapsed time only has system
+    // clock resolution. Rows come from SQLITE_TRACE_ROW.
+    //
+    // Timer adds named spans around work SQLite cannot see (snapshot and cache
+    // hits, the dashboard refresh). The trace hook is only installed while
+    // enabled, so a disabled DbStats costs one relaxed atomic load per span.
+    // -----------------------------------------------------------------------
+    class DbStats
+    {
+    public:
+        // Times the enclosing scope as span "name" (a string literal) while enabled
+        class Timer
+        {
+        public:
+            explicit Timer(const char *name);
+            ~Timer();
+            Timer(const Timer &) = delete;
+            Timer &operator=(const Timer &) = delete;
+
+        private:
+            const char *m_name;
+            std::chrono::steady_clock::time_point m_start;
+        };
+
+        // Connection to trace; null detaches
+        void attach(sqlite3 *db);
+
+        void setEnabled(bool enabled);
+        bool enabled() const { return m_enabled.load(std::memory_order_relaxed); }
+
+        void recordSpan(const char *name, uint64_t us);
+        void reset();
+
+        // Table of statements and spans sorted by total time, to the console
+        void dump() const;
+
+        // Same data as JSON (UTF-8 path); false if the file could not be written
+        bool writeJson(const std::string &path) const;
+
+        static DbStats &get();
+
+    private:
+        struct Entry
+        {
+            uint64_t rows = 0;
+            LatencyHistogram latency;
+        };
+
+        struct Running
+        {
+            std::chrono::steady_clock::time_point start;
+            uint64_t rows = 0;
+        };
+
+        static int traceCallback(unsigned type, void *ctx, void *p, void *x);
+        void installTrace();
+
+        std::map<std::string, Entry> m_statements; // SQL text -> stats
+        std::map<std::string, Entry> m_spans;      // span name -> stats
+        std::unordered_map<sqlite3_stmt *, Running> m_running; // statements between first step and finish
+        mutable std::mutex m_mutex; // guards the maps (trace fires on the worker and UI threads)
+        sqlite3 *m_db{nullptr};
+        std::atomic<bool> m_enabled{false};
+    };
+
+} // namespace fms
@@ -0,0 +1,153 @@
+#include "core.h"
+#include "hot_aggregate.h"
+
+namespace fms
+{
+
+    // Matches the GROUP BY track_crc, path, title, artist, album of the period queries
+    static std::string groupKey(const HotAggregate::Row &r)
+    {
+        std::string key;
+        key.reserve(r.track_crc.size() + r.path.size() + r.title.size() + r.artist.size() + r.album.size() + 4);
+        key.append(r.track_crc).push_back('\x1f');
+        key.append(r.path).push_back('\x1f');
+        key.append(r.title).push_back('\x1f');
+        key.append(r.artist).push_back('\x1f');
+        key.append(r.album);
+        return key;
+    }
+
+    static void mergeRow(HotAggregate::Row &into, const HotAggregate::Row &row)
+    {
+        into.length_seconds = (std::max)(into.length_seconds, row.length_seconds);
+        into.playcount += row.playcount;
+        into.total_time_seconds += row.total_time_seconds;
+    }
+
+    static MonthlyEntry toEntry(const HotAggregate::Row &r, const std::string &ymd, int64_t prev)
+    {
+        MonthlyEntry e;
+        e.ymd = ymd;
+        e.track_crc = r.track_crc;
+        e.path = r.path;
+        e.title = r.title;
+        e.artist = r.artist;
+        e.album = r.album;
+        e.length_seconds = r.length_seconds;
+        e.playcount = r.playcount;
+        e.prev_playcount = prev;
+        e.total_time_seconds = r.total_time_seconds;
+        return e;
+    }
+
+    static void sortByPlays(std::vector<MonthlyEntry> &v)
+    {
+        std::stable_sort(v.begin(), v.end(), [](const MonthlyEntry &a, const MonthlyEntry &b)
+                         { return a.playcount > b.playcount; });
+    }
+
+    HotAggregate::HotAggregate(const std::string &ymd)
+        : m_ymd(ymd), m_ym(ymd.substr(0, 7)), m_year(ymd.substr(0, 4)), m_base(std::make_shared<Base>())
+    {
+    }
+
+    void HotAggregate::addToday(const Row &row)
+    {
+        m_today[row.track_crc] = row;
+    }
+
+    void HotAggregate::addBase(Level level, const Row &row)
+    {
+        auto &map = (level == YEAR) ? m_base->year : m_base->month;
+        auto it = map.find(groupKey(row));
+        if (it == map.end())
+            map.emplace(groupKey(row), row);
+        else
+            mergeRow(it->second, row);
+    }
+
+    void HotAggregate::setPrevious(Level level, const std::string &track_crc, int64_t playcount)
+    {
+        m_base->prev[level][track_crc] = playcount;
+    }
+
+    void HotAggregate::applyToday(const Row &delta)
+    {
+        for (auto &r : m_rows)
+            r.reset(); // copied from the previous snapshot, now stale
+
+        auto it = m_today.find(delta.track_crc);
+        if (it == m_today.end())
+        {
+            m_today.emplace(delta.track_crc, delta);
+            return;
+        }
+        // ON CONFLICT: counters accumulate, metadata and length take the latest values
+        Row &r = it->second;
+        r.playcount += delta.playcount;
+        r.total_time_seconds += delta.total_time_seconds;
+        r.path = delta.path;
+        r.title = delta.title;
+        r.artist = delta.artist;
+        r.album = delta.album;
+        r.length_seconds = delta.length_seconds;
+    }
+
+    std::shared_ptr<const std::vector<MonthlyEntry>> HotAggregate::rows(Level level) const
+    {
+        // Readers race benignly: whoever builds first publishes, the others use it
+        if (auto built = std::atomic_load(&m_rows[level]))
+            return built;
+        std::shared_ptr<const std::vector<MonthlyEntry>> built =
+            std::make_shared<const std::vector<MonthlyEntry>>(level == DAY     ? dayRows()
+                                                              : level == MONTH ? grouped(m_base->month, MONTH, m_ym + "-01")
+                                                                               : grouped(m_base->year, YEAR, m_year + "-01-01"));
+        std::atomic_store(&m_rows[level], built);
+        return built;
+    }
+
+    std::vector<MonthlyEntry> HotAggregate::dayRows() const
+    {
+        const auto &prev = m_base->prev[DAY];
+        std::vector<MonthlyEntry> result;
+        result.reserve(m_today.size());
+        for (const auto &kv : m_today)
+        {
+            if (kv.second.playcount <= 0)
+                continue;
+            auto p = prev.find(kv.first);
+            result.push_back(toEntry(kv.second, m_ymd, p != prev.end() ? p->second : 0));
+        }
+        sortByPlays(result);
+        return result;
+    }
+
+    std::vector<MonthlyEntry> HotAggregate::grouped(const std::unordered_map<std::string, Row> &base, Level level,
+                                                    const std::string &ymd) const
+    {
+        // Base groups plus today's rows regrouped under their current metadata
+        std::unordered_map<std::string, Row> groups = base;
+        for (const auto &kv : m_today)
+        {
+            auto it = groups.find(groupKey(kv.second));
+            if (it == groups.end())
+                groups.emplace(groupKey(kv.second), kv.second);
+            else
+                mergeRow(it->second, kv.second);
+        }
+
+        const auto &prev = m_base->prev[level];
+        std::vector<MonthlyEntry> result;
+        result.reserve(groups.size());
+        for (const auto &kv : groups)
+        {
+            if (kv.second.playcount <= 0)
+                continue;
+            auto p = prev.find(kv.second.track_crc);
+            result.push_back(toEntry(kv.second, ymd, p != prev.end() ? p->second : 0));
+        }
+        sortByPlays(result);
+        return result;
+    }
+
+} // namespace fms
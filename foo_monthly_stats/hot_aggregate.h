@@ -0,0 +1,75 @@
+#pragma once
+#include "core.h"
+#include "db_manager.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // HotAggregate – in-memory copy of the current day/month/year aggregates
+    //
+    // Split into an immutable base (rows of the current month/year before today
+    // and the previous periods' play counts) and today's monthly_count rows.
+    // Only today's rows change with new plays, so a copy-on-write update copies
+    // a handful of rows while the base is shared between snapshots.
+    // -----------------------------------------------------------------------
+    class HotAggregate
+    {
+    public:
+        struct Row
+        {
+            std::string track_crc;
+            std::string path;
+            std::string title;
+            std::string artist;
+            std::string album;
+            double length_seconds = 0;
+            int64_t playcount = 0;
+            double total_time_seconds = 0;
+        };
+
+        enum Level
+        {
+            DAY,
+            MONTH,
+            YEAR
+        };
+
+        // ymd: the day treated as "today" ("YYYY-MM-DD"); month and year derive from it
+        explicit HotAggregate(const std::string &ymd);
+
+        const std::string &ymd() const { return m_ymd; }
+        const std::string &ym() const { return m_ym; }
+        const std::string &year() const { return m_year; }
+
+        // Loading – only before the snapshot is published
+        void addToday(const Row &row);
+        void addBase(Level level, const Row &row); // MONTH / YEAR rows excluding today, grouped by track tuple
+        void setPrevious(Level level, const std::string &track_crc, int64_t playcount);
+
+        // Same effect as insertPlay's monthly_count upsert on today's row
+        void applyToday(const Row &delta);
+
+        // Results in the shape of DbManager::queryDay / queryMonth / queryYear,
+        // built on first use and shared until the next applyToday()
+        std::shared_ptr<const std::vector<MonthlyEntry>> rows(Level level) const;
+
+    private:
+        struct Base
+        {
+            std::unordered_map<std::string, Row> month; // group key -> aggregate
+            std::unordered_map<std::string, Row> year;
+            std::unordered_map<std::string, int64_t> prev[3]; // Level -> track_crc -> playcount
+        };
+
+        std::vector<MonthlyEntry> dayRows() const;
+        std::vector<MonthlyEntry> grouped(const std::unordered_map<std::string, Row> &base, Level level,
+                                          const std::string &ymd) const;
+
+        std::string m_ymd, m_ym, m_year;
+        std::shared_ptr<Base> m_base;                // shared between snapshots
+        std::unordered_map<std::string, Row> m_today; // track_crc -> today's row
+        mutable std::shared_ptr<const std::vector<MonthlyEntry>> m_rows[3]; // Level -> built result (atomic_load/store)
+    };
+
+} // namespace fms
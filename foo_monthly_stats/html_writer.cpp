@@ -0,0 +1,172 @@
+#include "core.h"
+#include "html_writer.h"
+
+namespace fms
+{
+
+    HtmlWriter::HtmlWriter(const std::filesystem::path &path)
+        : m_file(path, std::ios::binary | std::ios::trunc)
+    {
+        m_buffer.reserve(kBufferBytes);
+        append("\xef\xbb\xbf");
+    }
+
+    void HtmlWriter::doctype()
+    {
+        append("<!DOCTYPE html>");
+    }
+
+    void HtmlWriter::open(const char *tag, Attributes attributes)
+    {
+        startTag(tag, attributes);
+        append(">");
+        m_open.push_back(tag);
+    }
+
+    void HtmlWriter::close()
+    {
+        if (m_open.empty())
+            return;
+        const char *tag = m_open.back();
+        m_open.pop_back();
+        newline();
+        append("</");
+        append(tag);
+        append(">");
+    }
+
+    void HtmlWriter::element(const char *tag, Attributes attributes, std::string_view text)
+    {
+        startTag(tag, attributes);
+        append(">");
+        escaped(text, false);
+        append("</");
+        append(tag);
+        append(">");
+    }
+
+    void HtmlWriter::empty(const char *tag, Attributes attributes)
+    {
+        startTag(tag, attributes);
+        append(">");
+    }
+
+    void HtmlWriter::rawElement(const char *tag, std::string_view content)
+    {
+        startTag(tag, {});
+        append(">");
+        append(content);
+        append("</");
+        append(tag);
+        append(">");
+    }
+
+    bool HtmlWriter::finish()
+    {
+        if (m_finished)
+            return m_file.good();
+        while (!m_open.empty())
+            close();
+        append("\n");
+        flush();
+        m_file.close();
+        m_finished = true;
+        return !m_file.fail();
+    }
+
+    void HtmlWriter::startTag(const char *tag, Attributes attributes)
+    {
+        newline();
+        append("<");
+        append(tag);
+        for (const auto &[name, value] : attributes)
+        {
+            append(" ");
+            append(name);
+            append("=\"");
+            escaped(value, true);
+            append("\"");
+        }
+    }
+
+    void HtmlWriter::newline()
+    {
+        append("\n");
+        m_buffer.append(m_open.size() * 2, ' ');
+    }
+
+    void HtmlWriter::append(std::string_view s)
+    {
+        if (m_buffer.size() + s.size() > kBufferBytes)
+        {
+            flush();
+            if (s.size() > kBufferBytes) // e.g. a large embedded image: no copy
+            {
+                m_file.write(s.data(), static_cast<std::streamsize>(s.size()));
+                return;
+            }
+        }
+        m_buffer.append(s);
+    }
+
+    void HtmlWriter::escaped(std::string_view s, bool attribute)
+    {
+        size_t plain = 0; // start of the run not yet appended
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            const char *entity = nullptr;
+            switch (s[i])
+            {
+            case '&':
+                entity = "&amp;";
+                break;
+            case '<':
+                entity = "&lt;";
+                break;
+            case '>':
+                entity = "&gt;";
+                break;
+            case '"':
+                entity = attribute ? "&quot;" : nullptr;
+                break;
+            }
+            if (!entity)
+                continue;
+            append(s.substr(plain, i - plain));
+            append(entity);
+            plain = i + 1;
+        }
+        append(s.substr(plain));
+    }
+
+    void HtmlWriter::jsonString(std::string_view s)
+    {
+        append("\"");
+        size_t plain = 0;
+        for (size_t i = 0; i < s.size(); ++i)
+        {
+            const unsigned char c = static_cast<unsigned char>(s[i]);
+            if (c >= 0x20 && c != '"' && c != '\\' && c != '<')
+                continue;
+            append(s.substr(plain, i - plain));
+            char escape[8];
+            if (c == '"' || c == '\\')
+                snprintf(escape, sizeof(escape), "\\%c", c);
+            else
+                snprintf(escape, sizeof(escape), "\\u%04x", c);
+            append(escape);
+            plain = i + 1;
+        }
+        append(s.substr(plain));
+        append("\"");
+    }
+
+    void HtmlWriter::flush()
+    {
+        if (m_buffer.empty())
+            return;
+        m_file.write(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+
+} // namespace fms
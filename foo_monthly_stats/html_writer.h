@@ -0,0 +1,70 @@
+#pragma once
+#include "core.h"
+#include <string_view>
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // HtmlWriter – streaming HTML emitter for the reports
+    //
+    // Elements are written to the file as they are produced, through a
+    // fixed-size buffer, instead of being built as a document first: memory
+    // stays the same however many rows a report has. Text and attribute values
+    // are escaped; raw() and rawElement() are for the embedded CSS and scripts,
+    // jsonString() for data embedded in them.
+    // Output is UTF-8 with a BOM, indented two spaces per level.
+    //
+    //   HtmlWriter w(path);
+    //   w.open("div", {{"class", "card"}});
+    //   w.element("div", {{"class", "title"}}, title);
+    //   w.close();
+    //   if (!w.finish()) ...
+    // -----------------------------------------------------------------------
+    class HtmlWriter
+    {
+    public:
+        using Attributes = std::initializer_list<std::pair<const char *, std::string_view>>;
+
+        explicit HtmlWriter(const std::filesystem::path &path);
+        ~HtmlWriter() { finish(); }
+        HtmlWriter(const HtmlWriter &) = delete;
+        HtmlWriter &operator=(const HtmlWriter &) = delete;
+
+        void doctype();
+
+        // <tag ...>; children follow until the matching close()
+        void open(const char *tag, Attributes attributes = {});
+        void close();
+
+        // <tag ...>text</tag>
+        void element(const char *tag, Attributes attributes, std::string_view text);
+        // <tag ...> without content or end tag (meta, link, img)
+        void empty(const char *tag, Attributes attributes = {});
+        // <tag>content</tag>, content unescaped (style, script)
+        void rawElement(const char *tag, std::string_view content);
+
+        void raw(std::string_view content) { append(content); }
+
+        // Quoted JSON string; '<' is escaped too, so it is safe inside <script>
+        void jsonString(std::string_view s);
+
+        // Closes what is still open and flushes; false when anything failed to write
+        bool finish();
+
+    private:
+        void startTag(const char *tag, Attributes attributes);
+        void newline();
+        void append(std::string_view s);
+        void escaped(std::string_view s, bool attribute);
+        void flush();
+
+        static constexpr size_t kBufferBytes = 64 * 1024;
+
+        std::ofstream m_file;
+        std::string m_buffer;
+        std::vector<const char *> m_open; // tags awaiting close()
+        bool m_finished = false;
+    };
+
+} // namespace fms
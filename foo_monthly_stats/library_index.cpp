@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "library_index.h"
+
+namespace fms
+{
+
+    static std::string trimmed(const char *str)
+    {
+        if (!str)
+            return "";
+        std::string s(str);
+        size_t start = s.find_first_not_of(" \t\r\n");
+        if (start == std::string::npos)
+            return "";
+        size_t end = s.find_last_not_of(" \t\r\n");
+        return s.substr(start, end - start + 1);
+    }
+
+    static std::string folded(std::string s)
+    {
+        for (char &c : s)
+            c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    // Unit separator: cannot appear in a tag typed by a user
+    static std::string makeKey(const std::string &title, const std::string &artist)
+    {
+        return title + '\x1f' + artist;
+    }
+
+    static std::string makeKey(const std::string &title, const std::string &artist, const std::string &album)
+    {
+        return title + '\x1f' + artist + '\x1f' + album;
+    }
+
+    LibraryIndex::LibraryIndex(const metadb_handle_list &items) : m_itemCount(items.get_count())
+    {
+        struct Keys
+        {
+            bool valid = false;
+            std::string titleArtist; // trimmed
+            std::string exact;       // trimmed title/artist/album
+        };
+        std::vector<Keys> keys(m_itemCount);
+
+        // Reading tags dominates; shared info references are safe to read from any thread
+        const size_t workers = (std::max)(size_t(1), (std::min)(size_t(std::thread::hardware_concurrency()), m_itemCount / 1024 + 1));
+        const size_t chunk = (m_itemCount + workers - 1) / workers;
+        auto readRange = [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; ++i)
+            {
+                metadb_info_container::ptr info;
+                if (!items[i]->get_info_ref(info))
+                    continue;
+                const file_info &fi = info->info();
+                Keys &k = keys[i];
+                std::string title = trimmed(fi.meta_get("TITLE", 0));
+                std::string artist = trimmed(fi.meta_get("ARTIST", 0));
+                k.exact = makeKey(title, artist, trimmed(fi.meta_get("ALBUM", 0)));
+                k.titleArtist = makeKey(title, artist);
+                k.valid = true;
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t w = 1; w < workers; ++w)
+            threads.emplace_back(readRange, (std::min)(w * chunk, m_itemCount), (std::min)((w + 1) * chunk, m_itemCount));
+        readRange(0, (std::min)(chunk, m_itemCount));
+        for (auto &t : threads)
+            t.join();
+
+        // Merge in library order so the first matching item wins
+        m_exact.reserve(m_itemCount);
+        m_folded.reserve(m_itemCount);
+        m_titleArtist.reserve(m_itemCount);
+        for (size_t i = 0; i < m_itemCount; ++i)
+        {
+            Keys &k = keys[i];
+            if (!k.valid)
+                continue;
+            m_folded.emplace(folded(k.exact), items[i]);
+            m_exact.emplace(std::move(k.exact), items[i]);
+            m_titleArtist[std::move(k.titleArtist)].push_back(items[i]);
+        }
+    }
+
+    metadb_handle_ptr LibraryIndex::find(const std::string &title, const std::string &artist, const std::string &album) const
+    {
+        const std::string key = makeKey(trimmed(title.c_str()), trimmed(artist.c_str()), trimmed(album.c_str()));
+        auto it = m_exact.find(key);
+        if (it != m_exact.end())
+            return it->second;
+        auto ci = m_folded.find(folded(key));
+        if (ci != m_folded.end())
+            return ci->second;
+        return nullptr;
+    }
+
+    const std::vector<metadb_handle_ptr> &LibraryIndex::findByTitleArtist(const std::string &title, const std::string &artist) const
+    {
+        static const std::vector<metadb_handle_ptr> none;
+        auto it = m_titleArtist.find(makeKey(trimmed(title.c_str()), trimmed(artist.c_str())));
+        return it != m_titleArtist.end() ? it->second : none;
+    }
+
+} // namespace fms
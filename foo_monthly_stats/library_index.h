@@ -0,0 +1,36 @@
+#pragma once
+#include "stdafx.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // LibraryIndex – media library items by normalized metadata
+    //
+    // Built once per export: every item's tags are read a single time (the
+    // items are split across worker threads), then each ArtCollector lookup is
+    // a hash probe instead of a scan of the whole library. Keys are the
+    // whitespace-trimmed TITLE/ARTIST/ALBUM; when several items share a key
+    // the first in library order wins, as with the linear scans it replaces.
+    // -----------------------------------------------------------------------
+    class LibraryIndex
+    {
+    public:
+        explicit LibraryIndex(const metadb_handle_list &items);
+
+        // Same title, artist and album: exact first, then ASCII case-insensitive
+        metadb_handle_ptr find(const std::string &title, const std::string &artist, const std::string &album) const;
+
+        // Every item with this exact title and artist, any album (in library order)
+        const std::vector<metadb_handle_ptr> &findByTitleArtist(const std::string &title, const std::string &artist) const;
+
+        size_t size() const { return m_itemCount; }
+
+    private:
+        size_t m_itemCount;
+        std::unordered_map<std::string, metadb_handle_ptr> m_exact;
+        std::unordered_map<std::string, metadb_handle_ptr> m_folded;
+        std::unordered_map<std::string, std::vector<metadb_handle_ptr>> m_titleArtist;
+    };
+
+} // namespace fms
@@ -0,0 +1,37 @@
+#include "core.h"
+#include "listen_timer.h"
+
+namespace fms
+{
+
+    void ListenTimer::start(bool paused, Clock::time_point now)
+    {
+        m_seconds = 0.0;
+        m_since = now;
+        m_running = !paused;
+    }
+
+    void ListenTimer::pause(Clock::time_point now)
+    {
+        if (!m_running)
+            return;
+        m_seconds = seconds(now);
+        m_running = false;
+    }
+
+    void ListenTimer::resume(Clock::time_point now)
+    {
+        if (m_running)
+            return;
+        m_since = now;
+        m_running = true;
+    }
+
+    double ListenTimer::seconds(Clock::time_point now) const
+    {
+        if (!m_running || now < m_since)
+            return m_seconds;
+        return m_seconds + std::chrono::duration<double>(now - m_since).count();
+    }
+
+} // namespace fms
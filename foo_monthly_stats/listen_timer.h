@@ -0,0 +1,39 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // ListenTimer – seconds actually listened to the current track
+    //
+    // Runs on the steady clock between playback transitions instead of
+    // sampling the playback position: a seek forward adds nothing, a seek back
+    // keeps counting, and paused time is left out. Nothing needs to be called
+    // while the track plays. The time points are parameters for tests.
+    // -----------------------------------------------------------------------
+    class ListenTimer
+    {
+    public:
+        using Clock = std::chrono::steady_clock;
+
+        // New track: back to zero, running unless paused
+        void start(bool paused = false, Clock::time_point now = Clock::now());
+
+        // Pause or stop: freeze the count (no-op while frozen)
+        void pause(Clock::time_point now = Clock::now());
+
+        // Unpause (no-op while running)
+        void resume(Clock::time_point now = Clock::now());
+
+        double seconds(Clock::time_point now = Clock::now()) const;
+
+        bool running() const { return m_running; }
+
+    private:
+        double m_seconds = 0.0;     // listened before m_since
+        Clock::time_point m_since;  // start of the running segment
+        bool m_running = false;
+    };
+
+} // namespace fms
@@ -0,0 +1,101 @@
+#include "core.h"
+#include "period.h"
+
+namespace fms
+{
+
+    int64_t localMidnightMs(int year, int month, int day)
+    {
+        struct tm t{};
+        t.tm_year = year - 1900;
+        t.tm_mon = month - 1; // mktime normalizes month/day overflow
+        t.tm_mday = day;
+        t.tm_isdst = -1;
+        return static_cast<int64_t>(mktime(&t)) * 1000;
+    }
+
+    // [startMs, endMs) for "YYYY", "YYYY-MM" or "YYYY-MM-DD"
+    bool periodBoundsMs(const std::string &period, int64_t &startMs, int64_t &endMs)
+    {
+        int y = 0, m = 0, d = 0;
+        if (period.size() == 4 && sscanf(period.c_str(), "%4d", &y) == 1)
+        {
+            startMs = localMidnightMs(y, 1, 1);
+            endMs = localMidnightMs(y + 1, 1, 1);
+            return true;
+        }
+        if (period.size() == 7 && sscanf(period.c_str(), "%4d-%2d", &y, &m) == 2)
+        {
+            startMs = localMidnightMs(y, m, 1);
+            endMs = localMidnightMs(y, m + 1, 1);
+            return true;
+        }
+        if (period.size() == 10 && sscanf(period.c_str(), "%4d-%2d-%2d", &y, &m, &d) == 3)
+        {
+            startMs = localMidnightMs(y, m, d);
+            endMs = localMidnightMs(y, m, d + 1);
+            return true;
+        }
+        return false;
+    }
+
+    struct tm localTime(int64_t epochMs)
+    {
+        time_t t = static_cast<time_t>(epochMs / 1000);
+        struct tm local_tm;
+#ifdef _WIN32
+        localtime_s(&local_tm, &t);
+#else
+        localtime_r(&t, &local_tm);
+#endif
+        return local_tm;
+    }
+
+    // "YYYY-MM-DD" of the day before ymd
+    std::string previousDay(const std::string &ymd)
+    {
+        int year = std::stoi(ymd.substr(0, 4));
+        int month = std::stoi(ymd.substr(5, 2));
+        int day = std::stoi(ymd.substr(8, 2));
+        day--;
+        if (day == 0)
+        {
+            month--;
+            if (month == 0)
+            {
+                month = 12;
+                year--;
+            }
+            const int daysInMonth[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+            int leap = ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0)) ? 1 : 0;
+            day = daysInMonth[month] + (month == 2 ? leap : 0);
+        }
+        char buf[11];
+        snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month, day);
+        return buf;
+    }
+
+    std::string addMonths(const std::string &ym, int delta)
+    {
+        int year = 0, month = 0;
+        if (ym.size() != 7 || sscanf(ym.c_str(), "%4d-%2d", &year, &month) != 2)
+            throw std::invalid_argument("not a YYYY-MM period: " + ym);
+
+        // Months since 0000-01, kept within 0000-01 .. 9999-12
+        const int64_t index = year * 12LL + ((std::min)((std::max)(month, 1), 12) - 1) + delta;
+        const int64_t clamped = (std::min)((std::max)(index, int64_t(0)), int64_t(9999 * 12 + 11));
+        char buf[24]; // room for two full-width ints, so the format can never truncate
+        snprintf(buf, sizeof(buf), "%04d-%02d", static_cast<int>(clamped / 12), static_cast<int>(clamped % 12) + 1);
+        return buf;
+    }
+
+    std::string nextDueReportMonth(const std::string &lastReported, const std::string &currentYM)
+    {
+        if (lastReported.empty())
+            return "";
+        if (lastReported >= addMonths(currentYM, -1))
+            return "";
+        return addMonths(lastReported, 1);
+    }
+
+} // namespace fms
@@ -0,0 +1,35 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // Local-time period helpers
+    //
+    // Plays are bucketed by the local calendar day they started on; periods are
+    // "YYYY", "YYYY-MM" or "YYYY-MM-DD" strings of that calendar.
+    // -----------------------------------------------------------------------
+
+    // Epoch ms of local midnight starting the given day (month/day overflow is normalized)
+    int64_t localMidnightMs(int year, int month, int day);
+
+    // [startMs, endMs) for "YYYY", "YYYY-MM" or "YYYY-MM-DD"; false for anything else
+    bool periodBoundsMs(const std::string &period, int64_t &startMs, int64_t &endMs);
+
+    struct tm localTime(int64_t epochMs);
+
+    // "YYYY-MM-DD" of the day before ymd
+    std::string previousDay(const std::string &ymd);
+
+    // "YYYY-MM" delta months after ym (before it when negative), clamped to
+    // 0000-01 .. 9999-12; throws std::invalid_argument unless ym is "YYYY-MM"
+    std::string addMonths(const std::string &ym, int delta);
+
+    // Month the automatic report covers next: the one after lastReported, once
+    // currentYM has moved past it; empty when none is due. An empty lastReported
+    // (reporting just switched on) is not due either – the caller then records
+    // addMonths(currentYM, -1), so the month running now is reported first.
+    std::string nextDueReportMonth(const std::string &lastReported, const std::string &currentYM);
+
+} // namespace fms
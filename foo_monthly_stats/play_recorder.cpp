@@ -2,32 +2,26 @@
 #include "play_recorder.h"
 #include "db_manager.h"
 #include "preferences.h"
+#include "track_meta_cache.h"
 
 namespace fms
 {
 
-    // CRC64 – must match db_manager.cpp's implementation
-    static uint64_t crc64(const char *data, size_t len)
-    {
-        static const uint64_t POLY = 0xad93d23594c935a9ULL;
-        uint64_t crc = 0;
-        for (size_t i = 0; i < len; ++i)
-        {
-            crc ^= static_cast<uint8_t>(data[i]);
-            for (int j = 0; j < 8; ++j)
-            {
-                if (crc & 1)
-                    crc = (crc >> 1) ^ POLY;
-                else
-                    crc >>= 1;
-            }
-        }
-        return crc;
-    }
-
     // PlaybackTimeTracker implementation
     metadb_handle_ptr PlaybackTimeTracker::s_current_track;
-    double PlaybackTimeTracker::s_last_playback_time = 0.0;
+    ListenTimer PlaybackTimeTracker::s_listen;
+    bool PlaybackTimeTracker::s_start_paused = false;
+
+    // UNIX epoch milliseconds (UTC)
+    static int64_t nowEpochMs()
+    {
+        FILETIME ft;
+        GetSystemTimeAsFileTime(&ft);
+        ULARGE_INTEGER ul;
+        ul.LowPart = ft.dwLowDateTime;
+        ul.HighPart = ft.dwHighDateTime;
+        return static_cast<int64_t>((ul.QuadPart / 10000ULL) - 11644473600000ULL);
+    }
 
     // Helper function to record track playback time
     static void record_playback_time(metadb_handle_ptr track, double played_seconds, const char *source)
@@ -35,66 +29,60 @@ namespace fms
         if (!track.is_valid() || played_seconds < 1.0)
             return;
 
-        file_info_impl fi;
-        if (!track->get_info(fi))
-            return;
-
-        const char *path = track->get_path();
-        uint64_t crcVal = crc64(path, strlen(path));
-        char crcHex[17];
-        snprintf(crcHex, sizeof(crcHex), "%016llx", (unsigned long long)crcVal);
-
         TrackInfo ti;
-        ti.track_crc = crcHex;
-        ti.path = path;
-        ti.title = fi.meta_get("TITLE", 0) ? fi.meta_get("TITLE", 0) : "";
-        ti.artist = fi.meta_get("ARTIST", 0) ? fi.meta_get("ARTIST", 0) : "";
-        ti.album = fi.meta_get("ALBUM", 0) ? fi.meta_get("ALBUM", 0) : "";
+        if (!TrackMetaCache::get().fill(track, ti))
+            return;
         ti.length_seconds = played_seconds;
+        ti.played_at = nowEpochMs();
 
-        FILETIME ft;
-        GetSystemTimeAsFileTime(&ft);
-        ULARGE_INTEGER ul;
-        ul.LowPart = ft.dwLowDateTime;
-        ul.HighPart = ft.dwHighDateTime;
-        ti.played_at = static_cast<int64_t>((ul.QuadPart / 10000ULL) - 11644473600000ULL);
+        FMS_LOG(LogLevel::Debug, LogCategory::Recorder) << "[foo_monthly_stats] " << source << ": recording "
+                                                        << ti.title << " (" << played_seconds << "s)";
 
-        console::formatter() << "[foo_monthly_stats] " << source << ": recording "
-                             << ti.title.c_str() << " (" << played_seconds << "s)";
+        DbManager::get().postPlay(std::move(ti));
+    }
 
-        DbManager::get().postPlay(ti);
+    void PlaybackTimeTracker::on_playback_starting(play_control::t_track_command, bool paused)
+    {
+        s_start_paused = paused;
     }
 
     void PlaybackTimeTracker::on_playback_new_track(metadb_handle_ptr track)
     {
         // Record previous track's playback time before switching
-        if (s_current_track.is_valid() && s_last_playback_time >= 1.0)
+        if (s_current_track.is_valid())
         {
-            record_playback_time(s_current_track, s_last_playback_time, "on_playback_new_track");
+            record_playback_time(s_current_track, s_listen.seconds(), "on_playback_new_track");
         }
 
         // Switch to new track
         s_current_track = track;
-        s_last_playback_time = 0.0;
+        s_listen.start(s_start_paused);
+        s_start_paused = false; // gapless transitions have no starting event
     }
 
-    void PlaybackTimeTracker::on_playback_time(double p_time)
+    void PlaybackTimeTracker::on_playback_pause(bool paused)
     {
-        s_last_playback_time = p_time;
+        if (paused)
+            s_listen.pause();
+        else
+            s_listen.resume();
     }
 
     void PlaybackTimeTracker::on_playback_stop(play_control::t_stop_reason reason)
     {
+        // Playback is over for this track either way: freeze its time
+        s_listen.pause();
+
         // When starting another track, don't record or clear state yet
         // Let on_playback_new_track handle recording and state change
         if (reason != play_control::stop_reason_starting_another)
         {
             // Record on complete stop (user stop, EOF without next track, shutdown)
-            record_playback_time(s_current_track, s_last_playback_time, "on_playback_stop");
+            record_playback_time(s_current_track, s_listen.seconds(), "on_playback_stop");
 
             // Clear state only when not transitioning to another track
             s_current_track.release();
-            s_last_playback_time = 0.0;
+            s_listen.start(true);
         }
         // Note: When reason == stop_reason_starting_another, state is preserved
         // for on_playback_new_track to record the time before switching tracks
@@ -103,7 +91,7 @@ namespace fms
     double PlaybackTimeTracker::get_played_time(metadb_handle_ptr track)
     {
         if (s_current_track.is_valid() && s_current_track == track)
-            return s_last_playback_time;
+            return s_listen.seconds();
         return 0.0;
     }
 
@@ -111,49 +99,28 @@ namespace fms
     {
         if (!p_item.is_valid())
         {
-            console::formatter() << "[foo_monthly_stats] on_item_played: invalid track";
+            FMS_LOG(LogLevel::Warning, LogCategory::Recorder) << "[foo_monthly_stats] on_item_played: invalid track";
             return;
         }
 
-        // Read metadata
-        file_info_impl fi;
-        if (!p_item->get_info(fi))
+        // Read metadata (cached per track, reused by its stop event)
+        TrackInfo ti;
+        if (!TrackMetaCache::get().fill(p_item, ti))
         {
-            console::formatter() << "[foo_monthly_stats] on_item_played: failed to get file info";
+            FMS_LOG(LogLevel::Warning, LogCategory::Recorder) << "[foo_monthly_stats] on_item_played: failed to get file info";
             return;
         }
 
-        // Calculate CRC for track path
-        const char *path = p_item->get_path();
-        uint64_t crcVal = crc64(path, strlen(path));
-        char crcHex[17];
-        snprintf(crcHex, sizeof(crcHex), "%016llx", (unsigned long long)crcVal);
-
-        // Build TrackInfo
-        TrackInfo ti;
-        ti.track_crc = crcHex;
-        ti.path = path;
-        ti.title = fi.meta_get("TITLE", 0) ? fi.meta_get("TITLE", 0) : "";
-        ti.artist = fi.meta_get("ARTIST", 0) ? fi.meta_get("ARTIST", 0) : "";
-        ti.album = fi.meta_get("ALBUM", 0) ? fi.meta_get("ALBUM", 0) : "";
-
         // Only record play count (not duration) in on_item_played
         // Actual playback time will be recorded by on_playback_stop
         ti.length_seconds = 0;
+        ti.played_at = nowEpochMs();
 
-        // UNIX epoch milliseconds (UTC)
-        FILETIME ft;
-        GetSystemTimeAsFileTime(&ft);
-        ULARGE_INTEGER ul;
-        ul.LowPart = ft.dwLowDateTime;
-        ul.HighPart = ft.dwHighDateTime;
-        ti.played_at = static_cast<int64_t>((ul.QuadPart / 10000ULL) - 11644473600000ULL);
-
-        console::formatter() << "[foo_monthly_stats] on_item_played: " << ti.title.c_str()
-                             << " by " << ti.artist.c_str()
-                             << " (play count only, duration tracked by on_playback_stop)";
+        FMS_LOG(LogLevel::Debug, LogCategory::Recorder) << "[foo_monthly_stats] on_item_played: " << ti.title
+                                                        << " by " << ti.artist
+                                                        << " (play count only, duration tracked by on_playback_stop)";
 
-        DbManager::get().postPlay(ti);
+        DbManager::get().postPlay(std::move(ti));
     }
 
     // Register static factories
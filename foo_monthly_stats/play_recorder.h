@@ -1,5 +1,6 @@
 #pragma once
 #include "stdafx.h"
+#include "listen_timer.h"
 
 namespace fms
 {
@@ -10,7 +11,10 @@ namespace fms
     //   - 60 seconds have been played, OR
     //   - Track ends and at least 1/3 was played
     //
-    // Also uses play_callback_static to track actual playback time.
+    // Also uses play_callback_static to track actual playback time: a steady
+    // clock (ListenTimer) driven by start/pause/stop transitions. There is no
+    // per-second on_playback_time subscription, and seeks need no handling
+    // because they do not change how long the user has been listening.
 
     // Time tracker for getting actual played time
     class PlaybackTimeTracker : public play_callback_static
@@ -18,16 +22,16 @@ namespace fms
     public:
         unsigned get_flags() override
         {
-            return flag_on_playback_new_track | flag_on_playback_time | flag_on_playback_stop;
+            return flag_on_playback_starting | flag_on_playback_new_track | flag_on_playback_stop | flag_on_playback_pause;
         }
 
+        void on_playback_starting(play_control::t_track_command command, bool paused) override;
         void on_playback_new_track(metadb_handle_ptr track) override;
-        void on_playback_time(double p_time) override;
         void on_playback_stop(play_control::t_stop_reason reason) override;
+        void on_playback_pause(bool paused) override;
 
-        void on_playback_starting(play_control::t_track_command, bool) override {}
         void on_playback_seek(double) override {}
-        void on_playback_pause(bool) override {}
+        void on_playback_time(double) override {}
         void on_playback_edited(metadb_handle_ptr) override {}
         void on_playback_dynamic_info(const file_info &) override {}
         void on_playback_dynamic_info_track(const file_info &) override {}
@@ -38,7 +42,8 @@ namespace fms
 
     private:
         static metadb_handle_ptr s_current_track;
-        static double s_last_playback_time;
+        static ListenTimer s_listen;
+        static bool s_start_paused; // the next new track starts paused
     };
 
     class PlaybackStatsCollector : public playback_statistics_collector
@@ -1,6 +1,9 @@
 #include "stdafx.h"
 #include "preferences.h"
 #include "db_manager.h"
+#include "db_stats.h"
+#include "auto_reporter.h"
+#include "thumbnail_cache.h"
 #include "resource.h"
 
 // ---------------------------------------------------------------------------
@@ -10,6 +13,13 @@ static constexpr GUID guid_cfg_db_path = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb
 static constexpr GUID guid_cfg_art_size = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x06}};
 static constexpr GUID guid_cfg_auto_report = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x07}};
 static constexpr GUID guid_cfg_chrome_path = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x08}};
+static constexpr GUID guid_cfg_log_retention_months = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x09}};
+static constexpr GUID guid_cfg_backup_interval_days = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0a}};
+static constexpr GUID guid_cfg_last_backup = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0b}};
+static constexpr GUID guid_cfg_db_stats = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x0d}};
+static constexpr GUID guid_cfg_session_gap_minutes = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x10}};
+static constexpr GUID guid_cfg_log_level = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x11}};
+static constexpr GUID guid_cfg_last_auto_report = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x12}};
 static constexpr GUID guid_preferences_page = {0xf1a2b3c4, 0xd5e6, 0x4789, {0xa0, 0xb1, 0xc2, 0xd3, 0xe4, 0xf5, 0x00, 0x02}};
 
 namespace fms
@@ -21,7 +31,14 @@ namespace fms
     cfg_var_modern::cfg_string g_cfg_db_path(guid_cfg_db_path, "");
     cfg_var_modern::cfg_int g_cfg_art_size(guid_cfg_art_size, 64);
     cfg_var_modern::cfg_bool g_cfg_auto_report(guid_cfg_auto_report, false);
+    cfg_var_modern::cfg_string g_cfg_last_auto_report(guid_cfg_last_auto_report, "");
     cfg_var_modern::cfg_string g_cfg_chrome_path(guid_cfg_chrome_path, "");
+    cfg_var_modern::cfg_int g_cfg_log_retention_months(guid_cfg_log_retention_months, 0);
+    cfg_var_modern::cfg_int g_cfg_backup_interval_days(guid_cfg_backup_interval_days, 0);
+    cfg_var_modern::cfg_int g_cfg_last_backup(guid_cfg_last_backup, 0);
+    cfg_var_modern::cfg_bool g_cfg_db_stats(guid_cfg_db_stats, false);
+    cfg_var_modern::cfg_int g_cfg_session_gap_minutes(guid_cfg_session_gap_minutes, 30);
+    cfg_var_modern::cfg_int g_cfg_log_level(guid_cfg_log_level, static_cast<int>(LogLevel::Info));
 
     std::string effectiveDbPath()
     {
@@ -35,6 +52,55 @@ namespace fms
         return v.c_str();
     }
 
+    // Directory holding the DB file
+    static std::string dbDirectory()
+    {
+        std::string dbPath = effectiveDbPath();
+        size_t slash = dbPath.find_last_of("\\/");
+        return (slash == std::string::npos) ? std::string(".") : dbPath.substr(0, slash);
+    }
+
+    std::string effectiveBackupDir()
+    {
+        return dbDirectory() + "\\foo_monthly_stats_backup";
+    }
+
+    std::string effectiveDbStatsPath()
+    {
+        return dbDirectory() + "\\foo_monthly_stats_dbstats.json";
+    }
+
+    std::string effectiveThumbCachePath()
+    {
+        return dbDirectory() + "\\foo_monthly_stats_thumbs.db";
+    }
+
+    std::string effectiveReportDir()
+    {
+        return dbDirectory() + "\\foo_monthly_stats_reports";
+    }
+
+    void startBackup()
+    {
+        DbManager::get().postBackup(effectiveBackupDir(), [](bool ok)
+                                    {
+            if (!ok)
+                return;
+            int64_t now = static_cast<int64_t>(time(nullptr));
+            fb2k::inMainThread([now]
+                               { g_cfg_last_backup = now; }); });
+    }
+
+    void startScheduledBackup()
+    {
+        int64_t days = g_cfg_backup_interval_days.get();
+        if (days <= 0)
+            return;
+        int64_t now = static_cast<int64_t>(time(nullptr));
+        if (now - g_cfg_last_backup.get() >= days * 86400)
+            startBackup();
+    }
+
     // ---------------------------------------------------------------------------
     // initquit – lifecycle management
     // ---------------------------------------------------------------------------
@@ -43,15 +109,35 @@ namespace fms
     public:
         void on_init() override
         {
+            // The DB core has no SDK dependency: give it the console and the main thread
+            setLogSink([](const std::string &line)
+                       { console::print(line.c_str()); });
+            setMainThreadDispatcher([](std::function<void()> fn)
+                                    { fb2k::inMainThread(std::move(fn)); });
+            // Console writes are batched on a background thread instead of blocking the caller
+            setLogLevel(static_cast<LogLevel>(g_cfg_log_level.get()));
+            startLogWriter();
+            // Before open() so the schema statements are recorded too
+            DbStats::get().setEnabled(g_cfg_db_stats.get());
+            DbManager::get().setSessionGap(static_cast<int>(g_cfg_session_gap_minutes.get()));
+            ThumbnailCache::get().open(effectiveThumbCachePath());
             auto path = effectiveDbPath();
             if (!DbManager::get().open(path.c_str()))
             {
                 FB2K_console_formatter() << "foo_monthly_stats: Failed to open DB at " << path.c_str();
+                return;
             }
+            // Tiered retention: move raw events past the retention window into the archive
+            DbManager::get().postCompaction(static_cast<int>(g_cfg_log_retention_months.get()));
+            startScheduledBackup();
+            AutoReporter::get().start();
         }
         void on_quit() override
         {
+            AutoReporter::get().stop();
             DbManager::get().close();
+            ThumbnailCache::get().close();
+            stopLogWriter();
         }
     };
     static initquit_factory_t<FmsInitQuit> g_initQuit;
@@ -94,14 +180,35 @@ namespace fms
             const int sizes[] = {32, 64, 128};
             g_cfg_art_size = (idx >= 0 && idx < 3) ? sizes[idx] : 64;
 
-            // Auto report
-            g_cfg_auto_report = (IsDlgButtonChecked(IDC_CHECK_AUTO_REPORT) == BST_CHECKED);
+            // Auto report: switching it on starts counting from the month running now
+            bool autoReport = (IsDlgButtonChecked(IDC_CHECK_AUTO_REPORT) == BST_CHECKED);
+            if (autoReport && !g_cfg_auto_report.get())
+                g_cfg_last_auto_report = "";
+            g_cfg_auto_report = autoReport;
+            AutoReporter::get().check();
 
             // Chrome path
             CString chromePath;
             GetDlgItemText(IDC_EDIT_CHROME_PATH, chromePath);
             g_cfg_chrome_path = pfc::stringcvt::string_utf8_from_os(chromePath);
 
+            // Raw log retention (months)
+            g_cfg_log_retention_months = GetDlgItemInt(IDC_EDIT_RETENTION_MONTHS, nullptr, FALSE);
+            DbManager::get().postCompaction(static_cast<int>(g_cfg_log_retention_months.get()));
+
+            // Scheduled backup interval (days)
+            g_cfg_backup_interval_days = GetDlgItemInt(IDC_EDIT_BACKUP_DAYS, nullptr, FALSE);
+            startScheduledBackup();
+
+            // Listening session gap (rebuilds the sessions table when it changed)
+            g_cfg_session_gap_minutes = (std::max)(1u, GetDlgItemInt(IDC_EDIT_SESSION_GAP, nullptr, FALSE));
+            DbManager::get().setSessionGap(static_cast<int>(g_cfg_session_gap_minutes.get()));
+
+            // Console log level
+            int level = (int)SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_GETCURSEL, 0, 0);
+            g_cfg_log_level = (level >= 0 && level <= static_cast<int>(LogLevel::Debug)) ? level : static_cast<int>(LogLevel::Info);
+            setLogLevel(static_cast<LogLevel>(g_cfg_log_level.get()));
+
             OnChanged();
         }
 
@@ -112,6 +219,10 @@ namespace fms
             SendDlgItemMessage(IDC_COMBO_ART_SIZE, CB_SETCURSEL, idx, 0);
             CheckDlgButton(IDC_CHECK_AUTO_REPORT, BST_UNCHECKED);
             SetDlgItemText(IDC_EDIT_CHROME_PATH, L"");
+            SetDlgItemInt(IDC_EDIT_RETENTION_MONTHS, 0, FALSE);
+            SetDlgItemInt(IDC_EDIT_BACKUP_DAYS, 0, FALSE);
+            SetDlgItemInt(IDC_EDIT_SESSION_GAP, 30, FALSE);
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_SETCURSEL, static_cast<int>(LogLevel::Info), 0);
             OnChanged();
         }
 
@@ -119,7 +230,11 @@ namespace fms
         MSG_WM_INITDIALOG(OnInitDialog)
         COMMAND_HANDLER_EX(IDC_EDIT_DB_PATH, EN_CHANGE, OnChange)
         COMMAND_HANDLER_EX(IDC_EDIT_CHROME_PATH, EN_CHANGE, OnChange)
+        COMMAND_HANDLER_EX(IDC_EDIT_RETENTION_MONTHS, EN_CHANGE, OnChange)
+        COMMAND_HANDLER_EX(IDC_EDIT_BACKUP_DAYS, EN_CHANGE, OnChange)
+        COMMAND_HANDLER_EX(IDC_EDIT_SESSION_GAP, EN_CHANGE, OnChange)
         COMMAND_HANDLER_EX(IDC_COMBO_ART_SIZE, CBN_SELCHANGE, OnChange)
+        COMMAND_HANDLER_EX(IDC_COMBO_LOG_LEVEL, CBN_SELCHANGE, OnChange)
         COMMAND_HANDLER_EX(IDC_CHECK_AUTO_REPORT, BN_CLICKED, OnChange)
         COMMAND_HANDLER_EX(IDC_BTN_BROWSE_DB, BN_CLICKED, OnBrowseDb)
         COMMAND_HANDLER_EX(IDC_BTN_BROWSE_CHROME, BN_CLICKED, OnBrowseChrome)
@@ -150,6 +265,22 @@ namespace fms
             pfc::string8 chromePath = g_cfg_chrome_path.get();
             SetDlgItemText(IDC_EDIT_CHROME_PATH, pfc::stringcvt::string_os_from_utf8(chromePath));
 
+            // Raw log retention
+            SetDlgItemInt(IDC_EDIT_RETENTION_MONTHS, static_cast<UINT>(g_cfg_log_retention_months.get()), FALSE);
+
+            // Scheduled backup
+            SetDlgItemInt(IDC_EDIT_BACKUP_DAYS, static_cast<UINT>(g_cfg_backup_interval_days.get()), FALSE);
+
+            // Listening session gap
+            SetDlgItemInt(IDC_EDIT_SESSION_GAP, static_cast<UINT>(g_cfg_session_gap_minutes.get()), FALSE);
+
+            // Console log level (combo index = LogLevel)
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_ADDSTRING, 0, (LPARAM)L"Errors");
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_ADDSTRING, 0, (LPARAM)L"Warnings");
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_ADDSTRING, 0, (LPARAM)L"Info");
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_ADDSTRING, 0, (LPARAM)L"Debug");
+            SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_SETCURSEL, static_cast<WPARAM>(g_cfg_log_level.get()), 0);
+
             return FALSE;
         }
 
@@ -206,6 +337,14 @@ namespace fms
                 return true;
             if (CString(pfc::stringcvt::string_os_from_utf8(curChrome)) != dlgChrome)
                 return true;
+            if (GetDlgItemInt(IDC_EDIT_RETENTION_MONTHS, nullptr, FALSE) != (UINT)g_cfg_log_retention_months.get())
+                return true;
+            if (GetDlgItemInt(IDC_EDIT_BACKUP_DAYS, nullptr, FALSE) != (UINT)g_cfg_backup_interval_days.get())
+                return true;
+            if (GetDlgItemInt(IDC_EDIT_SESSION_GAP, nullptr, FALSE) != (UINT)g_cfg_session_gap_minutes.get())
+                return true;
+            if ((int)SendDlgItemMessage(IDC_COMBO_LOG_LEVEL, CB_GETCURSEL, 0, 0) != (int)g_cfg_log_level.get())
+                return true;
             return false;
         }
 
@@ -8,11 +8,36 @@ namespace fms
     // Global accessors declared here, defined in preferences.cpp.
 
     extern cfg_var_modern::cfg_string g_cfg_db_path;
-    extern cfg_var_modern::cfg_int g_cfg_art_size; // 32 / 64 / 128
+    extern cfg_var_modern::cfg_int g_cfg_art_size; // 32 / 64 / 128: edge of the report thumbnails
     extern cfg_var_modern::cfg_bool g_cfg_auto_report;
+    extern cfg_var_modern::cfg_string g_cfg_last_auto_report; // "YYYY-MM" reported last by AutoReporter
     extern cfg_var_modern::cfg_string g_cfg_chrome_path;
+    extern cfg_var_modern::cfg_int g_cfg_log_retention_months; // 0 = keep raw play_log forever
+    extern cfg_var_modern::cfg_int g_cfg_backup_interval_days; // 0 = no scheduled backup
+    extern cfg_var_modern::cfg_int g_cfg_last_backup;          // UNIX seconds of the last successful backup
+    extern cfg_var_modern::cfg_bool g_cfg_db_stats;            // record per-statement DB statistics (DbStats)
+    extern cfg_var_modern::cfg_int g_cfg_session_gap_minutes;  // silence that starts a new listening session
+    extern cfg_var_modern::cfg_int g_cfg_log_level;            // LogLevel: 0 = errors ... 3 = debug
 
     // Returns the effective DB path (default = profile dir / foo_monthly_stats.db)
     std::string effectiveDbPath();
 
+    // Backup destination: "foo_monthly_stats_backup" next to the DB file
+    std::string effectiveBackupDir();
+
+    // DB statistics dump: "foo_monthly_stats_dbstats.json" next to the DB file
+    std::string effectiveDbStatsPath();
+
+    // Report thumbnail cache: "foo_monthly_stats_thumbs.db" next to the DB file
+    std::string effectiveThumbCachePath();
+
+    // Auto report destination: "foo_monthly_stats_reports" next to the DB file
+    std::string effectiveReportDir();
+
+    // Start an online backup of all database files (returns immediately)
+    void startBackup();
+
+    // Start a backup if the scheduled interval has elapsed since the last one
+    void startScheduledBackup();
+
 } // namespace fms
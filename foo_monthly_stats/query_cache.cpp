@@ -0,0 +1,97 @@
+#include "core.h"
+#include "query_cache.h"
+
+namespace fms
+{
+
+    QueryCache::ResultSet QueryCache::lookup(const std::string &key, uint64_t &generation)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        generation = m_generation;
+        auto it = m_index.find(key);
+        if (it == m_index.end())
+            return nullptr;
+        if (!isValid(*it->second))
+        {
+            m_lru.erase(it->second);
+            m_index.erase(it);
+            return nullptr;
+        }
+        m_lru.splice(m_lru.begin(), m_lru, it->second);
+        return it->second->rows;
+    }
+
+    void QueryCache::store(const std::string &key, const std::string &firstYmd, const std::string &lastYmd,
+                           ResultSet rows, uint64_t generation)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        Entry e{key, firstYmd, lastYmd, std::move(rows), generation};
+        if (!isValid(e))
+            return; // written while the query ran
+
+        auto it = m_index.find(key);
+        if (it != m_index.end())
+        {
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+        m_lru.push_front(std::move(e));
+        m_index[key] = m_lru.begin();
+        while (m_lru.size() > m_capacity)
+        {
+            m_index.erase(m_lru.back().key);
+            m_lru.pop_back();
+        }
+    }
+
+    void QueryCache::markWritten(const std::string &firstYmd, const std::string &lastYmd)
+    {
+        static const int daysInMonth[] = {0, 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+        int y = 0, m = 0, d = 0;
+        if (sscanf(firstYmd.c_str(), "%4d-%2d-%2d", &y, &m, &d) != 3)
+            return;
+
+        std::lock_guard<std::mutex> lk(m_mutex);
+        ++m_generation;
+        char ymd[11];
+        for (;;)
+        {
+            snprintf(ymd, sizeof(ymd), "%04d-%02d-%02d", y, m, d);
+            if (lastYmd.compare(ymd) < 0)
+                break;
+            m_dayGeneration[ymd] = m_generation;
+
+            int leap = (m == 2 && ((y % 4 == 0 && y % 100 != 0) || (y % 400 == 0))) ? 1 : 0;
+            if (++d > daysInMonth[m] + leap)
+            {
+                d = 1;
+                if (++m > 12)
+                {
+                    m = 1;
+                    ++y;
+                }
+            }
+        }
+    }
+
+    void QueryCache::invalidateAll()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        m_epoch = ++m_generation;
+        m_lru.clear();
+        m_index.clear();
+    }
+
+    bool QueryCache::isValid(const Entry &e) const
+    {
+        if (e.generation < m_epoch)
+            return false;
+        for (auto it = m_dayGeneration.lower_bound(e.firstYmd); it != m_dayGeneration.end() && it->first <= e.lastYmd; ++it)
+        {
+            if (it->second > e.generation)
+                return false;
+        }
+        return true;
+    }
+
+} // namespace fms
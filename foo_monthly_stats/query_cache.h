@@ -0,0 +1,59 @@
+#pragma once
+#include "core.h"
+#include "db_manager.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // QueryCache – LRU of period query results, invalidated per day
+    //
+    // Every write records a generation number for the days it touched. A cached
+    // result remembers the generation it was read at and the [first, last] ymd
+    // range it depends on (the period plus its previous period for the delta
+    // column); it stays valid while no day in that range was written since.
+    // -----------------------------------------------------------------------
+    class QueryCache
+    {
+    public:
+        using ResultSet = std::shared_ptr<const std::vector<MonthlyEntry>>;
+
+        explicit QueryCache(size_t capacity = 32) : m_capacity(capacity) {}
+
+        // Returns the cached rows for key, or null. generation receives the value to
+        // pass to store() when the caller runs the query itself.
+        ResultSet lookup(const std::string &key, uint64_t &generation);
+
+        // Stores rows read at generation; dropped if a day in [firstYmd, lastYmd]
+        // was written after that generation.
+        void store(const std::string &key, const std::string &firstYmd, const std::string &lastYmd,
+                   ResultSet rows, uint64_t generation);
+
+        // A write touched every day in [firstYmd, lastYmd] (inclusive, "YYYY-MM-DD")
+        void markWritten(const std::string &firstYmd, const std::string &lastYmd);
+
+        // A write may have touched any day
+        void invalidateAll();
+
+    private:
+        struct Entry
+        {
+            std::string key;
+            std::string firstYmd;
+            std::string lastYmd;
+            ResultSet rows;
+            uint64_t generation;
+        };
+
+        bool isValid(const Entry &e) const; // m_mutex held
+
+        size_t m_capacity;
+        std::list<Entry> m_lru; // most recently used first
+        std::unordered_map<std::string, std::list<Entry>::iterator> m_index;
+        std::map<std::string, uint64_t> m_dayGeneration; // ymd -> generation of its last write
+        uint64_t m_generation{0};
+        uint64_t m_epoch{0}; // entries older than this are invalid (invalidateAll)
+        std::mutex m_mutex;
+    };
+
+} // namespace fms
@@ -1,386 +1,116 @@
-#include "stdafx.h"
+#include "core.h"
 #include "report_exporter.h"
-#include "preferences.h"
+#include "html_writer.h"
 
 namespace fms
 {
 
-    // ---------------------------------------------------------------------------
-    // Base64 encoder (for embedding album art as data URIs)
-    // ---------------------------------------------------------------------------
-    static std::string base64_encode(const void *raw, size_t len)
-    {
-        static const char kB64[] =
-            "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-        const auto *d = static_cast<const uint8_t *>(raw);
-        std::string out;
-        out.reserve(((len + 2) / 3) * 4);
-        for (size_t i = 0; i < len;)
-        {
-            uint32_t v = 0;
-            int n = 0;
-            while (i < len && n < 3)
-            {
-                v = (v << 8) | d[i++];
-                ++n;
-            }
-            v <<= (3 - n) * 8;
-            out += kB64[(v >> 18) & 63];
-            out += kB64[(v >> 12) & 63];
-            out += (n >= 2 ? kB64[(v >> 6) & 63] : '=');
-            out += (n >= 3 ? kB64[(v) & 63] : '=');
-        }
-        return out;
-    }
-
-    // ---------------------------------------------------------------------------
-    // Helper: trim whitespace from C-string
-    // ---------------------------------------------------------------------------
-    static std::string trimString(const char *str)
-    {
-        if (!str)
-            return "";
-        std::string s(str);
-        // Trim leading whitespace
-        size_t start = s.find_first_not_of(" \t\r\n");
-        if (start == std::string::npos)
-            return "";
-        // Trim trailing whitespace
-        size_t end = s.find_last_not_of(" \t\r\n");
-        return s.substr(start, end - start + 1);
-    }
-
-    // ---------------------------------------------------------------------------
-    // Helper: case-insensitive string comparison
-    // ---------------------------------------------------------------------------
-    static bool caseInsensitiveMatch(const std::string &a, const std::string &b)
+    namespace
     {
-        if (a.size() != b.size())
-            return false;
-        for (size_t i = 0; i < a.size(); ++i)
+        // ---------------------------------------------------------------------------
+        // Album art table: each distinct cover is written once
+        //
+        // Tracks of one album (and the artist cards that reuse them) share a data
+        // URI. Instead of repeating it in every <img src>, images carry data-art,
+        // the index of their cover in a table that a script at the end of <body>
+        // assigns to them while the page is parsed, so before the load event.
+        // ---------------------------------------------------------------------------
+        class ArtTable
         {
-            if (tolower(static_cast<unsigned char>(a[i])) !=
-                tolower(static_cast<unsigned char>(b[i])))
-                return false;
-        }
-        return true;
-    }
+        public:
+            explicit ArtTable(const std::map<std::string, std::string> &artMap) : m_artMap(artMap) {}
 
-    // ---------------------------------------------------------------------------
-    // Helper: check if file path exists using filesystem
-    // ---------------------------------------------------------------------------
-    static bool filePathExists(const char *path)
-    {
-        try
-        {
-            abort_callback_dummy abort;
-            auto fs = filesystem::get(path);
-            if (fs.is_valid())
+            // Table index of the track's cover; -1 when it has none
+            int index(const std::string &trackCrc)
             {
-                return fs->file_exists(path, abort);
+                auto it = m_artMap.find(trackCrc);
+                if (it == m_artMap.end())
+                    return -1;
+                auto [slot, added] = m_index.emplace(it->second, static_cast<int>(m_uris.size()));
+                if (added)
+                    m_uris.push_back(&it->second);
+                return slot->second;
             }
-        }
-        catch (...)
-        {
-        }
-        return false;
-    }
-
-    // ---------------------------------------------------------------------------
-    // Album art collection (must be called on main thread)
-    // ---------------------------------------------------------------------------
-    std::map<std::string, std::string> ReportExporter::collectArt(
-        const std::vector<MonthlyEntry> &entries)
-    {
-        std::map<std::string, std::string> artMap;
-        try
-        {
-            auto aam = album_art_manager_v2::get();
-            auto lib = library_manager::get();
-            abort_callback_dummy abort;
 
-            // Pre-fetch all library items once for efficiency
-            metadb_handle_list allItems;
-            try
-            {
-                lib->get_all_items(allItems);
-                console::printf("[fms] Album art: loaded %u items from library", (unsigned)allItems.get_count());
-            }
-            catch (const std::exception &ex)
+            // index() as data-art; "" when the track has no cover
+            std::string find(const std::string &trackCrc)
             {
-                console::printf("[fms] Failed to load library items: %s", ex.what());
+                const int i = index(trackCrc);
+                return i < 0 ? std::string() : std::to_string(i);
             }
 
-            for (const auto &e : entries)
+            // The table as a JSON array (Paged format)
+            void writeJson(HtmlWriter &w) const
             {
-                metadb_handle_ptr h;
-
-                // Step 1: Try to create handle from stored path, but verify file exists
-                if (!e.path.empty())
+                w.raw("[");
+                for (size_t i = 0; i < m_uris.size(); ++i)
                 {
-                    // Check if path looks like a file:// URL and validate existence
-                    bool pathIsValid = false;
-                    try
-                    {
-                        // Verify the file actually exists before using this path
-                        if (filePathExists(e.path.c_str()))
-                        {
-                            h = metadb::get()->handle_create(e.path.c_str(), 0);
-                            console::printf("[fms] Using path handle for: %s", e.path.c_str());
-                            pathIsValid = true;
-                        }
-                        else
-                        {
-                            console::printf("[fms] Path file does not exist: %s", e.path.c_str());
-                        }
-                    }
-                    catch (const std::exception &ex)
-                    {
-                        console::printf("[fms] Path validation failed: %s (path: %s)", ex.what(), e.path.c_str());
-                    }
-                    catch (...)
-                    {
-                        console::printf("[fms] Path validation failed (unknown exception): %s", e.path.c_str());
-                    }
-
-                    if (!pathIsValid)
-                    {
-                        h = nullptr;
-                    }
-                }
-
-                // Step 2: If path failed or file doesn't exist, search library by metadata
-                if (!h.is_valid())
-                {
-                    console::printf("[fms] Searching library for: '%s' - '%s' - '%s'",
-                                    e.title.c_str(), e.artist.c_str(), e.album.c_str());
-
-                    std::string searchTitle = trimString(e.title.c_str());
-                    std::string searchArtist = trimString(e.artist.c_str());
-                    std::string searchAlbum = trimString(e.album.c_str());
-
-                    // First pass: exact match with trimmed strings
-                    for (t_size i = 0; i < allItems.get_count(); ++i)
-                    {
-                        metadb_handle_ptr item = allItems[i];
-                        file_info_impl fi;
-                        if (!item->get_info(fi))
-                            continue;
-
-                        std::string itemTitle = trimString(fi.meta_get("TITLE", 0));
-                        std::string itemArtist = trimString(fi.meta_get("ARTIST", 0));
-                        std::string itemAlbum = trimString(fi.meta_get("ALBUM", 0));
-
-                        if (itemTitle == searchTitle &&
-                            itemArtist == searchArtist &&
-                            itemAlbum == searchAlbum)
-                        {
-                            h = item;
-                            console::printf("[fms] Found exact match in library: %s", item->get_path());
-                            break;
-                        }
-                    }
-
-                    // Second pass: case-insensitive match if exact match failed
-                    if (!h.is_valid())
-                    {
-                        for (t_size i = 0; i < allItems.get_count(); ++i)
-                        {
-                            metadb_handle_ptr item = allItems[i];
-                            file_info_impl fi;
-                            if (!item->get_info(fi))
-                                continue;
-
-                            std::string itemTitle = trimString(fi.meta_get("TITLE", 0));
-                            std::string itemArtist = trimString(fi.meta_get("ARTIST", 0));
-                            std::string itemAlbum = trimString(fi.meta_get("ALBUM", 0));
-
-                            if (caseInsensitiveMatch(itemTitle, searchTitle) &&
-                                caseInsensitiveMatch(itemArtist, searchArtist) &&
-                                caseInsensitiveMatch(itemAlbum, searchAlbum))
-                            {
-                                h = item;
-                                console::printf("[fms] Found case-insensitive match in library: %s", item->get_path());
-                                break;
-                            }
-                        }
-                    }
-
-                    if (!h.is_valid())
-                    {
-                        console::printf("[fms] Track not found in library after metadata search");
-                        continue;
-                    }
+                    w.raw(i ? ",\n" : "\n");
+                    w.jsonString(*m_uris[i]);
                 }
+                w.raw("]");
+            }
 
-                // Step 3: Now we have a valid handle, try to get album art
-                bool artObtained = false;
-                std::string failureReason;
-
-                try
-                {
-                    metadb_handle_list handles;
-                    handles.add_item(h);
-                    pfc::list_single_ref_t<GUID> types(album_art_ids::cover_front);
-                    auto inst = aam->open(handles, types, abort);
-
-                    if (inst.is_valid())
-                    {
-                        album_art_data_ptr data = inst->query(album_art_ids::cover_front, abort);
-                        if (data.is_valid() && data->get_size() > 0)
-                        {
-                            // Successfully got album art
-                            std::string dataUri = "data:image/jpeg;base64," +
-                                                  base64_encode(data->get_ptr(), data->get_size());
-                            artMap[e.track_crc] = dataUri;
-                            console::printf("[fms] Got album art for: %s (%u bytes)", e.title.c_str(), (unsigned)data->get_size());
-                            artObtained = true;
-                        }
-                        else
-                        {
-                            failureReason = "No album art data";
-                            console::printf("[fms] No album art data for: %s", e.title.c_str());
-                        }
-                    }
-                    else
-                    {
-                        failureReason = "Failed to open album art instance";
-                        console::printf("[fms] Failed to open album art instance for: %s", e.title.c_str());
-                    }
-                }
-                catch (const std::exception &ex)
-                {
-                    failureReason = ex.what();
-                    console::printf("[fms] Exception getting art for %s: %s", e.title.c_str(), ex.what());
-                }
-                catch (...)
+            void write(HtmlWriter &w) const
+            {
+                if (m_uris.empty())
+                    return;
+                w.open("script");
+                w.raw("\n(function() {\n    var art = [\n");
+                for (const std::string *uri : m_uris)
                 {
-                    failureReason = "Unknown exception";
-                    console::printf("[fms] Unknown exception getting art for: %s", e.title.c_str());
+                    w.raw("        \"");
+                    w.raw(*uri);
+                    w.raw("\",\n");
                 }
+                w.raw("    ];\n"
+                      "    var images = document.querySelectorAll('img[data-art]');\n"
+                      "    for (var i = 0; i < images.length; i++)\n"
+                      "        images[i].src = art[+images[i].getAttribute('data-art')];\n"
+                      "})();\n");
+                w.close();
+            }
 
-                // Step 4: If art not obtained, try fallback search for alternative versions of the same track
-                if (!artObtained && !e.title.empty() && !e.artist.empty())
-                {
-                    console::printf("[fms] Attempting fallback search for alternative versions: '%s' by '%s'",
-                                    e.title.c_str(), e.artist.c_str());
-
-                    std::string searchTitle = trimString(e.title.c_str());
-                    std::string searchArtist = trimString(e.artist.c_str());
-
-                    // Search for alternative tracks with same title and artist (possibly different album)
-                    for (t_size i = 0; i < allItems.get_count() && !artObtained; ++i)
-                    {
-                        metadb_handle_ptr altItem = allItems[i];
-                        file_info_impl fi;
-                        if (!altItem->get_info(fi))
-                            continue;
-
-                        std::string itemTitle = trimString(fi.meta_get("TITLE", 0));
-                        std::string itemArtist = trimString(fi.meta_get("ARTIST", 0));
+        private:
+            const std::map<std::string, std::string> &m_artMap;
+            std::unordered_map<std::string, int> m_index; // data URI -> table index
+            std::vector<const std::string *> m_uris;
+        };
 
-                        // Match on title and artist only, ignore album
-                        if (itemTitle == searchTitle && itemArtist == searchArtist)
-                        {
-                            try
-                            {
-                                metadb_handle_list handles;
-                                handles.add_item(altItem);
-                                pfc::list_single_ref_t<GUID> types(album_art_ids::cover_front);
-                                auto inst = aam->open(handles, types, abort);
-
-                                if (inst.is_valid())
-                                {
-                                    album_art_data_ptr data = inst->query(album_art_ids::cover_front, abort);
-                                    if (data.is_valid() && data->get_size() > 0)
-                                    {
-                                        // Got album art from alternative track
-                                        std::string dataUri = "data:image/jpeg;base64," +
-                                                              base64_encode(data->get_ptr(), data->get_size());
-                                        artMap[e.track_crc] = dataUri;
-                                        console::printf("[fms] Got album art from fallback (alt album): %s (%u bytes)",
-                                                        e.title.c_str(), (unsigned)data->get_size());
-                                        artObtained = true;
-                                    }
-                                }
-                            }
-                            catch (...)
-                            {
-                                // Ignore errors and continue searching
-                            }
-                        }
-                    }
+        // <!DOCTYPE>, <html> and the <head> up to the embedded CSS; <head> stays open
+        void openDocument(HtmlWriter &w, const std::string &periodLabel, const char *viewport)
+        {
+            w.doctype();
+            w.open("html", {{"lang", "ja"}});
 
-                    if (!artObtained)
-                    {
-                        console::printf("[fms] Fallback search failed to find album art for: %s", e.title.c_str());
-                    }
-                }
-            }
+            // <head>
+            w.open("head");
+            w.empty("meta", {{"charset", "UTF-8"}});
+            w.empty("meta", {{"name", "viewport"}, {"content", viewport}});
+            w.element("title", {}, periodLabel);
 
-            console::printf("[fms] Album art collection complete. Found %u of %u covers.", (unsigned)artMap.size(), (unsigned)entries.size());
-        }
-        catch (const std::exception &ex)
-        {
-            console::printf("[fms] Exception in collectArt: %s", ex.what());
-        }
-        catch (...)
-        {
-            console::print("[fms] Unknown exception in collectArt");
+            // Google Fonts (Inter)
+            w.empty("link", {{"rel", "preconnect"}, {"href", "https://fonts.googleapis.com"}});
+            w.empty("link", {{"rel", "preconnect"}, {"href", "https://fonts.gstatic.com"}, {"crossorigin", ""}});
+            w.empty("link", {{"rel", "stylesheet"},
+                             {"href", "https://fonts.googleapis.com/css2?family=Inter:wght@400;500;600;700&display=swap"}});
         }
-        return artMap;
-    }
 
-    // Smartphone HTML generation (1080x1980px fixed canvas)
-    // Must be called before the main exportHtml function
-    namespace
-    {
+        // Smartphone HTML generation (1080x1980px fixed canvas)
+        // Must be called before the main exportHtml function
         std::string GenerateSmartphoneHtml(
             const std::string &periodLabel,
             const std::vector<MonthlyEntry> &entries,
             const std::wstring &htmlPath,
             const std::map<std::string, std::string> &artMap)
         {
-            pugi::xml_document doc;
-
-            // DOCTYPE
-            doc.append_child(pugi::node_doctype).set_value("html");
-
-            auto html = doc.append_child("html");
-            html.append_attribute("lang") = "ja";
-
-            // <head>
-            auto head = html.append_child("head");
-            head.append_child("meta").append_attribute("charset") = "UTF-8";
-            {
-                auto meta = head.append_child("meta");
-                meta.append_attribute("name") = "viewport";
-                meta.append_attribute("content") = "width=1080, initial-scale=1, maximum-scale=1, user-scalable=no";
-            }
-            head.append_child("title").text().set(periodLabel.c_str());
+            ArtTable arts(artMap);
+            HtmlWriter w{std::filesystem::path(htmlPath)};
 
-            // Google Fonts (Inter)
-            {
-                auto link = head.append_child("link");
-                link.append_attribute("rel") = "preconnect";
-                link.append_attribute("href") = "https://fonts.googleapis.com";
-            }
-            {
-                auto link = head.append_child("link");
-                link.append_attribute("rel") = "preconnect";
-                link.append_attribute("href") = "https://fonts.gstatic.com";
-                link.append_attribute("crossorigin") = "";
-            }
-            {
-                auto link = head.append_child("link");
-                link.append_attribute("rel") = "stylesheet";
-                link.append_attribute("href") =
-                    "https://fonts.googleapis.com/css2?family=Inter:wght@400;500;600;700&display=swap";
-            }
+            openDocument(w, periodLabel, "width=1080, initial-scale=1, maximum-scale=1, user-scalable=no");
 
             // Embedded CSS for smartphone
-            auto style = head.append_child("style");
-            style.text().set(R"CSS(
+            w.rawElement("style", R"CSS(
 * { margin: 0; padding: 0; box-sizing: border-box; }
 html, body {
     width: 1080px;
@@ -666,17 +396,14 @@ h1 {
     font-size: 12px;
 }
 )CSS");
+            w.close(); // head
 
             // <body>
-            auto body = html.append_child("body");
-            auto container = body.append_child("div");
-            container.append_attribute("class") = "container";
+            w.open("body");
+            w.open("div", {{"class", "container"}});
 
             // Title
-            {
-                auto h1 = container.append_child("h1");
-                h1.text().set(periodLabel.c_str());
-            }
+            w.element("h1", {}, periodLabel);
 
             // Calculate statistics
             int64_t totalPlaycount = 0;
@@ -719,81 +446,49 @@ h1 {
 
             // Statistics cards
             {
-                auto statsContainer = container.append_child("div");
-                statsContainer.append_attribute("class") = "stats-container";
+                w.open("div", {{"class", "stats-container"}});
 
                 // Total plays card
-                {
-                    auto card = statsContainer.append_child("div");
-                    card.append_attribute("class") = "stat-card";
-
-                    auto label = card.append_child("div");
-                    label.append_attribute("class") = "stat-label";
-                    label.text().set("Total Plays");
-
-                    auto value = card.append_child("div");
-                    value.append_attribute("class") = "stat-value";
-                    value.text().set(std::to_string(totalPlaycount).c_str());
-                }
+                w.open("div", {{"class", "stat-card"}});
+                w.element("div", {{"class", "stat-label"}}, "Total Plays");
+                w.element("div", {{"class", "stat-value"}}, std::to_string(totalPlaycount));
+                w.close();
 
                 // Total listening time card
                 {
-                    auto card = statsContainer.append_child("div");
-                    card.append_attribute("class") = "stat-card";
-
-                    auto label = card.append_child("div");
-                    label.append_attribute("class") = "stat-label";
-                    label.text().set("Total Time");
-
                     int hours = static_cast<int>(totalSeconds / 3600);
                     int minutes = static_cast<int>((totalSeconds - hours * 3600) / 60);
 
-                    auto value = card.append_child("div");
-                    value.append_attribute("class") = "stat-value";
-                    std::string timeText = std::to_string(hours) + "h " + std::to_string(minutes) + "m";
-                    value.text().set(timeText.c_str());
-
-                    auto subtext = card.append_child("div");
-                    subtext.append_attribute("class") = "stat-subtext";
-                    std::string subtextStr = std::to_string(static_cast<long long>(totalSeconds)) + " seconds";
-                    subtext.text().set(subtextStr.c_str());
+                    w.open("div", {{"class", "stat-card"}});
+                    w.element("div", {{"class", "stat-label"}}, "Total Time");
+                    w.element("div", {{"class", "stat-value"}}, std::to_string(hours) + "h " + std::to_string(minutes) + "m");
+                    w.element("div", {{"class", "stat-subtext"}},
+                              std::to_string(static_cast<long long>(totalSeconds)) + " seconds");
+                    w.close();
                 }
+
+                w.close(); // stats-container
             }
 
             // Top Artist Section (highlighted)
             if (!topArtist.empty())
             {
-                auto topArtistDiv = container.append_child("div");
-                topArtistDiv.append_attribute("class") = "top-artist-section";
-
-                auto sectionLabel = topArtistDiv.append_child("div");
-                sectionLabel.append_attribute("class") = "section-label";
-                sectionLabel.text().set("Most Played Artist");
-
-                auto artistName = topArtistDiv.append_child("div");
-                artistName.append_attribute("class") = "top-artist-name";
-                artistName.text().set(topArtist.c_str());
-
-                auto artistInfo = topArtistDiv.append_child("div");
-                artistInfo.append_attribute("class") = "top-artist-info";
-                std::string infoText = std::to_string(topArtistPlays) + " plays";
-                artistInfo.text().set(infoText.c_str());
+                w.open("div", {{"class", "top-artist-section"}});
+                w.element("div", {{"class", "section-label"}}, "Most Played Artist");
+                w.element("div", {{"class", "top-artist-name"}}, topArtist);
+                w.element("div", {{"class", "top-artist-info"}}, std::to_string(topArtistPlays) + " plays");
 
                 // Album art
-                auto it = artMap.find(topArtistCrc);
-                if (it != artMap.end())
+                const std::string art = arts.find(topArtistCrc);
+                if (!art.empty())
                 {
-                    auto img = topArtistDiv.append_child("img");
-                    img.append_attribute("class") = "top-artist-art";
-                    img.append_attribute("src") = it->second.c_str();
-                    img.append_attribute("alt") = topArtist.c_str();
+                    w.empty("img", {{"class", "top-artist-art"}, {"data-art", art}, {"alt", topArtist}});
                 }
                 else
                 {
-                    auto placeholder = topArtistDiv.append_child("div");
-                    placeholder.append_attribute("class") = "top-artist-art";
-                    placeholder.append_attribute("style") = "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);";
+                    w.element("div", {{"class", "top-artist-art"}, {"style", "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);"}}, "");
                 }
+                w.close();
             }
 
             // Artist Ranking (Top 5)
@@ -832,14 +527,9 @@ h1 {
                 // Display top 5 artists
                 if (!artistVec.empty())
                 {
-                    auto rankingDiv = container.append_child("div");
-                    rankingDiv.append_attribute("class") = "artist-ranking";
-
-                    auto h2 = rankingDiv.append_child("h2");
-                    h2.text().set("Top 5 Artists");
-
-                    auto artistList = rankingDiv.append_child("div");
-                    artistList.append_attribute("class") = "artist-list";
+                    w.open("div", {{"class", "artist-ranking"}});
+                    w.element("h2", {}, "Top 5 Artists");
+                    w.open("div", {{"class", "artist-list"}});
 
                     int count = 0;
                     for (const auto &[artist, info] : artistVec)
@@ -847,43 +537,32 @@ h1 {
                         if (++count > 5)
                             break;
 
-                        auto item = artistList.append_child("div");
-                        item.append_attribute("class") = "artist-item";
+                        w.open("div", {{"class", "artist-item"}});
 
                         // Rank badge
-                        auto rankBadge = item.append_child("div");
-                        rankBadge.append_attribute("class") = "artist-rank";
-                        rankBadge.text().set(("#" + std::to_string(count)).c_str());
+                        w.element("div", {{"class", "artist-rank"}}, "#" + std::to_string(count));
 
                         // Album art
-                        auto it = artMap.find(info.topTrackCrc);
-                        if (it != artMap.end())
+                        const std::string art = arts.find(info.topTrackCrc);
+                        if (!art.empty())
                         {
-                            auto img = item.append_child("img");
-                            img.append_attribute("class") = "artist-avatar";
-                            img.append_attribute("src") = it->second.c_str();
-                            img.append_attribute("alt") = artist.c_str();
-                            img.append_attribute("loading") = "lazy";
+                            w.empty("img", {{"class", "artist-avatar"}, {"data-art", art}, {"alt", artist}, {"loading", "lazy"}});
                         }
                         else
                         {
-                            auto placeholder = item.append_child("div");
-                            placeholder.append_attribute("class") = "artist-avatar";
-                            placeholder.append_attribute("style") = "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);";
+                            w.element("div", {{"class", "artist-avatar"}, {"style", "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);"}}, "");
                         }
 
-                        auto info_div = item.append_child("div");
-                        info_div.append_attribute("class") = "artist-info";
+                        w.open("div", {{"class", "artist-info"}});
+                        w.element("div", {{"class", "artist-name"}}, artist);
+                        w.element("div", {{"class", "artist-plays"}}, std::to_string(info.totalPlays) + " plays");
+                        w.close();
 
-                        auto nameDiv = info_div.append_child("div");
-                        nameDiv.append_attribute("class") = "artist-name";
-                        nameDiv.text().set(artist.c_str());
-
-                        auto playsDiv = info_div.append_child("div");
-                        playsDiv.append_attribute("class") = "artist-plays";
-                        std::string playsText = std::to_string(info.totalPlays) + " plays";
-                        playsDiv.text().set(playsText.c_str());
+                        w.close(); // artist-item
                     }
+
+                    w.close(); // artist-list
+                    w.close(); // artist-ranking
                 }
             }
 
@@ -894,11 +573,8 @@ h1 {
                           [](const auto &a, const auto &b)
                           { return a.playcount > b.playcount; });
 
-                auto tracksDiv = container.append_child("div");
-                tracksDiv.append_attribute("class") = "tracks-section";
-
-                auto h2 = tracksDiv.append_child("h2");
-                h2.text().set("Top Tracks");
+                w.open("div", {{"class", "tracks-section"}});
+                w.element("h2", {}, "Top Tracks");
 
                 int rank = 1;
                 for (const auto &e : sortedEntries)
@@ -906,130 +582,376 @@ h1 {
                     if (rank > 10)
                         break;
 
-                    auto item = tracksDiv.append_child("div");
-                    item.append_attribute("class") = "track-item";
+                    w.open("div", {{"class", "track-item"}});
 
                     // Rank badge
-                    auto rankBadge = item.append_child("div");
-                    rankBadge.append_attribute("class") = "track-rank";
-                    rankBadge.text().set(("#" + std::to_string(rank)).c_str());
+                    w.element("div", {{"class", "track-rank"}}, "#" + std::to_string(rank));
 
                     // Album art
-                    auto it = artMap.find(e.track_crc);
-                    if (it != artMap.end())
+                    const std::string art = arts.find(e.track_crc);
+                    if (!art.empty())
                     {
-                        auto img = item.append_child("img");
-                        img.append_attribute("class") = "track-art";
-                        img.append_attribute("src") = it->second.c_str();
-                        img.append_attribute("alt") = e.album.c_str();
-                        img.append_attribute("loading") = "lazy";
+                        w.empty("img", {{"class", "track-art"}, {"data-art", art}, {"alt", e.album}, {"loading", "lazy"}});
                     }
                     else
                     {
-                        auto placeholder = item.append_child("div");
-                        placeholder.append_attribute("class") = "track-art";
-                        placeholder.append_attribute("style") = "background: linear-gradient(135deg, #f5f7fa 0%, #c3cfe2 100%);";
+                        w.element("div", {{"class", "track-art"}, {"style", "background: linear-gradient(135deg, #f5f7fa 0%, #c3cfe2 100%);"}}, "");
                     }
 
                     // Track info
-                    auto info = item.append_child("div");
-                    info.append_attribute("class") = "track-info";
+                    w.open("div", {{"class", "track-info"}});
+                    w.element("div", {{"class", "track-title"}}, e.title);
+                    w.element("div", {{"class", "track-artist"}}, e.artist);
+                    w.element("div", {{"class", "track-album"}}, e.album);
+                    w.element("div", {{"class", "track-stats"}}, std::to_string(e.playcount) + " plays");
+                    w.close();
+
+                    w.close(); // track-item
+                    rank++;
+                }
 
-                    auto title = info.append_child("div");
-                    title.append_attribute("class") = "track-title";
-                    title.text().set(e.title.c_str());
+                w.close(); // tracks-section
+            }
 
-                    auto artist = info.append_child("div");
-                    artist.append_attribute("class") = "track-artist";
-                    artist.text().set(e.artist.c_str());
+            // Footer
+            w.element("div", {{"class", "footer"}}, "Generated by foo_monthly_stats");
+            w.close(); // container
 
-                    auto album = info.append_child("div");
-                    album.append_attribute("class") = "track-album";
-                    album.text().set(e.album.c_str());
+            arts.write(w);
 
-                    auto stats = info.append_child("div");
-                    stats.append_attribute("class") = "track-stats";
-                    std::string playsText = std::to_string(e.playcount) + " plays";
-                    stats.text().set(playsText.c_str());
+            if (!w.finish())
+                return "Failed to write smartphone HTML file: " + std::filesystem::path(htmlPath).u8string();
+            return "";
+        }
 
-                    rank++;
+        // Paged HTML generation: a JSON table of every track plus a renderer that
+        // builds only the rows in view. The document stays small whatever the row
+        // count, and covers are decoded only when their row scrolls into view.
+        std::string GeneratePagedHtml(
+            const std::string &periodLabel,
+            const std::vector<MonthlyEntry> &entries,
+            const std::wstring &htmlPath,
+            const std::map<std::string, std::string> &artMap)
+        {
+            ArtTable arts(artMap);
+            HtmlWriter w{std::filesystem::path(htmlPath)};
+
+            openDocument(w, periodLabel, "width=device-width, initial-scale=1");
+
+            // Embedded CSS
+            w.rawElement("style", R"CSS(
+* { margin: 0; padding: 0; box-sizing: border-box; }
+body {
+    font-family: 'Inter', -apple-system, BlinkMacSystemFont, 'Segoe UI', sans-serif;
+    background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);
+    background-attachment: fixed;
+    padding: 2rem 1.5rem;
+    color: #1a1a1a;
+}
+.container {
+    max-width: 1100px;
+    margin: 0 auto;
+}
+h1 {
+    font-size: 2.5rem;
+    font-weight: 700;
+    color: white;
+    text-align: center;
+    text-shadow: 0 2px 4px rgba(0,0,0,0.2);
+}
+.summary {
+    text-align: center;
+    margin: 1.5rem 0;
+    font-size: 1.1rem;
+    color: rgba(255,255,255,0.9);
+}
+.artists {
+    display: flex;
+    gap: 1rem;
+    overflow-x: auto;
+    padding: 1rem;
+    margin-bottom: 1.5rem;
+    background: rgba(255,255,255,0.12);
+    border-radius: 16px;
+}
+.artist {
+    flex: 0 0 110px;
+    text-align: center;
+    color: white;
+    font-size: 0.8rem;
+}
+.artist .art {
+    width: 90px;
+    height: 90px;
+    margin: 0 auto 0.5rem;
+    border-radius: 50%;
+}
+.artist-name {
+    font-weight: 600;
+    overflow: hidden;
+    text-overflow: ellipsis;
+    white-space: nowrap;
+}
+.tracks {
+    position: relative;
+    background: white;
+    border-radius: 12px;
+    box-shadow: 0 4px 12px rgba(0,0,0,0.15);
+    overflow: hidden;
+}
+.row {
+    position: absolute;
+    left: 0;
+    right: 0;
+    height: 64px;
+    display: flex;
+    align-items: center;
+    gap: 12px;
+    padding: 0 12px;
+    border-bottom: 1px solid #eee;
+}
+.rank {
+    width: 3.5rem;
+    font-weight: 700;
+    color: #667eea;
+    text-align: right;
+}
+.art {
+    width: 48px;
+    height: 48px;
+    flex-shrink: 0;
+    border-radius: 6px;
+    object-fit: cover;
+    background: linear-gradient(135deg, #f5f7fa 0%, #c3cfe2 100%);
+}
+.text {
+    flex: 1;
+    min-width: 0;
+}
+.title, .sub {
+    overflow: hidden;
+    text-overflow: ellipsis;
+    white-space: nowrap;
+}
+.title {
+    font-weight: 600;
+}
+.sub {
+    font-size: 0.85rem;
+    color: #666;
+}
+.plays {
+    width: 6rem;
+    text-align: right;
+    font-weight: 600;
+    color: #667eea;
+}
+.delta {
+    width: 4rem;
+    text-align: right;
+    font-size: 0.85rem;
+}
+.delta.positive {
+    color: #155724;
+}
+.delta.negative {
+    color: #721c24;
+}
+)CSS");
+            w.close(); // head
+
+            // <body>
+            w.open("body");
+            w.open("div", {{"class", "container"}});
+            w.element("h1", {}, periodLabel);
+
+            // Aggregate plays by artist and track their most played song
+            struct ArtistInfo
+            {
+                int64_t totalPlays = 0;
+                std::string topTrackCrc;
+                int64_t topTrackPlays = 0;
+            };
+            std::map<std::string, ArtistInfo> artistMap;
+            double totalSeconds = 0.0;
+            for (const auto &e : entries)
+            {
+                totalSeconds += e.total_time_seconds;
+                auto &info = artistMap[e.artist];
+                info.totalPlays += e.playcount;
+                if (e.playcount > info.topTrackPlays)
+                {
+                    info.topTrackPlays = e.playcount;
+                    info.topTrackCrc = e.track_crc;
                 }
             }
-
-            // Footer
             {
-                auto footer = container.append_child("div");
-                footer.append_attribute("class") = "footer";
-                footer.text().set("Generated by foo_monthly_stats");
+                int hours = static_cast<int>(totalSeconds / 3600);
+                int minutes = static_cast<int>((totalSeconds - hours * 3600) / 60);
+                w.element("div", {{"class", "summary"}},
+                          std::to_string(entries.size()) + " tracks \xc2\xb7 Total Listening Time: " +
+                              std::to_string(hours) + "h " + std::to_string(minutes) + "m");
+            }
+            w.element("div", {{"class", "artists"}, {"id", "artists"}}, "");
+            w.element("div", {{"class", "tracks"}, {"id", "tracks"}}, "");
+            w.element("div", {{"class", "summary"}}, "Generated by foo_monthly_stats");
+            w.close(); // container
+
+            // Data: one array per track, in the order of entries
+            w.open("script", {{"type", "application/json"}, {"id", "report-data"}});
+            w.raw("\n{\"rows\": [");
+            for (size_t i = 0; i < entries.size(); ++i)
+            {
+                const auto &e = entries[i];
+                w.raw(i ? ",\n[" : "\n[");
+                w.jsonString(e.title);
+                w.raw(",");
+                w.jsonString(e.artist);
+                w.raw(",");
+                w.jsonString(e.album);
+                w.raw("," + std::to_string(e.playcount) + "," + std::to_string(e.playcount - e.prev_playcount) + "," +
+                      std::to_string(arts.index(e.track_crc)) + "]");
             }
 
-            // Save file
-            bool ok = doc.save_file(htmlPath.c_str(), "  ", pugi::format_default | pugi::format_write_bom, pugi::encoding_utf8);
-            if (!ok)
+            // Top 10 artists: [name, plays, art]
+            std::vector<std::pair<std::string, ArtistInfo>> artistVec(artistMap.begin(), artistMap.end());
+            std::sort(artistVec.begin(), artistVec.end(),
+                      [](const auto &a, const auto &b)
+                      { return a.second.totalPlays > b.second.totalPlays; });
+            if (artistVec.size() > 10)
+                artistVec.resize(10);
+            w.raw("],\n\"artists\": [");
+            for (size_t i = 0; i < artistVec.size(); ++i)
             {
-                std::string errPath = pfc::stringcvt::string_utf8_from_wide(htmlPath.c_str());
-                return "Failed to write smartphone HTML file: " + errPath;
+                w.raw(i ? ",\n[" : "\n[");
+                w.jsonString(artistVec[i].first);
+                w.raw("," + std::to_string(artistVec[i].second.totalPlays) + "," +
+                      std::to_string(arts.index(artistVec[i].second.topTrackCrc)) + "]");
             }
+            w.raw("],\n\"art\": ");
+            arts.writeJson(w);
+            w.raw("}\n");
+            w.close(); // script
+
+            // Renderer: fixed-height rows, only those near the viewport are in the DOM
+            w.rawElement("script", R"JS(
+(function() {
+    var data = JSON.parse(document.getElementById('report-data').textContent);
+    var ROW = 64, OVERSCAN = 8;
+    var list = document.getElementById('tracks');
+    var rows = data.rows;
+    var shown = {};
+
+    function div(cls, text) {
+        var el = document.createElement('div');
+        el.className = cls;
+        if (text !== undefined)
+            el.textContent = text;
+        return el;
+    }
+    function art(index, alt) {
+        if (index < 0)
+            return div('art');
+        var img = document.createElement('img');
+        img.className = 'art';
+        img.alt = alt;
+        img.src = data.art[index];
+        return img;
+    }
+    function row(i) {
+        var r = rows[i];
+        var el = div('row');
+        el.style.top = (i * ROW) + 'px';
+        el.appendChild(div('rank', '#' + (i + 1)));
+        el.appendChild(art(r[5], r[2]));
+        var text = div('text');
+        text.appendChild(div('title', r[0]));
+        text.appendChild(div('sub', r[1] + (r[2] ? ' — ' + r[2] : '')));
+        el.appendChild(text);
+        el.appendChild(div('plays', '▶ ' + r[3] + ' plays'));
+        el.appendChild(div(r[4] >= 0 ? 'delta positive' : 'delta negative', (r[4] >= 0 ? '+' : '') + r[4]));
+        return el;
+    }
+    function render() {
+        var top = list.getBoundingClientRect().top;
+        var first = Math.max(0, Math.floor(-top / ROW) - OVERSCAN);
+        var last = Math.min(rows.length, Math.ceil((window.innerHeight - top) / ROW) + OVERSCAN);
+        for (var key in shown) {
+            var i = +key;
+            if (i < first || i >= last) {
+                list.removeChild(shown[key]);
+                delete shown[key];
+            }
+        }
+        for (var j = first; j < last; j++) {
+            if (!shown[j]) {
+                shown[j] = row(j);
+                list.appendChild(shown[j]);
+            }
+        }
+    }
+    var queued = false;
+    function schedule() {
+        if (queued)
+            return;
+        queued = true;
+        window.requestAnimationFrame(function() {
+            queued = false;
+            render();
+        });
+    }
+
+    var artists = document.getElementById('artists');
+    data.artists.forEach(function(a) {
+        var el = div('artist');
+        el.appendChild(art(a[2], a[0]));
+        el.appendChild(div('artist-name', a[0]));
+        el.appendChild(div('artist-plays', a[1] + ' plays'));
+        artists.appendChild(el);
+    });
+    if (!data.artists.length)
+        artists.style.display = 'none';
+
+    list.style.height = (rows.length * ROW) + 'px';
+    window.addEventListener('scroll', schedule, {passive: true});
+    window.addEventListener('resize', schedule);
+    render();
+})();
+)JS");
+
+            if (!w.finish())
+                return "Failed to write paged HTML file: " + std::filesystem::path(htmlPath).u8string();
             return "";
         }
     } // anonymous namespace
 
     // ---------------------------------------------------------------------------
-    // HTML generation using pugixml (Desktop version)
+    // HTML generation (Desktop version), streamed to the file by HtmlWriter
     // ---------------------------------------------------------------------------
     std::string ReportExporter::exportHtml(
         const std::string &periodLabel,
         const std::vector<MonthlyEntry> &entries,
         const std::wstring &htmlPath,
         const std::map<std::string, std::string> &artMap,
-        bool isSmartphone)
+        ReportFormat format)
     {
-        // For smartphone format, use a separate implementation
-        if (isSmartphone)
+        // Smartphone and paged formats have their own implementations
+        if (format == ReportFormat::Smartphone)
         {
             return GenerateSmartphoneHtml(periodLabel, entries, htmlPath, artMap);
         }
-
-        pugi::xml_document doc;
-
-        // DOCTYPE
-        doc.append_child(pugi::node_doctype).set_value("html");
-
-        auto html = doc.append_child("html");
-        html.append_attribute("lang") = "ja";
-
-        // <head>
-        auto head = html.append_child("head");
-        head.append_child("meta").append_attribute("charset") = "UTF-8";
+        if (format == ReportFormat::Paged)
         {
-            auto meta = head.append_child("meta");
-            meta.append_attribute("name") = "viewport";
-            meta.append_attribute("content") = "width=1280, initial-scale=1";
+            return GeneratePagedHtml(periodLabel, entries, htmlPath, artMap);
         }
-        head.append_child("title").text().set(periodLabel.c_str());
 
-        // Google Fonts (Inter)
-        {
-            auto link = head.append_child("link");
-            link.append_attribute("rel") = "preconnect";
-            link.append_attribute("href") = "https://fonts.googleapis.com";
-        }
-        {
-            auto link = head.append_child("link");
-            link.append_attribute("rel") = "preconnect";
-            link.append_attribute("href") = "https://fonts.gstatic.com";
-            link.append_attribute("crossorigin") = "";
-        }
-        {
-            auto link = head.append_child("link");
-            link.append_attribute("rel") = "stylesheet";
-            link.append_attribute("href") =
-                "https://fonts.googleapis.com/css2?family=Inter:wght@400;500;600;700&display=swap";
-        }
+        ArtTable arts(artMap);
+        HtmlWriter w{std::filesystem::path(htmlPath)};
+
+        openDocument(w, periodLabel, "width=1280, initial-scale=1");
 
         // Embedded CSS
-        auto style = head.append_child("style");
-        style.text().set(R"CSS(
+        w.rawElement("style", R"CSS(
 * { margin: 0; padding: 0; box-sizing: border-box; }
 body {
     font-family: 'Inter', -apple-system, BlinkMacSystemFont, 'Segoe UI', sans-serif;
@@ -1216,8 +1138,7 @@ h1 {
 )CSS");
 
         // JavaScript to detect page height for full-page screenshot
-        auto script = head.append_child("script");
-        script.text().set(R"JS(
+        w.rawElement("script", R"JS(
 window.addEventListener('load', function() {
     // Wait for all images to load
     var images = document.getElementsByTagName('img');
@@ -1262,17 +1183,14 @@ window.addEventListener('load', function() {
     }
 });
 )JS");
+        w.close(); // head
 
         // <body>
-        auto body = html.append_child("body");
-        auto container = body.append_child("div");
-        container.append_attribute("class") = "container";
+        w.open("body");
+        w.open("div", {{"class", "container"}});
 
         // Title
-        {
-            auto h1 = container.append_child("h1");
-            h1.text().set(periodLabel.c_str());
-        }
+        w.element("h1", {}, periodLabel);
 
         // Total playback time
         {
@@ -1286,11 +1204,8 @@ window.addEventListener('load', function() {
             int minutes = static_cast<int>((totalSeconds - hours * 3600) / 60);
             int seconds = static_cast<int>(totalSeconds - hours * 3600 - minutes * 60);
 
-            auto stats = container.append_child("div");
-            stats.append_attribute("style") = "text-align: center; margin: 1.5rem 0; font-size: 1.1rem; color: rgba(255,255,255,0.9);";
-
             std::string timeText = "Total Listening Time: " + std::to_string(hours) + "h " + std::to_string(minutes) + "m " + std::to_string(seconds) + "s";
-            stats.text().set(timeText.c_str());
+            w.element("div", {{"style", "text-align: center; margin: 1.5rem 0; font-size: 1.1rem; color: rgba(255,255,255,0.9);"}}, timeText);
         }
 
         // Artist Ranking (Top 10)
@@ -1330,17 +1245,13 @@ window.addEventListener('load', function() {
             // Display top 10 artists
             if (!artistVec.empty())
             {
-                auto rankingDiv = container.append_child("div");
-                rankingDiv.append_attribute("class") = "artist-ranking";
-
-                auto h2 = rankingDiv.append_child("h2");
-                h2.text().set("Top Artists");
+                w.open("div", {{"class", "artist-ranking"}});
+                w.element("h2", {}, "Top Artists");
 
                 // Use table for reliable single-row horizontal layout
-                auto table = rankingDiv.append_child("table");
-                table.append_attribute("class") = "artist-table";
-                auto tbody = table.append_child("tbody");
-                auto tr = tbody.append_child("tr");
+                w.open("table", {{"class", "artist-table"}});
+                w.open("tbody");
+                w.open("tr");
 
                 int count = 0;
                 for (const auto &[artist, info] : artistVec)
@@ -1348,266 +1259,208 @@ window.addEventListener('load', function() {
                     if (++count > 10)
                         break;
 
-                    auto td = tr.append_child("td");
-                    td.append_attribute("class") = "artist-cell";
+                    w.open("td", {{"class", "artist-cell"}});
 
                     // Album art (circular avatar)
-                    auto it = artMap.find(info.topTrackCrc);
-                    if (it != artMap.end())
+                    const std::string art = arts.find(info.topTrackCrc);
+                    if (!art.empty())
                     {
-                        auto img = td.append_child("img");
-                        img.append_attribute("class") = "artist-avatar";
-                        img.append_attribute("src") = it->second.c_str();
-                        img.append_attribute("alt") = artist.c_str();
-                        img.append_attribute("loading") = "lazy";
+                        w.empty("img", {{"class", "artist-avatar"}, {"data-art", art}, {"alt", artist}, {"loading", "lazy"}});
                     }
                     else
                     {
-                        auto placeholder = td.append_child("div");
-                        placeholder.append_attribute("class") = "artist-avatar";
-                        placeholder.append_attribute("style") = "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);";
+                        w.element("div", {{"class", "artist-avatar"}, {"style", "background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);"}}, "");
                     }
 
-                    auto nameDiv = td.append_child("div");
-                    nameDiv.append_attribute("class") = "artist-name";
-                    nameDiv.text().set(artist.c_str());
+                    w.element("div", {{"class", "artist-name"}}, artist);
+                    w.element("div", {{"class", "artist-plays"}}, std::to_string(info.totalPlays) + " plays");
 
-                    auto playsDiv = td.append_child("div");
-                    playsDiv.append_attribute("class") = "artist-plays";
-                    std::string playsText = std::to_string(info.totalPlays) + " plays";
-                    playsDiv.text().set(playsText.c_str());
+                    w.close(); // td
                 }
+
+                w.close(); // tr
+                w.close(); // tbody
+                w.close(); // table
+                w.close(); // artist-ranking
             }
         }
 
         // Grid
-        auto grid = container.append_child("div");
-        grid.append_attribute("class") = "grid";
+        w.open("div", {{"class", "grid"}});
 
         int rank = 1;
         for (const auto &e : entries)
         {
             // Card
-            auto card = grid.append_child("div");
-            card.append_attribute("class") = "card";
+            w.open("div", {{"class", "card"}});
 
             // Art container
-            auto artContainer = card.append_child("div");
-            artContainer.append_attribute("class") = "art-container";
+            w.open("div", {{"class", "art-container"}});
 
             // Album art image
-            auto it = artMap.find(e.track_crc);
-            if (it != artMap.end())
+            const std::string art = arts.find(e.track_crc);
+            if (!art.empty())
             {
-                auto img = artContainer.append_child("img");
-                img.append_attribute("class") = "art-img";
-                img.append_attribute("src") = it->second.c_str();
-                img.append_attribute("alt") = e.album.c_str();
-                img.append_attribute("loading") = "lazy";
+                w.empty("img", {{"class", "art-img"}, {"data-art", art}, {"alt", e.album}, {"loading", "lazy"}});
             }
 
             // Rank badge
-            auto badge = artContainer.append_child("div");
-            badge.append_attribute("class") = "rank-badge";
-            badge.text().set(std::to_string(rank++).c_str());
+            w.element("div", {{"class", "rank-badge"}}, std::to_string(rank++));
+            w.close(); // art-container
 
             // Info section
-            auto info = card.append_child("div");
-            info.append_attribute("class") = "info";
-
-            // Title
-            auto title = info.append_child("div");
-            title.append_attribute("class") = "title";
-            title.text().set(e.title.c_str());
-
-            // Artist
-            auto artist = info.append_child("div");
-            artist.append_attribute("class") = "artist";
-            artist.text().set(e.artist.c_str());
-
-            // Album
-            auto album = info.append_child("div");
-            album.append_attribute("class") = "album";
-            album.text().set(e.album.c_str());
+            w.open("div", {{"class", "info"}});
+            w.element("div", {{"class", "title"}}, e.title);
+            w.element("div", {{"class", "artist"}}, e.artist);
+            w.element("div", {{"class", "album"}}, e.album);
 
             // Stats section
-            auto stats = info.append_child("div");
-            stats.append_attribute("class") = "stats";
+            w.open("div", {{"class", "stats"}});
 
             // Plays
-            auto plays = stats.append_child("div");
-            plays.append_attribute("class") = "plays";
-            std::string playsText = "\xe2\x96\xb6 " + std::to_string(e.playcount) + " plays";
-            plays.text().set(playsText.c_str());
+            w.element("div", {{"class", "plays"}}, "\xe2\x96\xb6 " + std::to_string(e.playcount) + " plays");
 
             // Delta
             int64_t delta = e.playcount - e.prev_playcount;
             std::string deltaStr = (delta >= 0 ? "+" : "") + std::to_string(delta);
-            auto deltaDiv = stats.append_child("div");
-            std::string deltaClass = delta >= 0 ? "delta positive" : "delta negative";
-            deltaDiv.append_attribute("class") = deltaClass.c_str();
-            deltaDiv.text().set(deltaStr.c_str());
-        }
+            w.element("div", {{"class", delta >= 0 ? "delta positive" : "delta negative"}}, deltaStr);
 
-        // Save via pugixml's save_file (use wide string to avoid encoding issues)
-        bool ok = doc.save_file(htmlPath.c_str(), "  ", pugi::format_default | pugi::format_write_bom, pugi::encoding_utf8);
-        if (!ok)
-        {
-            std::string errPath = pfc::stringcvt::string_utf8_from_wide(htmlPath.c_str());
-            return "Failed to write HTML file: " + errPath;
+            w.close(); // stats
+            w.close(); // info
+            w.close(); // card
         }
+
+        w.close(); // grid
+        w.close(); // container
+
+        arts.write(w);
+
+        if (!w.finish())
+            return "Failed to write HTML file: " + std::filesystem::path(htmlPath).u8string();
         return "";
     }
 
     // ---------------------------------------------------------------------------
-    // PNG via chrome-headless
+    // Batch export: the reports are independent files, so each worker takes the
+    // next one until none are left; the art map is only read
     // ---------------------------------------------------------------------------
-    int ReportExporter::getPageHeight(
-        const std::string &chromePath,
-        const std::wstring &htmlPath)
+    std::string ReportExporter::exportBatch(
+        const std::string &title,
+        const std::vector<BatchReport> &reports,
+        const std::wstring &indexPath,
+        const std::map<std::string, std::string> &artMap,
+        ReportFormat format)
     {
-        if (chromePath.empty())
-            return 10000; // Default fallback height
-
-        std::wstring fileUrl = L"file:///";
-        {
-            std::wstring fwd = htmlPath;
-            for (auto &c : fwd)
-                if (c == L'\\')
-                    c = L'/';
-            fileUrl += fwd;
-        }
+        const std::filesystem::path dir = std::filesystem::path(indexPath).parent_path();
 
-        std::wstring wChrome = pfc::stringcvt::string_wide_from_utf8(chromePath.c_str());
-
-        // Use --dump-dom to get HTML with updated title containing height
-        std::wstring tempOut = htmlPath + L".dump";
-        std::wstring wCmd = L"\"" + wChrome + L"\""
-                                              L" --headless --disable-gpu"
-                                              L" --dump-dom"
-                                              L" --virtual-time-budget=10000"
-                                              L" --run-all-compositor-stages-before-draw"
-                                              L" \"" +
-                            fileUrl + L"\" > \"" + tempOut + L"\"";
-
-        STARTUPINFOW si{};
-        si.cb = sizeof(si);
-        si.dwFlags = STARTF_USESHOWWINDOW;
-        si.wShowWindow = SW_HIDE;
-        PROCESS_INFORMATION pi{};
-
-        // Use cmd.exe to handle output redirection
-        std::wstring cmdLine = L"cmd.exe /C \"" + wCmd + L"\"";
-        if (!CreateProcessW(nullptr, &cmdLine[0], nullptr, nullptr, FALSE,
-                            CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
+        std::atomic<size_t> next{0};
+        std::mutex errorMutex;
+        std::string firstError;
+        auto work = [&]
         {
-            return 10000; // Fallback on error
-        }
-
-        WaitForSingleObject(pi.hProcess, 30000);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-
-        // Read dumped HTML and extract height from title
-        int height = 10000; // Default
-        HANDLE hFile = CreateFileW(tempOut.c_str(), GENERIC_READ, FILE_SHARE_READ,
-                                   nullptr, OPEN_EXISTING, 0, nullptr);
-        if (hFile != INVALID_HANDLE_VALUE)
-        {
-            DWORD fileSize = GetFileSize(hFile, nullptr);
-            if (fileSize > 0 && fileSize < 50 * 1024 * 1024) // Max 50MB
+            for (size_t i = next++; i < reports.size(); i = next++)
             {
-                std::vector<char> buffer(fileSize + 1);
-                DWORD bytesRead = 0;
-                if (ReadFile(hFile, buffer.data(), fileSize, &bytesRead, nullptr))
+                const BatchReport &r = reports[i];
+                std::string err = exportHtml(r.label, r.entries,
+                                             (dir / std::filesystem::u8path(r.fileName)).wstring(), artMap, format);
+                if (!err.empty())
                 {
-                    buffer[bytesRead] = '\0';
-                    std::string html(buffer.data());
-
-                    // Extract height from <title>HEIGHT:12345</title>
-                    size_t pos = html.find("<title>HEIGHT:");
-                    if (pos != std::string::npos)
-                    {
-                        pos += 14; // Length of "<title>HEIGHT:"
-                        size_t endPos = html.find("</title>", pos);
-                        if (endPos != std::string::npos)
-                        {
-                            std::string heightStr = html.substr(pos, endPos - pos);
-                            try
-                            {
-                                int parsedHeight = std::stoi(heightStr);
-                                if (parsedHeight > 0 && parsedHeight < 50000)
-                                {
-                                    height = parsedHeight + 50; // Add small padding
-                                }
-                            }
-                            catch (...)
-                            {
-                                // Keep default
-                            }
-                        }
-                    }
+                    std::lock_guard<std::mutex> lock(errorMutex);
+                    if (firstError.empty())
+                        firstError = std::move(err);
                 }
             }
-            CloseHandle(hFile);
-            DeleteFileW(tempOut.c_str()); // Clean up temp file
-        }
-
-        return height;
-    }
-
-    std::string ReportExporter::exportPng(
-        const std::string &chromePath,
-        const std::wstring &htmlPath,
-        const std::wstring &pngPath)
-    {
-        if (chromePath.empty())
-            return "chrome-headless.exe path is not configured in Preferences.";
-
-        // Get actual page height dynamically
-        int pageHeight = getPageHeight(chromePath, htmlPath);
+        };
+
+        const size_t threads = (std::min)(reports.size(), (std::max)(size_t(1), size_t(std::thread::hardware_concurrency())));
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; ++t)
+            pool.emplace_back(work);
+        work();
+        for (auto &t : pool)
+            t.join();
+        if (!firstError.empty())
+            return firstError;
+
+        // Index page
+        HtmlWriter w{std::filesystem::path(indexPath)};
+        openDocument(w, title, "width=device-width, initial-scale=1");
+        w.rawElement("style", R"CSS(
+* { margin: 0; padding: 0; box-sizing: border-box; }
+body {
+    font-family: 'Inter', -apple-system, BlinkMacSystemFont, 'Segoe UI', sans-serif;
+    background: linear-gradient(135deg, #667eea 0%, #764ba2 100%);
+    background-attachment: fixed;
+    padding: 2rem 1.5rem;
+    color: #1a1a1a;
+}
+.container {
+    max-width: 640px;
+    margin: 0 auto;
+}
+h1 {
+    font-size: 2.5rem;
+    font-weight: 700;
+    color: white;
+    text-align: center;
+    text-shadow: 0 2px 4px rgba(0,0,0,0.2);
+    margin-bottom: 1.5rem;
+}
+.report {
+    display: flex;
+    align-items: center;
+    gap: 1rem;
+    background: white;
+    border-radius: 12px;
+    padding: 1rem 1.25rem;
+    margin-bottom: 0.75rem;
+    box-shadow: 0 4px 12px rgba(0,0,0,0.15);
+    color: inherit;
+    text-decoration: none;
+}
+.report:hover {
+    box-shadow: 0 8px 20px rgba(0,0,0,0.25);
+}
+.label {
+    flex: 1;
+    font-weight: 600;
+}
+.detail {
+    font-size: 0.85rem;
+    color: #666;
+}
+.summary {
+    text-align: center;
+    color: rgba(255,255,255,0.8);
+    font-size: 0.85rem;
+    margin-top: 1.5rem;
+}
+)CSS");
+        w.close(); // head
 
-        // 3508px width (A4 landscape @ 300dpi), dynamic height for full page capture
-        std::wstring fileUrl = L"file:///";
+        w.open("body");
+        w.open("div", {{"class", "container"}});
+        w.element("h1", {}, title);
+        for (const auto &r : reports)
         {
-            // Convert backslashes
-            std::wstring fwd = htmlPath;
-            for (auto &c : fwd)
-                if (c == L'\\')
-                    c = L'/';
-            fileUrl += fwd;
-        }
+            double totalSeconds = 0.0;
+            for (const auto &e : r.entries)
+                totalSeconds += e.total_time_seconds;
+            int hours = static_cast<int>(totalSeconds / 3600);
+            int minutes = static_cast<int>((totalSeconds - hours * 3600) / 60);
 
-        std::wstring wChrome = pfc::stringcvt::string_wide_from_utf8(chromePath.c_str());
-        std::wstring windowSize = L"--window-size=3508," + std::to_wstring(pageHeight);
-        std::wstring wCmd = L"\"" + wChrome + L"\""
-                                              L" --headless --disable-gpu"
-                                              L" --run-all-compositor-stages-before-draw"
-                                              L" --virtual-time-budget=10000"
-                                              L" --screenshot=\"" +
-                            pngPath + L"\""
-                                      L" " +
-                            windowSize +
-                            L" \"" + fileUrl + L"\"";
-
-        STARTUPINFOW si{};
-        si.cb = sizeof(si);
-        PROCESS_INFORMATION pi{};
-        if (!CreateProcessW(nullptr, &wCmd[0], nullptr, nullptr, FALSE,
-                            CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
-        {
-            DWORD err = GetLastError();
-            return "CreateProcess failed (error " + std::to_string(err) + ")";
+            w.open("a", {{"class", "report"}, {"href", r.fileName}});
+            w.element("span", {{"class", "label"}}, r.label);
+            w.element("span", {{"class", "detail"}},
+                      std::to_string(r.entries.size()) + " tracks \xc2\xb7 " + std::to_string(hours) + "h " +
+                          std::to_string(minutes) + "m");
+            w.close(); // a
         }
+        w.element("div", {{"class", "summary"}}, "Generated by foo_monthly_stats");
+        w.close(); // container
 
-        WaitForSingleObject(pi.hProcess, 120000); // wait up to 120 s for large pages
-        DWORD exitCode = 0;
-        GetExitCodeProcess(pi.hProcess, &exitCode);
-        CloseHandle(pi.hProcess);
-        CloseHandle(pi.hThread);
-
-        if (exitCode != 0)
-            return "chrome-headless exited with code " + std::to_string(exitCode);
+        if (!w.finish())
+            return "Failed to write index HTML file: " + std::filesystem::path(indexPath).u8string();
         return "";
     }
 
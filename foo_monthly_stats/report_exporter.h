@@ -1,5 +1,5 @@
 #pragma once
-#include "stdafx.h"
+#include "core.h"
 #include "db_manager.h"
 
 namespace fms
@@ -9,25 +9,44 @@ namespace fms
     // Generates an HTML report (with Bootstrap 5) from monthly data,
     // and optionally a PNG screenshot using chrome-headless.exe.
 
+    enum class ReportFormat
+    {
+        Desktop,    // every track as a card
+        Smartphone, // 1080x1980px canvas: top 5 artists, top 10 tracks
+        Paged,      // tracks as a JSON table, rendered on scroll (large years)
+    };
+
+    // One report of a batch export
+    struct BatchReport
+    {
+        std::string label;    // page title, e.g. "2025-07"
+        std::string fileName; // UTF-8, written next to the index page
+        std::vector<MonthlyEntry> entries;
+    };
+
     class ReportExporter
     {
     public:
-        // Collect album art for each entry via foobar2000's album_art_manager_v2.
-        // Returns a map of track_crc -> "data:image/jpeg;base64,..." string.
-        // Must be called on the main (UI) thread.
-        static std::map<std::string, std::string> collectArt(
-            const std::vector<MonthlyEntry> &entries);
-
         // Export HTML to the given path and optionally create PNG via Chrome headless.
-        // artMap: optional map of track_crc -> base64 JPEG data URI for album art thumbnails.
-        // isSmartphone: if true, generates a 1080x1980px smartphone-optimized HTML (Top 5 artists, Top 10 tracks)
+        // artMap: optional map of track_crc -> base64 data URI for album art thumbnails
+        // (collected by ArtCollector); each distinct URI is written to the HTML once.
         // Returns an empty string on success, or an error message on failure.
         static std::string exportHtml(
             const std::string &periodLabel,
             const std::vector<MonthlyEntry> &entries,
             const std::wstring &htmlPath,
             const std::map<std::string, std::string> &artMap = {},
-            bool isSmartphone = false);
+            ReportFormat format = ReportFormat::Desktop);
+
+        // Export several reports that share one artMap (e.g. every month of a year
+        // plus the year itself) on worker threads, then an index page at indexPath
+        // linking them. Returns the first error, or an empty string on success.
+        static std::string exportBatch(
+            const std::string &title,
+            const std::vector<BatchReport> &reports,
+            const std::wstring &indexPath,
+            const std::map<std::string, std::string> &artMap = {},
+            ReportFormat format = ReportFormat::Desktop);
 
         // Launch chrome-headless.exe to convert htmlPath → pngPath.
         // chromePath: full path to chrome-headless.exe (may be empty = return error string)
@@ -0,0 +1,164 @@
+#include "stdafx.h"
+#include "report_exporter.h"
+#include "preferences.h"
+
+namespace fms
+{
+
+    // ReportExporter parts bound to Win32: Chrome headless. HTML generation
+    // (report_exporter.cpp) has no such dependency; album art is collected by
+    // ArtCollector (art_collector.cpp).
+
+    // ---------------------------------------------------------------------------
+    // PNG via chrome-headless
+    // ---------------------------------------------------------------------------
+    int ReportExporter::getPageHeight(
+        const std::string &chromePath,
+        const std::wstring &htmlPath)
+    {
+        if (chromePath.empty())
+            return 10000; // Default fallback height
+
+        std::wstring fileUrl = L"file:///";
+        {
+            std::wstring fwd = htmlPath;
+            for (auto &c : fwd)
+                if (c == L'\\')
+                    c = L'/';
+            fileUrl += fwd;
+        }
+
+        std::wstring wChrome = pfc::stringcvt::string_wide_from_utf8(chromePath.c_str());
+
+        // Use --dump-dom to get HTML with updated title containing height
+        std::wstring tempOut = htmlPath + L".dump";
+        std::wstring wCmd = L"\"" + wChrome + L"\""
+                                              L" --headless --disable-gpu"
+                                              L" --dump-dom"
+                                              L" --virtual-time-budget=10000"
+                                              L" --run-all-compositor-stages-before-draw"
+                                              L" \"" +
+                            fileUrl + L"\" > \"" + tempOut + L"\"";
+
+        STARTUPINFOW si{};
+        si.cb = sizeof(si);
+        si.dwFlags = STARTF_USESHOWWINDOW;
+        si.wShowWindow = SW_HIDE;
+        PROCESS_INFORMATION pi{};
+
+        // Use cmd.exe to handle output redirection
+        std::wstring cmdLine = L"cmd.exe /C \"" + wCmd + L"\"";
+        if (!CreateProcessW(nullptr, &cmdLine[0], nullptr, nullptr, FALSE,
+                            CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
+        {
+            return 10000; // Fallback on error
+        }
+
+        WaitForSingleObject(pi.hProcess, 30000);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+
+        // Read dumped HTML and extract height from title
+        int height = 10000; // Default
+        HANDLE hFile = CreateFileW(tempOut.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                   nullptr, OPEN_EXISTING, 0, nullptr);
+        if (hFile != INVALID_HANDLE_VALUE)
+        {
+            DWORD fileSize = GetFileSize(hFile, nullptr);
+            if (fileSize > 0 && fileSize < 50 * 1024 * 1024) // Max 50MB
+            {
+                std::vector<char> buffer(fileSize + 1);
+                DWORD bytesRead = 0;
+                if (ReadFile(hFile, buffer.data(), fileSize, &bytesRead, nullptr))
+                {
+                    buffer[bytesRead] = '\0';
+                    std::string html(buffer.data());
+
+                    // Extract height from <title>HEIGHT:12345</title>
+                    size_t pos = html.find("<title>HEIGHT:");
+                    if (pos != std::string::npos)
+                    {
+                        pos += 14; // Length of "<title>HEIGHT:"
+                        size_t endPos = html.find("</title>", pos);
+                        if (endPos != std::string::npos)
+                        {
+                            std::string heightStr = html.substr(pos, endPos - pos);
+                            try
+                            {
+                                int parsedHeight = std::stoi(heightStr);
+                                if (parsedHeight > 0 && parsedHeight < 50000)
+                                {
+                                    height = parsedHeight + 50; // Add small padding
+                                }
+                            }
+                            catch (...)
+                            {
+                                // Keep default
+                            }
+                        }
+                    }
+                }
+            }
+            CloseHandle(hFile);
+            DeleteFileW(tempOut.c_str()); // Clean up temp file
+        }
+
+        return height;
+    }
+
+    std::string ReportExporter::exportPng(
+        const std::string &chromePath,
+        const std::wstring &htmlPath,
+        const std::wstring &pngPath)
+    {
+        if (chromePath.empty())
+            return "chrome-headless.exe path is not configured in Preferences.";
+
+        // Get actual page height dynamically
+        int pageHeight = getPageHeight(chromePath, htmlPath);
+
+        // 3508px width (A4 landscape @ 300dpi), dynamic height for full page capture
+        std::wstring fileUrl = L"file:///";
+        {
+            // Convert backslashes
+            std::wstring fwd = htmlPath;
+            for (auto &c : fwd)
+                if (c == L'\\')
+                    c = L'/';
+            fileUrl += fwd;
+        }
+
+        std::wstring wChrome = pfc::stringcvt::string_wide_from_utf8(chromePath.c_str());
+        std::wstring windowSize = L"--window-size=3508," + std::to_wstring(pageHeight);
+        std::wstring wCmd = L"\"" + wChrome + L"\""
+                                              L" --headless --disable-gpu"
+                                              L" --run-all-compositor-stages-before-draw"
+                                              L" --virtual-time-budget=10000"
+                                              L" --screenshot=\"" +
+                            pngPath + L"\""
+                                      L" " +
+                            windowSize +
+                            L" \"" + fileUrl + L"\"";
+
+        STARTUPINFOW si{};
+        si.cb = sizeof(si);
+        PROCESS_INFORMATION pi{};
+        if (!CreateProcessW(nullptr, &wCmd[0], nullptr, nullptr, FALSE,
+                            CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi))
+        {
+            DWORD err = GetLastError();
+            return "CreateProcess failed (error " + std::to_string(err) + ")";
+        }
+
+        WaitForSingleObject(pi.hProcess, 120000); // wait up to 120 s for large pages
+        DWORD exitCode = 0;
+        GetExitCodeProcess(pi.hProcess, &exitCode);
+        CloseHandle(pi.hProcess);
+        CloseHandle(pi.hThread);
+
+        if (exitCode != 0)
+            return "chrome-headless exited with code " + std::to_string(exitCode);
+        return "";
+    }
+
+} // namespace fms
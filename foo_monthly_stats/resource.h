@@ -17,6 +17,8 @@
 #define IDC_BTN_MODE_TOGGLE 1009
 #define IDC_BTN_DELETE 1010
 #define IDC_BTN_EXPORT_FORMAT 1011
+#define IDC_EDIT_FILTER 1012
+#define IDC_BTN_EXPORT_YEAR 1013
 
 // Preferences controls
 #define IDC_EDIT_DB_PATH 2001
@@ -28,6 +30,14 @@
 #define IDC_STATIC_DB_PATH_LABEL 2007
 #define IDC_STATIC_ART_SIZE_LABEL 2008
 #define IDC_STATIC_CHROME_LABEL 2009
+#define IDC_STATIC_RETENTION_LABEL 2010
+#define IDC_EDIT_RETENTION_MONTHS 2011
+#define IDC_STATIC_BACKUP_LABEL 2012
+#define IDC_EDIT_BACKUP_DAYS 2013
+#define IDC_STATIC_SESSION_GAP_LABEL 2014
+#define IDC_EDIT_SESSION_GAP 2015
+#define IDC_STATIC_LOG_LEVEL_LABEL 2016
+#define IDC_COMBO_LOG_LEVEL 2017
 
 // Next default values for new objects
 #ifndef APSTUDIO_READONLY_SYMBOLS
@@ -22,21 +22,24 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
 #include <algorithm>
 #include <queue>
+#include <list>
 #include <mutex>
 #include <thread>
 #include <atomic>
 #include <functional>
 #include <chrono>
 #include <sstream>
+#include <fstream>
 #include <iomanip>
 #include <memory>
+#include <filesystem>
 #include <cassert>
 
 // SQLite (amalgamation – included in third_party/sqlite)
 #include <sqlite3.h>
-
-// pugixml
-#include <pugixml.hpp>
 #endif
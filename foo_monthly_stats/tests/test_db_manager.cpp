@@ -1,168 +1,112 @@
-// test_db_manager.cpp – Unit tests for DbManager (uses in-memory SQLite)
-// These tests are standalone and do NOT depend on the foobar2000 SDK.
+// test_db_manager.cpp – Unit tests for DbManager, the core logger, the period helpers, ListenTimer
+// and cover MIME sniffing
+// These tests link the real core (fms_core / core.h) and do NOT depend on the foobar2000 SDK.
 
 #include "../catch2/catch_amalgamated.hpp"
 
-// ---- Minimal stubs to isolate DbManager from foobar2000 SDK ----
+#include "core.h"
+#include "db_manager.h"
+#include "db_stats.h"
+#include "period.h"
+#include "listen_timer.h"
+#include "thumbnail.h"
+#include "thumbnail_cache.h"
+#include "report_exporter.h"
+#include "html_writer.h"
+#include "base64.h"
 
-// We need to pull in sqlite3 directly. Provide a minimal build environment.
-#include "../../third_party/sqlite/sqlite3.h"
+using namespace fms;
 
-#include <string>
-#include <vector>
-#include <chrono>
-#include <ctime>
-#include <sstream>
-#include <iomanip>
-
-// ---- Standalone re-implementation of only the DB logic (no SDK) ----
-// Copy the essential logic from db_manager.cpp for isolated testing.
+// Helper: ms timestamp for "2025-07-01 12:00:00 UTC"
+static int64_t ts(int year, int mon, int day)
+{
+    struct tm t{};
+    t.tm_year = year - 1900;
+    t.tm_mon = mon - 1;
+    t.tm_mday = day;
+    t.tm_hour = 12;
+#ifdef _WIN32
+    time_t ut = _mkgmtime(&t);
+#else
+    time_t ut = timegm(&t);
+#endif
+    return static_cast<int64_t>(ut) * 1000;
+}
 
-struct TrackInfoTest
+// A play as PlaybackStatsCollector posts it when a track starts (length 0 = one play)
+static TrackInfo play(const char *crc, const char *title, const char *artist, const char *album, int64_t playedAt)
 {
-    std::string track_crc;
-    std::string title;
-    std::string artist;
-    std::string album;
-    int64_t played_at;
-};
+    return TrackInfo{crc, std::string("/music/") + crc + ".flac", title, artist, album, 0, playedAt};
+}
 
-struct MonthlyEntryTest
+// Polls until done() holds (worker results that close() would drop); false after 5 s
+static bool waitUntil(const std::function<bool()> &done)
 {
-    std::string ym;
-    std::string track_crc;
-    std::string title;
-    std::string artist;
-    std::string album;
-    int64_t playcount;
-    int64_t prev_playcount;
-};
+    for (int i = 0; i < 500; ++i)
+    {
+        if (done())
+            return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return done();
+}
+
+// ---- DbManager on a fresh database file in the temp directory ----
 
 class TestDb
 {
 public:
-    sqlite3 *db = nullptr;
+    DbManager db;
 
-    bool open(const char *path = ":memory:")
+    TestDb()
     {
-        return sqlite3_open(path, &db) == SQLITE_OK && ensureSchema();
+        static int counter = 0;
+        m_dir = std::filesystem::temp_directory_path() / ("fms_test_" + std::to_string(++counter));
+        std::error_code ec;
+        std::filesystem::remove_all(m_dir, ec);
+        std::filesystem::create_directories(m_dir);
+        m_path = (m_dir / "stats.db").string();
     }
-    void close()
+    ~TestDb()
     {
-        if (db)
-        {
-            sqlite3_close(db);
-            db = nullptr;
-        }
-    }
-    ~TestDb() { close(); }
-
-    bool ensureSchema()
-    {
-        const char *ddl =
-            "CREATE TABLE IF NOT EXISTS play_log ("
-            "  id INTEGER PRIMARY KEY, track_crc TEXT, title TEXT,"
-            "  artist TEXT, album TEXT, played_at INTEGER);"
-            "CREATE INDEX IF NOT EXISTS ix_pa ON play_log(played_at);"
-            "CREATE TABLE IF NOT EXISTS monthly_count ("
-            "  ym TEXT, track_crc TEXT, title TEXT, artist TEXT, album TEXT,"
-            "  playcount INTEGER DEFAULT 0, PRIMARY KEY(ym,track_crc));";
-        return sqlite3_exec(db, ddl, nullptr, nullptr, nullptr) == SQLITE_OK;
+        db.close();
+        std::error_code ec;
+        std::filesystem::remove_all(m_dir, ec);
     }
 
-    void insertPlay(const TrackInfoTest &ti)
+    bool open() { return db.open(m_path.c_str()); }
+
+    void insertPlay(const TrackInfo &ti) { db.postPlay(ti); }
+
+    // Waits for the worker: close() drains the queue, then the same file is reopened
+    void settle()
     {
-        time_t t = static_cast<time_t>(ti.played_at / 1000);
-        struct tm lm;
-#ifdef _WIN32
-        localtime_s(&lm, &t);
-#else
-        localtime_r(&t, &lm);
-#endif
-        char ym[8];
-        strftime(ym, sizeof(ym), "%Y-%m", &lm);
-
-        // play_log
-        sqlite3_stmt *s1 = nullptr;
-        sqlite3_prepare_v2(db,
-                           "INSERT INTO play_log(track_crc,title,artist,album,played_at) VALUES(?,?,?,?,?)",
-                           -1, &s1, nullptr);
-        sqlite3_bind_text(s1, 1, ti.track_crc.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s1, 2, ti.title.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s1, 3, ti.artist.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s1, 4, ti.album.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_int64(s1, 5, ti.played_at);
-        sqlite3_step(s1);
-        sqlite3_finalize(s1);
-
-        // monthly_count upsert
-        sqlite3_stmt *s2 = nullptr;
-        sqlite3_prepare_v2(db,
-                           "INSERT INTO monthly_count(ym,track_crc,title,artist,album,playcount) VALUES(?,?,?,?,?,1)"
-                           " ON CONFLICT(ym,track_crc) DO UPDATE SET playcount=playcount+1,"
-                           "  title=excluded.title,artist=excluded.artist,album=excluded.album",
-                           -1, &s2, nullptr);
-        sqlite3_bind_text(s2, 1, ym, -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s2, 2, ti.track_crc.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s2, 3, ti.title.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s2, 4, ti.artist.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_bind_text(s2, 5, ti.album.c_str(), -1, SQLITE_TRANSIENT);
-        sqlite3_step(s2);
-        sqlite3_finalize(s2);
+        db.close();
+        REQUIRE(db.open(m_path.c_str()));
     }
 
-    std::vector<MonthlyEntryTest> queryMonth(const std::string &ym)
+    // Scalar query on one of the database files ("" = main, "2025" = that play_log partition)
+    int64_t scalar(const std::string &file, const char *sql)
     {
-        std::vector<MonthlyEntryTest> res;
-        sqlite3_stmt *s = nullptr;
-        sqlite3_prepare_v2(db,
-                           "SELECT c.ym,c.track_crc,c.title,c.artist,c.album,c.playcount,0"
-                           " FROM monthly_count c WHERE c.ym=? ORDER BY c.playcount DESC",
-                           -1, &s, nullptr);
-        sqlite3_bind_text(s, 1, ym.c_str(), -1, SQLITE_TRANSIENT);
-        while (sqlite3_step(s) == SQLITE_ROW)
+        settle();
+        std::string path = file.empty() ? m_path : (m_dir / ("stats_" + file + ".db")).string();
+        sqlite3 *conn = nullptr;
+        int64_t n = -1;
+        if (sqlite3_open_v2(path.c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
         {
-            MonthlyEntryTest e;
-            e.ym = (const char *)sqlite3_column_text(s, 0);
-            e.track_crc = (const char *)sqlite3_column_text(s, 1);
-            e.title = (const char *)sqlite3_column_text(s, 2);
-            e.artist = (const char *)sqlite3_column_text(s, 3);
-            e.album = (const char *)sqlite3_column_text(s, 4);
-            e.playcount = sqlite3_column_int64(s, 5);
-            res.push_back(e);
+            sqlite3_stmt *s = nullptr;
+            if (sqlite3_prepare_v2(conn, sql, -1, &s, nullptr) == SQLITE_OK && sqlite3_step(s) == SQLITE_ROW)
+                n = sqlite3_column_int64(s, 0);
+            sqlite3_finalize(s);
         }
-        sqlite3_finalize(s);
-        return res;
-    }
-
-    int64_t rowCount(const char *table)
-    {
-        sqlite3_stmt *s = nullptr;
-        std::string sql = "SELECT COUNT(*) FROM ";
-        sql += table;
-        sqlite3_prepare_v2(db, sql.c_str(), -1, &s, nullptr);
-        sqlite3_step(s);
-        int64_t n = sqlite3_column_int64(s, 0);
-        sqlite3_finalize(s);
+        sqlite3_close(conn);
         return n;
     }
-};
 
-// Helper: ms timestamp for "2025-07-01 12:00:00 UTC"
-static int64_t ts(int year, int mon, int day)
-{
-    struct tm t{};
-    t.tm_year = year - 1900;
-    t.tm_mon = mon - 1;
-    t.tm_mday = day;
-    t.tm_hour = 12;
-#ifdef _WIN32
-    time_t ut = _mkgmtime(&t);
-#else
-    time_t ut = timegm(&t);
-#endif
-    return static_cast<int64_t>(ut) * 1000;
-}
+private:
+    std::filesystem::path m_dir;
+    std::string m_path;
+};
 
 // =====================================================================
 // Tests
@@ -172,29 +116,28 @@ TEST_CASE("Database schema creation", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    REQUIRE(db.rowCount("play_log") == 0);
-    REQUIRE(db.rowCount("monthly_count") == 0);
+    REQUIRE(db.scalar("", "SELECT COUNT(*) FROM monthly_count") == 0);
+    REQUIRE(db.db.queryMonth("2025-07").empty());
 }
 
 TEST_CASE("Single play inserted into play_log", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    TrackInfoTest ti{"abc123", "Track A", "Artist X", "Album 1", ts(2025, 7, 15)};
-    db.insertPlay(ti);
-    REQUIRE(db.rowCount("play_log") == 1);
+    db.insertPlay(play("abc123", "Track A", "Artist X", "Album 1", ts(2025, 7, 15)));
+    REQUIRE(db.scalar("2025", "SELECT COUNT(*) FROM play_log") == 1);
 }
 
 TEST_CASE("Play count increments for same track same month", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    TrackInfoTest ti{"abc123", "Track A", "Artist X", "Album 1", ts(2025, 7, 15)};
+    TrackInfo ti = play("abc123", "Track A", "Artist X", "Album 1", ts(2025, 7, 15));
     db.insertPlay(ti);
     db.insertPlay(ti);
     db.insertPlay(ti);
-    REQUIRE(db.rowCount("play_log") == 3);
-    auto rows = db.queryMonth("2025-07");
+    REQUIRE(db.scalar("2025", "SELECT COUNT(*) FROM play_log") == 3);
+    auto rows = db.db.queryMonth("2025-07");
     REQUIRE(rows.size() == 1);
     REQUIRE(rows[0].playcount == 3);
 }
@@ -203,12 +146,13 @@ TEST_CASE("Multiple tracks – sorted by playcount desc", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    TrackInfoTest a{"aaa", "Song A", "Artist", "Album", ts(2025, 7, 1)};
-    TrackInfoTest b{"bbb", "Song B", "Artist", "Album", ts(2025, 7, 1)};
+    TrackInfo a = play("aaa", "Song A", "Artist", "Album", ts(2025, 7, 1));
+    TrackInfo b = play("bbb", "Song B", "Artist", "Album", ts(2025, 7, 1));
     db.insertPlay(a);
     db.insertPlay(b);
     db.insertPlay(b);
-    auto rows = db.queryMonth("2025-07");
+    db.settle();
+    auto rows = db.db.queryMonth("2025-07");
     REQUIRE(rows.size() == 2);
     REQUIRE(rows[0].track_crc == "bbb"); // 2 plays
     REQUIRE(rows[1].track_crc == "aaa"); // 1 play
@@ -218,12 +162,11 @@ TEST_CASE("Plays in different months are separated", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    TrackInfoTest ti{"ccc", "Track C", "Artist", "Album", ts(2025, 7, 1)};
-    TrackInfoTest ti2{"ccc", "Track C", "Artist", "Album", ts(2025, 8, 1)};
-    db.insertPlay(ti);
-    db.insertPlay(ti2);
-    auto jul = db.queryMonth("2025-07");
-    auto aug = db.queryMonth("2025-08");
+    db.insertPlay(play("ccc", "Track C", "Artist", "Album", ts(2025, 7, 1)));
+    db.insertPlay(play("ccc", "Track C", "Artist", "Album", ts(2025, 8, 1)));
+    db.settle();
+    auto jul = db.db.queryMonth("2025-07");
+    auto aug = db.db.queryMonth("2025-08");
     REQUIRE(jul.size() == 1);
     REQUIRE(aug.size() == 1);
     REQUIRE(jul[0].playcount == 1);
@@ -234,7 +177,7 @@ TEST_CASE("Empty month returns empty vector", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    auto rows = db.queryMonth("2000-01");
+    auto rows = db.db.queryMonth("2000-01");
     REQUIRE(rows.empty());
 }
 
@@ -242,11 +185,923 @@ TEST_CASE("Metadata (title/artist/album) stored correctly", "[db]")
 {
     TestDb db;
     REQUIRE(db.open());
-    TrackInfoTest ti{"ddd", "My Title", "My Artist", "My Album", ts(2025, 7, 10)};
-    db.insertPlay(ti);
-    auto rows = db.queryMonth("2025-07");
+    db.insertPlay(play("ddd", "My Title", "My Artist", "My Album", ts(2025, 7, 10)));
+    db.settle();
+    auto rows = db.db.queryMonth("2025-07");
     REQUIRE(rows.size() == 1);
     REQUIRE(rows[0].title == "My Title");
     REQUIRE(rows[0].artist == "My Artist");
     REQUIRE(rows[0].album == "My Album");
 }
+
+TEST_CASE("Listened seconds add play time, not plays", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    TrackInfo ti = play("eee", "Track E", "Artist", "Album", ts(2025, 7, 10));
+    db.insertPlay(ti);
+    ti.length_seconds = 200; // the stop event
+    db.insertPlay(ti);
+    db.settle();
+    auto rows = db.db.queryMonth("2025-07");
+    REQUIRE(rows.size() == 1);
+    REQUIRE(rows[0].playcount == 1);
+    REQUIRE(rows[0].total_time_seconds == Catch::Approx(200));
+}
+
+TEST_CASE("Day, month and year views aggregate the same plays", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 6, 30)));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 2)));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 2)));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2024, 7, 2)));
+    db.settle();
+
+    auto day = db.db.queryDay("2025-07-02");
+    REQUIRE(day.size() == 1);
+    REQUIRE(day[0].playcount == 2);
+
+    auto month = db.db.queryMonth("2025-07");
+    REQUIRE(month.size() == 1);
+    REQUIRE(month[0].playcount == 2);
+    REQUIRE(month[0].prev_playcount == 1); // June
+
+    auto year = db.db.queryYear("2025");
+    REQUIRE(year.size() == 1);
+    REQUIRE(year[0].track_crc == "fff");
+    REQUIRE(year[0].playcount == 3);
+    REQUIRE(db.db.queryYear("2024").size() == 1); // separate partition
+}
+
+TEST_CASE("Compacted plays move to the archive and still refresh", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    const int year = std::stoi(DbManager::currentYear());
+    const int month = std::stoi(DbManager::currentYM().substr(5, 2));
+    const int64_t old = localMidnightMs(year, month - 3, 10) + 12 * 3600 * 1000; // normalized across the year
+    const std::string oldYm = addMonths(DbManager::currentYM(), -3);
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", old));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", old));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", static_cast<int64_t>(time(nullptr)) * 1000));
+    db.settle();
+
+    std::mutex mutex;
+    bool archived = false;
+    setLogSink([&](const std::string &line)
+               {
+        std::lock_guard<std::mutex> lk(mutex);
+        archived = archived || line.find("archived 2 play_log rows") != std::string::npos; });
+    db.db.postCompaction(1);
+    const bool done = waitUntil([&]
+                                {
+        std::lock_guard<std::mutex> lk(mutex);
+        return archived; });
+    setLogSink(nullptr);
+    REQUIRE(done);
+
+    // Rebuilt from the archived daily aggregates
+    db.db.postRefreshPeriod(oldYm, false);
+    db.settle();
+    auto rows = db.db.queryMonth(oldYm);
+    REQUIRE(rows.size() == 1);
+    REQUIRE(rows[0].track_crc == "fff");
+    REQUIRE(rows[0].playcount == 2);
+
+    REQUIRE(db.scalar("archive", "SELECT SUM(playcount) FROM daily_log") == 2);
+    REQUIRE(db.scalar(std::to_string(year), "SELECT COUNT(*) FROM play_log") == 1);
+}
+
+TEST_CASE("Backup copies every database file and reports its progress", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    for (int i = 0; i < 50; ++i)
+        db.insertPlay(play(("t" + std::to_string(i)).c_str(), "Track", "Artist", "Album", ts(2025, 7, 2)));
+    db.settle();
+    const auto dir = std::filesystem::temp_directory_path() / "fms_backup_progress";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    std::atomic<int> done{-1};
+    int copied = 0, total = 0;
+    REQUIRE_FALSE(db.db.backupProgress(copied, total));
+    db.db.postBackup(dir.u8string(), [&](bool ok)
+                     { done = ok ? 1 : 0; });
+    bool consistent = true;
+    REQUIRE(waitUntil([&]
+                      {
+        if (db.db.backupProgress(copied, total))
+            consistent = consistent && copied >= 0 && copied <= total;
+        return done >= 0; }));
+    REQUIRE(consistent);
+    REQUIRE(done == 1);
+    REQUIRE_FALSE(db.db.backupProgress(copied, total));
+    REQUIRE(std::filesystem::exists(dir / "stats.db"));
+    REQUIRE(std::filesystem::exists(dir / "stats_2025.db"));
+
+    // The copy is a readable database holding the plays
+    sqlite3 *conn = nullptr;
+    int64_t plays = -1;
+    if (sqlite3_open_v2((dir / "stats_2025.db").u8string().c_str(), &conn, SQLITE_OPEN_READONLY, nullptr) == SQLITE_OK)
+    {
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(conn, "SELECT COUNT(*) FROM play_log", -1, &stmt, nullptr) == SQLITE_OK &&
+            sqlite3_step(stmt) == SQLITE_ROW)
+            plays = sqlite3_column_int64(stmt, 0);
+        sqlite3_finalize(stmt);
+    }
+    sqlite3_close(conn);
+    REQUIRE(plays == 50);
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST_CASE("The current day, month and year come from the snapshot", "[db]")
+{
+    DbStats::get().setEnabled(true);
+    TestDb db;
+    REQUIRE(db.open());
+    const std::string today = DbManager::currentYMD(), month = DbManager::currentYM(), year = DbManager::currentYear();
+    const int64_t now = static_cast<int64_t>(time(nullptr)) * 1000;
+    const int64_t lastMonth = localMidnightMs(std::stoi(year), std::stoi(month.substr(5, 2)) - 1, 15) + 12 * 3600 * 1000;
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", lastMonth));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", now));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", now));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", now));
+    db.settle();
+
+    DbStats::get().reset();
+    auto day = db.db.queryDay(today);
+    auto current = db.db.queryMonth(month);
+    auto wholeYear = db.db.queryYear(year);
+    const auto statsPath = std::filesystem::temp_directory_path() / "fms_hot_stats.json";
+    auto statements = [&]
+    {
+        REQUIRE(DbStats::get().writeJson(statsPath.u8string()));
+        std::ifstream in(statsPath, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+    const std::string hotOnly = statements();
+
+    // A past month still goes to SQL
+    db.db.queryMonth(addMonths(month, -1));
+    const std::string withPast = statements();
+    DbStats::get().reset();
+    DbStats::get().setEnabled(false);
+    std::error_code ec;
+    std::filesystem::remove(statsPath, ec);
+
+    REQUIRE(hotOnly.find("prev_pc") == std::string::npos); // selectDay / selectMonth
+    REQUIRE(hotOnly.find("prev_total") == std::string::npos); // selectYear
+    REQUIRE(withPast.find("prev_pc") != std::string::npos);
+
+    REQUIRE(day.size() == 2);
+    REQUIRE(day[0].track_crc == "fff");
+    REQUIRE(day[0].playcount == 2);
+    REQUIRE(current.size() == 2);
+    REQUIRE(current[0].playcount == 2);
+    REQUIRE(current[0].prev_playcount == 1);
+    const bool january = month.substr(5, 2) == "01";
+    REQUIRE(wholeYear[0].playcount == (january ? 2 : 3));
+}
+
+TEST_CASE("A write to a cached past month replaces the cached rows", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 3, 10)));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2025, 4, 10)));
+    db.settle();
+
+    // Cached now; the commit is delivered after the cache learned of the write
+    REQUIRE(db.db.queryMonth("2025-03")[0].playcount == 1);
+    REQUIRE(db.db.queryMonth("2025-04")[0].playcount == 1);
+    std::atomic<int> commits{0};
+    const int token = db.db.subscribe([&](const CommitEvent &)
+                                      { ++commits; });
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 3, 20)));
+    REQUIRE(waitUntil([&]
+                      { return commits > 0; }));
+    db.db.unsubscribe(token);
+
+    auto march = db.db.queryMonth("2025-03");
+    REQUIRE(march.size() == 1);
+    REQUIRE(march[0].playcount == 2);
+    auto april = db.db.queryMonth("2025-04"); // its delta column depends on March
+    REQUIRE(april[0].prev_playcount == 0);
+    REQUIRE(db.db.queryMonth("2025-04")[0].playcount == 1);
+}
+
+TEST_CASE("Deletes and refreshes run on the worker and publish their days", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 2)));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2025, 7, 3)));
+    db.settle();
+
+    std::mutex mutex;
+    std::vector<CommitEvent> events;
+    const int token = db.db.subscribe([&](const CommitEvent &e)
+                                      {
+        std::lock_guard<std::mutex> lk(mutex);
+        events.push_back(e); });
+
+    // Queued edits still run when the database closes right after
+    db.db.postDeleteEntry("2025-07-02", "fff");
+    db.db.postDeleteEntry("2025-07-02", "missing"); // nothing deleted, nothing published
+    db.settle();
+    REQUIRE(db.db.queryDay("2025-07-02").empty());
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].days == std::set<std::string>{"2025-07-02"});
+    REQUIRE(events[0].track_crcs == std::set<std::string>{"fff"});
+
+    db.db.postRefreshPeriod("2025-07", false);
+    db.settle();
+    REQUIRE(db.db.queryDay("2025-07-02").size() == 1);
+    REQUIRE(events.size() == 2);
+    REQUIRE(events[1].days == std::set<std::string>{"2025-07-02", "2025-07-03"});
+    REQUIRE(events[1].track_crcs == std::set<std::string>{"fff", "ggg"});
+    db.db.unsubscribe(token);
+}
+
+TEST_CASE("Commits waiting for the main thread are merged into one event", "[db]")
+{
+    std::vector<std::function<void()>> mainThread;
+    std::mutex mutex;
+    setMainThreadDispatcher([&](std::function<void()> fn)
+                            {
+        std::lock_guard<std::mutex> lk(mutex);
+        mainThread.push_back(std::move(fn)); });
+
+    TestDb db;
+    REQUIRE(db.open());
+    std::vector<CommitEvent> events;
+    const int token = db.db.subscribe([&](const CommitEvent &e)
+                                      { events.push_back(e); });
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 2)));
+    REQUIRE(waitUntil([&]
+                      {
+        std::lock_guard<std::mutex> lk(mutex);
+        return !mainThread.empty(); }));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2025, 7, 3)));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 4)));
+    db.settle(); // commits the rest; the delivery is still queued
+    setMainThreadDispatcher(nullptr);
+
+    REQUIRE(mainThread.size() == 1);
+    REQUIRE(events.empty());
+    mainThread[0]();
+    REQUIRE(events.size() == 1);
+    REQUIRE(events[0].days == std::set<std::string>{"2025-07-02", "2025-07-03", "2025-07-04"});
+    REQUIRE(events[0].track_crcs == std::set<std::string>{"fff", "ggg"});
+
+    // Unsubscribed callbacks are not called
+    db.db.unsubscribe(token);
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 5)));
+    db.settle();
+    REQUIRE(events.size() == 1);
+}
+
+TEST_CASE("Search matches every word in the period only", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("aaa", "Come Together", "The Beatles", "Abbey Road", ts(2025, 7, 2)));
+    db.insertPlay(play("bbb", "Something", "The Beatles", "Abbey Road", ts(2025, 7, 2)));
+    db.insertPlay(play("ccc", "Roadrunner", "Caf\xc3\xa9 Tacvba", "Re", ts(2025, 7, 2)));
+    db.insertPlay(play("ddd", "Come Together", "The Beatles", "Abbey Road", ts(2025, 8, 2)));
+    db.settle();
+
+    auto crcs = [&](const char *period, const char *query)
+    {
+        std::set<std::string> result;
+        for (const auto &e : db.db.search(period, query))
+            result.insert(e.track_crc);
+        return result;
+    };
+    REQUIRE(crcs("2025-07", "") == std::set<std::string>{"aaa", "bbb", "ccc"});
+    REQUIRE(crcs("2025-07", "road") == std::set<std::string>{"aaa", "bbb", "ccc"});
+    REQUIRE(crcs("2025-07", "road come") == std::set<std::string>{"aaa"}); // every word
+    REQUIRE(crcs("2025-07", "CAFE") == std::set<std::string>{"ccc"});       // case and accent
+    REQUIRE(crcs("2025-07", "gether").empty());                             // prefixes only
+    REQUIRE(crcs("2025-08", "come") == std::set<std::string>{"ddd"});
+    REQUIRE(crcs("2025-07-02", "something") == std::set<std::string>{"bbb"});
+    REQUIRE(crcs("2025", "come") == std::set<std::string>{"aaa", "ddd"});
+}
+
+TEST_CASE("Year by month matches the month views", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2024, 12, 31)));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 1, 3)));
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 1, 9)));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2025, 1, 9)));
+    db.insertPlay(play("ggg", "Track G", "Artist", "Album", ts(2025, 2, 1)));
+    TrackInfo stop = play("ggg", "Track G", "Artist", "Album", ts(2025, 3, 1));
+    stop.length_seconds = 100; // listening time only: March has no plays to show
+    db.insertPlay(stop);
+    db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 12, 31)));
+    db.insertPlay(play("hhh", "Track H", "Artist", "Album", ts(2026, 1, 1)));
+    db.settle();
+
+    auto byMonth = db.db.queryYearByMonth("2025");
+    REQUIRE(byMonth.size() == 3);
+    REQUIRE(byMonth.count("2024-12") == 0);
+    for (const char *ym : {"2025-01", "2025-02", "2025-12"})
+    {
+        auto month = db.db.queryMonth(ym);
+        auto &rows = byMonth[ym];
+        auto byCrc = [](const MonthlyEntry &a, const MonthlyEntry &b) { return a.track_crc < b.track_crc; };
+        std::sort(month.begin(), month.end(), byCrc);
+        std::sort(rows.begin(), rows.end(), byCrc);
+        REQUIRE(rows.size() == month.size());
+        for (size_t i = 0; i < rows.size(); ++i)
+        {
+            REQUIRE(rows[i].ymd == month[i].ymd);
+            REQUIRE(rows[i].track_crc == month[i].track_crc);
+            REQUIRE(rows[i].playcount == month[i].playcount);
+            REQUIRE(rows[i].prev_playcount == month[i].prev_playcount);
+            REQUIRE(rows[i].total_time_seconds == month[i].total_time_seconds);
+        }
+    }
+    REQUIRE(byMonth["2025-01"][0].prev_playcount == 1); // December 2024
+
+    // The year's rows from the same pass match queryYear, deltas from 2024 included
+    std::vector<MonthlyEntry> yearRows;
+    REQUIRE(db.db.queryYearByMonth("2025", &yearRows).size() == 3);
+    auto year = db.db.queryYear("2025");
+    REQUIRE(yearRows.size() == year.size());
+    for (size_t i = 0; i < yearRows.size(); ++i)
+    {
+        REQUIRE(yearRows[i].ymd == year[i].ymd);
+        REQUIRE(yearRows[i].track_crc == year[i].track_crc);
+        REQUIRE(yearRows[i].playcount == year[i].playcount);
+        REQUIRE(yearRows[i].prev_playcount == year[i].prev_playcount);
+        REQUIRE(yearRows[i].total_time_seconds == year[i].total_time_seconds);
+    }
+    REQUIRE(yearRows[0].track_crc == "fff");
+    REQUIRE(yearRows[0].playcount == 3);
+    REQUIRE(yearRows[0].prev_playcount == 1);
+    REQUIRE(yearRows[1].total_time_seconds == Catch::Approx(100));
+}
+
+TEST_CASE("removeDuplicates merges one track recorded under two paths", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("old", "Same", "Artist", "Album", ts(2025, 7, 4)));
+    db.insertPlay(play("new", "Same", "Artist", "Album", ts(2025, 7, 4)));
+    db.insertPlay(play("new", "Same", "Artist", "Album", ts(2025, 7, 20)));
+    db.insertPlay(play("other", "Other", "Artist", "Album", ts(2025, 7, 4)));
+    db.settle();
+    db.db.removeDuplicates();
+    db.settle();
+
+    auto day = db.db.queryDay("2025-07-04");
+    REQUIRE(day.size() == 2);
+    REQUIRE(day[0].title == "Same");
+    REQUIRE(day[0].playcount == 2);
+    REQUIRE(day[1].title == "Other");
+
+    // Days without a duplicate keep their rows
+    auto later = db.db.queryDay("2025-07-20");
+    REQUIRE(later.size() == 1);
+    REQUIRE(later[0].playcount == 1);
+}
+
+TEST_CASE("Search results only narrow as the query grows", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("aaa", "Come Together", "The Beatles", "Abbey Road", ts(2025, 7, 2)));
+    db.insertPlay(play("bbb", "Abbey Lane", "Someone", "Else", ts(2025, 7, 2)));
+    db.insertPlay(play("ccc", "Bad", "Nobody", "Singles", ts(2025, 7, 2)));
+    db.insertPlay(play("ddd", "Big Country", "B\xc3\xa9la Fleck", "Drive", ts(2025, 7, 2)));
+    db.settle();
+
+    auto crcs = [&](const char *query)
+    {
+        std::set<std::string> result;
+        for (const auto &e : db.db.search("2025-07", query))
+            result.insert(e.track_crc);
+        return result;
+    };
+    // "b" is shorter than the FTS prefix index, "be" and "bea" are in it
+    const auto b = crcs("b"), be = crcs("be"), bea = crcs("bea");
+    REQUIRE(b == std::set<std::string>{"aaa", "ccc", "ddd"}); // a prefix of a word, not "Abbey"
+    REQUIRE(be == std::set<std::string>{"aaa", "ddd"});       // "Béla" without its accent
+    REQUIRE(bea == std::set<std::string>{"aaa"});
+    REQUIRE(std::includes(b.begin(), b.end(), be.begin(), be.end()));
+    REQUIRE(std::includes(be.begin(), be.end(), bea.begin(), bea.end()));
+    REQUIRE(crcs("B") == b);
+    REQUIRE(crcs("\xc3\x89") == crcs("e")); // "É"
+    REQUIRE(crcs("b road") == std::set<std::string>{"aaa"});
+}
+
+TEST_CASE("Search matches the tags each period shows for a retagged track", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    db.insertPlay(play("aaa", "Old Name", "Artist", "Album", ts(2025, 6, 2)));
+    db.insertPlay(play("aaa", "New Name", "Artist", "Album", ts(2025, 7, 2)));
+    db.settle();
+
+    auto titles = [&](const char *period, const char *query)
+    {
+        std::set<std::string> result;
+        for (const auto &e : db.db.search(period, query))
+            result.insert(e.title);
+        return result;
+    };
+    REQUIRE(titles("2025-06", "old") == std::set<std::string>{"Old Name"});
+    REQUIRE(titles("2025-06", "new").empty());
+    REQUIRE(titles("2025-07", "new") == std::set<std::string>{"New Name"});
+    REQUIRE(titles("2025-07", "old").empty());
+    REQUIRE(titles("2025", "name") == std::set<std::string>{"Old Name", "New Name"});
+    REQUIRE(titles("2025", "old") == std::set<std::string>{"Old Name"});
+}
+
+TEST_CASE("A backup dropped by close() ends and the next one runs", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    const auto dir = std::filesystem::temp_directory_path() / "fms_backup_dropped";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    // Plays go first, so close() usually drops the backup before it starts
+    for (int i = 0; i < 200; ++i)
+        db.insertPlay(play("fff", "Track F", "Artist", "Album", ts(2025, 7, 2)));
+    std::atomic<int> calls{0};
+    db.db.postBackup(dir.u8string(), [&](bool)
+                     { ++calls; });
+    db.settle();
+    REQUIRE(calls == 1);
+    int copied = 0, total = 0;
+    REQUIRE_FALSE(db.db.backupProgress(copied, total));
+
+    std::atomic<int> done{-1};
+    db.db.postBackup(dir.u8string(), [&](bool ok)
+                     { done = ok ? 1 : 0; });
+    for (int i = 0; i < 500 && done < 0; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    REQUIRE(done == 1);
+    REQUIRE(std::filesystem::exists(dir / "stats.db"));
+    for (const auto &entry : std::filesystem::directory_iterator(dir))
+        REQUIRE(entry.path().extension() != ".tmp");
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST_CASE("Plays are grouped into listening sessions by the gap", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    const int64_t t = ts(2025, 7, 10);
+    TrackInfo a = play("aaa", "Track A", "Artist", "Album", t);
+    db.insertPlay(a);
+    a.length_seconds = 200; // stopped after 200 s
+    a.played_at = t + 200 * 1000;
+    db.insertPlay(a);
+    db.insertPlay(play("bbb", "Track B", "Artist", "Album", t + 210 * 1000));
+    db.insertPlay(play("ccc", "Track C", "Artist", "Album", t + 3 * 3600 * 1000)); // past the 30 min gap
+    db.insertPlay(play("ddd", "Track D", "Artist", "Album", ts(2025, 7, 11)));
+    db.settle();
+
+    SessionStats stats = db.db.querySessions("2025-07");
+    REQUIRE(stats.sessions.size() == 3);
+    REQUIRE(stats.activeDays == 2);
+    REQUIRE(stats.sessions[0].plays == 2);
+    REQUIRE(stats.sessions[0].listened_seconds == Catch::Approx(200));
+    REQUIRE(stats.longest.start_at == t);
+    REQUIRE(stats.longest.end_at == t + 210 * 1000);
+    REQUIRE(stats.averageSeconds == Catch::Approx(70));
+    REQUIRE(db.db.querySessions("2025-07-11").sessions.size() == 1);
+    REQUIRE(db.db.querySessions("2025-08").sessions.empty());
+
+    // A wider gap rebuilds the table from play_log on the worker
+    db.db.setSessionGap(240);
+    for (int i = 0; i < 500 && db.db.querySessions("2025-07").sessions.size() != 2; ++i)
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    stats = db.db.querySessions("2025-07");
+    REQUIRE(stats.sessions.size() == 2);
+    REQUIRE(stats.sessions[0].plays == 3);
+    REQUIRE(stats.sessions[0].end_at == t + 3 * 3600 * 1000);
+}
+
+TEST_CASE("A play in the gap between two sessions joins them", "[db]")
+{
+    TestDb db;
+    REQUIRE(db.open());
+    const int64_t t = ts(2025, 7, 10);
+    const int64_t minute = 60 * 1000;
+    db.insertPlay(play("aaa", "Track A", "Artist", "Album", t));
+    db.insertPlay(play("bbb", "Track B", "Artist", "Album", t + 60 * minute));
+    db.insertPlay(play("ccc", "Track C", "Artist", "Album", t + 120 * minute));
+    db.settle();
+    REQUIRE(db.db.querySessions("2025-07").sessions.size() == 3);
+
+    // Listened from minute 20 to 40: within the 30 min gap of the first two sessions only
+    TrackInfo bridge = play("ddd", "Track D", "Artist", "Album", t + 40 * minute);
+    bridge.length_seconds = 20 * 60;
+    db.insertPlay(bridge);
+    db.settle();
+
+    // What rebuildSessions computes from play_log for the same plays
+    SessionStats stats = db.db.querySessions("2025-07");
+    REQUIRE(stats.sessions.size() == 2);
+    REQUIRE(stats.sessions[0].start_at == t);
+    REQUIRE(stats.sessions[0].end_at == t + 60 * minute);
+    REQUIRE(stats.sessions[0].plays == 2);
+    REQUIRE(stats.sessions[0].listened_seconds == Catch::Approx(20 * 60));
+    REQUIRE(stats.sessions[1].start_at == t + 120 * minute);
+    REQUIRE(stats.sessions[1].plays == 1);
+}
+
+TEST_CASE("Core log lines go to the injected sink", "[core]")
+{
+    std::vector<std::string> lines;
+    setLogSink([&lines](const std::string &line)
+               { lines.push_back(line); });
+    DbManager db;
+    bool opened = db.open((std::filesystem::temp_directory_path() / "fms_missing_dir" / "x" / "stats.db").string().c_str());
+    setLogSink(nullptr);
+    REQUIRE_FALSE(opened);
+    REQUIRE(lines.size() == 1);
+    REQUIRE(lines[0].find("foo_monthly_stats: sqlite3_open failed") == 0);
+}
+
+TEST_CASE("Log level, per-category rate limit and background writer", "[core]")
+{
+    std::vector<std::string> calls;
+    setLogSink([&calls](const std::string &text)
+               { calls.push_back(text); });
+
+    // Debug is off by default and its operands are not evaluated
+    int evaluated = 0;
+    FMS_LOG(LogLevel::Debug, LogCategory::Art) << ++evaluated;
+    REQUIRE(evaluated == 0);
+    REQUIRE(calls.empty());
+
+    // Below Error a category gets kLogLinesPerSecond lines per second (at most two windows here)
+    setLogLevel(LogLevel::Debug);
+    for (int i = 0; i < 200; ++i)
+        FMS_LOG(LogLevel::Debug, LogCategory::Report) << "report " << i;
+    REQUIRE(calls.size() >= static_cast<size_t>(kLogLinesPerSecond));
+    REQUIRE(calls.size() <= static_cast<size_t>(2 * kLogLinesPerSecond + 1));
+    setLogLevel(LogLevel::Info);
+
+    // With the writer running lines arrive in batches, all of them by stopLogWriter
+    calls.clear();
+    startLogWriter();
+    Log() << "async 1";
+    Log(LogLevel::Warning, LogCategory::Db) << "async 2";
+    stopLogWriter();
+    setLogSink(nullptr);
+    std::string joined;
+    for (const auto &c : calls)
+        joined += (joined.empty() ? "" : "\n") + c;
+    REQUIRE(joined == "async 1\nasync 2");
+}
+
+TEST_CASE("Period helpers step back across month and year boundaries", "[period]")
+{
+    REQUIRE(previousDay("2025-07-15") == "2025-07-14");
+    REQUIRE(previousDay("2025-03-01") == "2025-02-28");
+    REQUIRE(previousDay("2024-03-01") == "2024-02-29");
+    REQUIRE(previousDay("2025-01-01") == "2024-12-31");
+    REQUIRE(addMonths("2025-07", -1) == "2025-06");
+    REQUIRE(addMonths("2025-01", -1) == "2024-12");
+    REQUIRE(addMonths("2025-07", 1) == "2025-08");
+    REQUIRE(addMonths("2025-12", 1) == "2026-01");
+    REQUIRE(addMonths("2025-03", -27) == "2022-12");
+    REQUIRE(addMonths("2025-03", 0) == "2025-03");
+    REQUIRE(addMonths("2025-00", 0) == "2025-01");
+    REQUIRE(addMonths("0000-01", -1) == "0000-01");
+    REQUIRE(addMonths("9999-12", 1) == "9999-12");
+    REQUIRE(addMonths("2025-06", 2147483647) == "9999-12");
+    REQUIRE_THROWS_AS(addMonths("2025-7", 1), std::invalid_argument);
+    REQUIRE_THROWS_AS(addMonths("July 25", 1), std::invalid_argument);
+
+    int64_t start = 0, end = 0;
+    REQUIRE(periodBoundsMs("2025-12", start, end));
+    REQUIRE(start == localMidnightMs(2025, 12, 1));
+    REQUIRE(end == localMidnightMs(2026, 1, 1));
+    REQUIRE(periodBoundsMs("2025", start, end));
+    REQUIRE(end == localMidnightMs(2026, 1, 1));
+    REQUIRE_FALSE(periodBoundsMs("July", start, end));
+}
+
+TEST_CASE("The automatic report covers each finished month once, in order", "[period]")
+{
+    // First enable: nothing reported yet, the caller records a baseline instead
+    REQUIRE(nextDueReportMonth("", "2025-07") == "");
+    // Baseline recorded, nothing due until the month running at enable is over
+    REQUIRE(nextDueReportMonth("2025-06", "2025-07") == "");
+    // Normal rollover
+    REQUIRE(nextDueReportMonth("2025-06", "2025-08") == "2025-07");
+    REQUIRE(nextDueReportMonth("2025-07", "2025-08") == "");
+    // December to January
+    REQUIRE(nextDueReportMonth("2025-11", "2026-01") == "2025-12");
+    REQUIRE(nextDueReportMonth("2025-12", "2026-01") == "");
+    // Catch-up after several missed months: one after another, then nothing
+    std::vector<std::string> reported;
+    std::string last = "2025-10";
+    for (std::string month; !(month = nextDueReportMonth(last, "2026-03")).empty(); last = month)
+        reported.push_back(month);
+    REQUIRE(reported == std::vector<std::string>{"2025-11", "2025-12", "2026-01", "2026-02"});
+    // A clock set back never reports again
+    REQUIRE(nextDueReportMonth("2026-02", "2025-05") == "");
+}
+
+TEST_CASE("ListenTimer counts playing time only", "[listen]")
+{
+    using namespace std::chrono;
+    const ListenTimer::Clock::time_point t0{};
+    ListenTimer timer;
+    timer.start(false, t0);
+    REQUIRE(timer.seconds(t0 + seconds(30)) == Catch::Approx(30));
+
+    // Paused for a minute: not counted; pausing twice changes nothing
+    timer.pause(t0 + seconds(30));
+    timer.pause(t0 + seconds(40));
+    timer.resume(t0 + seconds(90));
+    REQUIRE(timer.seconds(t0 + seconds(100)) == Catch::Approx(40));
+
+    // Stop freezes the count
+    timer.pause(t0 + seconds(100));
+    REQUIRE(timer.seconds(t0 + seconds(500)) == Catch::Approx(40));
+
+    // A track that starts paused counts from the resume
+    timer.start(true, t0);
+    REQUIRE(timer.seconds(t0 + seconds(10)) == 0);
+    timer.resume(t0 + seconds(10));
+    REQUIRE(timer.seconds(t0 + seconds(25)) == Catch::Approx(15));
+}
+
+TEST_CASE("Cover MIME type is sniffed from the signature", "[thumbnail]")
+{
+    const unsigned char jpeg[] = {0xFF, 0xD8, 0xFF, 0xE0, 0x00, 0x10};
+    const unsigned char png[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n', 0x00};
+    const char webp[] = "RIFF\x10\0\0\0WEBPVP8 ";
+    const char gif[] = "GIF89a";
+    REQUIRE(std::string(sniffImageMime(jpeg, sizeof(jpeg))) == "image/jpeg");
+    REQUIRE(std::string(sniffImageMime(png, sizeof(png))) == "image/png");
+    REQUIRE(std::string(sniffImageMime(webp, sizeof(webp) - 1)) == "image/webp");
+    REQUIRE(std::string(sniffImageMime(gif, sizeof(gif) - 1)) == "image/gif");
+    REQUIRE(sniffImageMime(png, 4) == nullptr); // truncated
+    REQUIRE(sniffImageMime("<svg", 4) == nullptr);
+}
+
+TEST_CASE("Thumbnail cache shares blobs, persists and evicts least recently used", "[thumbnail]")
+{
+    const auto dir = std::filesystem::temp_directory_path() / "fms_thumb_cache";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir);
+    const std::string path = (dir / "thumbs.db").string();
+
+    auto cover = [](const std::string &source, char fill)
+    {
+        ThumbnailCache::Entry e;
+        e.source = source;
+        e.sourceSize = 1000;
+        e.sourceTime = 42;
+        e.mime = "image/jpeg";
+        e.data.assign(1000, fill);
+        return e;
+    };
+
+    {
+        ThumbnailCache cache(2500);
+        REQUIRE(cache.open(path));
+        cache.store("A\x1f" "One", 64, cover("a1.flac", 'a'));
+        cache.store("A\x1f" "One", 128, cover("a1.flac", 'a')); // same bytes: one blob
+        ThumbnailCache::Entry none;
+        none.source = "b.flac";
+        cache.store("B\x1f" "Two", 64, none);
+        REQUIRE(cache.bytes() == 1000);
+
+        ThumbnailCache::Entry hit;
+        REQUIRE(cache.find("A\x1f" "One", 64, hit));
+        REQUIRE(hit.source == "a1.flac");
+        REQUIRE(hit.sourceSize == 1000);
+        REQUIRE(hit.sourceTime == 42);
+        REQUIRE(hit.mime == "image/jpeg");
+        REQUIRE(hit.data == std::string(1000, 'a'));
+        REQUIRE(cache.find("B\x1f" "Two", 64, hit));
+        REQUIRE(hit.mime.empty());
+        REQUIRE(hit.data.empty());
+        REQUIRE_FALSE(cache.find("A\x1f" "One", 32, hit));
+    }
+
+    ThumbnailCache cache(2500);
+    REQUIRE(cache.open(path));
+    ThumbnailCache::Entry hit;
+    REQUIRE(cache.find("A\x1f" "One", 128, hit)); // survives reopening
+    cache.store("C\x1f" "Three", 64, cover("c.flac", 'c'));
+    REQUIRE(cache.find("A\x1f" "One", 64, hit)); // A is now more recent than C
+    cache.store("D\x1f" "Four", 64, cover("d.flac", 'd'));
+    REQUIRE(cache.bytes() == 3000);
+
+    cache.trim();
+    REQUIRE(cache.bytes() <= 2500);
+    REQUIRE_FALSE(cache.find("C\x1f" "Three", 64, hit));
+    REQUIRE(cache.find("A\x1f" "One", 64, hit));
+    REQUIRE(cache.find("D\x1f" "Four", 64, hit));
+
+    cache.close();
+    std::filesystem::remove_all(dir, ec);
+}
+
+TEST_CASE("Report embeds each distinct cover once", "[report]")
+{
+    std::vector<MonthlyEntry> entries;
+    for (int i = 0; i < 12; ++i)
+        entries.push_back({"2025-07-01", "crc" + std::to_string(i), "", "Track " + std::to_string(i), "Artist", "Album",
+                           200.0, 12 - i, 0, 2400.0});
+    std::map<std::string, std::string> art;
+    for (const auto &e : entries)
+        art[e.track_crc] = "data:image/jpeg;base64,QUxCVU0=";
+    art["crc11"] = "data:image/png;base64,T1RIRVI=";
+
+    const auto path = std::filesystem::temp_directory_path() / "fms_report_art.html";
+    for (bool smartphone : {false, true})
+    {
+        const ReportFormat format = smartphone ? ReportFormat::Smartphone : ReportFormat::Desktop;
+        REQUIRE(ReportExporter::exportHtml("July 2025", entries, path.wstring(), art, format).empty());
+        std::ifstream in(path, std::ios::binary);
+        const std::string html((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        auto count = [&](const std::string &needle)
+        {
+            size_t n = 0;
+            for (size_t pos = html.find(needle); pos != std::string::npos; pos = html.find(needle, pos + 1))
+                ++n;
+            return n;
+        };
+        REQUIRE(count("QUxCVU0=") == 1);
+        REQUIRE(count("T1RIRVI=") == (smartphone ? 0u : 1u)); // the phone layout shows the top 10 only
+        REQUIRE(count("data-art=\"0\"") >= 2);
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+TEST_CASE("HtmlWriter escapes text and attributes and closes what is open", "[report]")
+{
+    const auto path = std::filesystem::temp_directory_path() / "fms_html_writer.html";
+    {
+        HtmlWriter w(path);
+        w.doctype();
+        w.open("body");
+        w.open("div", {{"class", "a\"b"}, {"title", "<&>"}});
+        w.element("span", {}, "Tom & \"Jerry\" <3");
+        w.empty("img", {{"data-art", "0"}});
+        w.rawElement("script", "if (a < b && c) {}");
+        REQUIRE(w.finish());
+    }
+    std::ifstream in(path, std::ios::binary);
+    const std::string html((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(html.rfind("\xef\xbb\xbf<!DOCTYPE html>", 0) == 0);
+    REQUIRE(html.find("<div class=\"a&quot;b\" title=\"&lt;&amp;&gt;\">") != std::string::npos);
+    REQUIRE(html.find("<span>Tom &amp; \"Jerry\" &lt;3</span>") != std::string::npos);
+    REQUIRE(html.find("<img data-art=\"0\">") != std::string::npos);
+    REQUIRE(html.find("<script>if (a < b && c) {}</script>") != std::string::npos);
+    REQUIRE(html.find("</div>\n</body>\n") != std::string::npos);
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+// Reference decoder for the base64 round trip
+static std::string base64Decode(const std::string &text)
+{
+    auto value = [](char c) -> int
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        return c == '+' ? 62 : c == '/' ? 63 : -1;
+    };
+    std::string out;
+    uint32_t bits = 0;
+    int count = 0;
+    for (char c : text)
+    {
+        const int v = value(c);
+        if (v < 0)
+            break; // padding
+        bits = (bits << 6) | static_cast<uint32_t>(v);
+        if ((count += 6) >= 8)
+        {
+            count -= 8;
+            out.push_back(static_cast<char>((bits >> count) & 0xff));
+        }
+    }
+    return out;
+}
+
+TEST_CASE("Base64 matches RFC 4648 and round-trips random data", "[base64]")
+{
+    auto encode = [](const std::string &s)
+    {
+        std::string out;
+        base64Append(out, s.data(), s.size());
+        return out;
+    };
+    REQUIRE(encode("") == "");
+    REQUIRE(encode("f") == "Zg==");
+    REQUIRE(encode("fo") == "Zm8=");
+    REQUIRE(encode("foo") == "Zm9v");
+    REQUIRE(encode("foob") == "Zm9vYg==");
+    REQUIRE(encode("fooba") == "Zm9vYmE=");
+    REQUIRE(encode("foobar") == "Zm9vYmFy");
+
+    // Lengths around the 12- and 24-byte vector steps, and every byte value
+    uint64_t state = 0x9e3779b97f4a7c15ULL;
+    auto next = [&]
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    };
+    for (int round = 0; round < 2000; ++round)
+    {
+        const size_t size = round < 100 ? static_cast<size_t>(round) : static_cast<size_t>(next() % 4096);
+        std::string data(size, '\0');
+        for (auto &c : data)
+            c = static_cast<char>(next());
+        const std::string text = encode(data);
+        std::string scalar(base64Length(size), '\0');
+        base64EncodeScalar(data.data(), size, &scalar[0]);
+        REQUIRE(text.size() == base64Length(size));
+        REQUIRE(text == scalar);
+        REQUIRE(base64Decode(text) == data);
+    }
+}
+
+TEST_CASE("Paged report embeds the tracks as escaped JSON", "[report]")
+{
+    std::vector<MonthlyEntry> entries;
+    entries.push_back({"2025", "crc0", "", "Quote \" and </script>", "Artist", "Album", 200.0, 5, 7, 1000.0});
+    entries.push_back({"2025", "crc1", "", "Second", "Artist", "Album", 200.0, 3, 0, 600.0});
+    std::map<std::string, std::string> art{{"crc1", "data:image/jpeg;base64,QUxCVU0="}};
+
+    const auto path = std::filesystem::temp_directory_path() / "fms_report_paged.html";
+    REQUIRE(ReportExporter::exportHtml("2025", entries, path.wstring(), art, ReportFormat::Paged).empty());
+    std::ifstream in(path, std::ios::binary);
+    const std::string html((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    REQUIRE(html.find("[\"Quote \\\" and \\u003c/script>\",\"Artist\",\"Album\",5,-2,-1]") != std::string::npos);
+    REQUIRE(html.find("[\"Second\",\"Artist\",\"Album\",3,3,0]") != std::string::npos);
+    REQUIRE(html.find("\"artists\": [\n[\"Artist\",8,-1]]") != std::string::npos);
+    REQUIRE(html.find("class=\"row\"") == std::string::npos); // rows are built by the script
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+}
+
+TEST_CASE("Batch export writes every report and an index linking them", "[report]")
+{
+    std::vector<BatchReport> reports;
+    for (int m = 1; m <= 12; ++m)
+    {
+        const std::string ym = addMonths("2025-01", m - 1);
+        BatchReport r{ym, "report_" + ym + ".html", {}};
+        for (int i = 0; i < m; ++i)
+            r.entries.push_back({ym + "-01", "crc" + std::to_string(i), "", "Track " + std::to_string(i),
+                                 "Artist", "Album", 200.0, m, 0, 1800.0});
+        reports.push_back(std::move(r));
+    }
+    std::map<std::string, std::string> art{{"crc0", "data:image/jpeg;base64,QUxCVU0="}};
+
+    const auto dir = std::filesystem::temp_directory_path() / "fms_report_batch";
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    std::filesystem::create_directories(dir);
+    REQUIRE(ReportExporter::exportBatch("2025", reports, (dir / "index.html").wstring(), art).empty());
+
+    auto read = [](const std::filesystem::path &path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    };
+    const std::string index = read(dir / "index.html");
+    for (const auto &r : reports)
+    {
+        REQUIRE(index.find("href=\"" + r.fileName + "\"") != std::string::npos);
+        const std::string html = read(dir / r.fileName);
+        REQUIRE(html.find("<title>" + r.label + "</title>") != std::string::npos);
+        REQUIRE(html.find("QUxCVU0=") != std::string::npos);
+    }
+    REQUIRE(index.find("12 tracks \xc2\xb7 6h 0m") != std::string::npos);
+
+    // A report that cannot be written is reported
+    reports[0].fileName = "missing/report.html";
+    REQUIRE_FALSE(ReportExporter::exportBatch("2025", reports, (dir / "index.html").wstring(), art).empty());
+    std::filesystem::remove_all(dir, ec);
+}
@@ -0,0 +1,23 @@
+#include "core.h"
+#include "thumbnail.h"
+
+namespace fms
+{
+
+    const char *sniffImageMime(const void *data, size_t size)
+    {
+        const auto *p = static_cast<const uint8_t *>(data);
+        if (size >= 3 && p[0] == 0xFF && p[1] == 0xD8 && p[2] == 0xFF)
+            return "image/jpeg";
+        if (size >= 8 && memcmp(p, "\x89PNG\r\n\x1a\n", 8) == 0)
+            return "image/png";
+        if (size >= 6 && (memcmp(p, "GIF87a", 6) == 0 || memcmp(p, "GIF89a", 6) == 0))
+            return "image/gif";
+        if (size >= 12 && memcmp(p, "RIFF", 4) == 0 && memcmp(p + 8, "WEBP", 4) == 0)
+            return "image/webp";
+        if (size >= 2 && p[0] == 'B' && p[1] == 'M')
+            return "image/bmp";
+        return nullptr;
+    }
+
+} // namespace fms
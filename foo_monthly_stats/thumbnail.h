@@ -0,0 +1,35 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // Album art thumbnails for the HTML report
+    // -----------------------------------------------------------------------
+
+    // MIME type from the image signature ("image/jpeg", "image/png", ...); nullptr if unknown
+    const char *sniffImageMime(const void *data, size_t size);
+
+    // -----------------------------------------------------------------------
+    // Thumbnailer – decodes a cover, fits it into maxEdge x maxEdge pixels and
+    // re-encodes it as JPEG (WIC, thumbnail_win.cpp). Holds a COM apartment and
+    // an imaging factory for the thread that created it: one per thread.
+    // -----------------------------------------------------------------------
+    class Thumbnailer
+    {
+    public:
+        Thumbnailer();
+        ~Thumbnailer();
+        Thumbnailer(const Thumbnailer &) = delete;
+        Thumbnailer &operator=(const Thumbnailer &) = delete;
+
+        // false if the image cannot be decoded; covers are never scaled up
+        bool makeJpeg(const void *data, size_t size, int maxEdge, std::vector<uint8_t> &jpeg);
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> m_impl;
+    };
+
+} // namespace fms
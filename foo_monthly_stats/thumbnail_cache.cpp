@@ -0,0 +1,231 @@
+#include "core.h"
+#include "thumbnail_cache.h"
+
+namespace fms
+{
+
+    // FNV-1a over the image bytes, plus the size against collisions
+    static std::string contentHash(const std::string &data)
+    {
+        uint64_t h = 0xcbf29ce484222325ULL;
+        for (unsigned char c : data)
+        {
+            h ^= c;
+            h *= 0x100000001b3ULL;
+        }
+        char hex[40];
+        snprintf(hex, sizeof(hex), "%016llx-%llx", (unsigned long long)h, (unsigned long long)data.size());
+        return hex;
+    }
+
+    ThumbnailCache &ThumbnailCache::get()
+    {
+        static ThumbnailCache instance;
+        return instance;
+    }
+
+    bool ThumbnailCache::open(const std::string &path)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (m_db)
+            return true;
+        if (sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: thumbnail cache open failed: " << sqlite3_errmsg(m_db);
+            sqlite3_close(m_db);
+            m_db = nullptr;
+            return false;
+        }
+        char *errmsg = nullptr;
+        sqlite3_exec(m_db,
+                     "PRAGMA journal_mode=WAL;"
+                     "PRAGMA synchronous=NORMAL;"
+                     "CREATE TABLE IF NOT EXISTS blob ("
+                     "  hash TEXT PRIMARY KEY,"
+                     "  mime TEXT NOT NULL,"
+                     "  data BLOB NOT NULL"
+                     ");"
+                     "CREATE TABLE IF NOT EXISTS thumb ("
+                     "  identity    TEXT NOT NULL,"
+                     "  edge        INTEGER NOT NULL,"
+                     "  source      TEXT NOT NULL,"
+                     "  source_size INTEGER NOT NULL,"
+                     "  source_time INTEGER NOT NULL,"
+                     "  hash        TEXT NOT NULL," // '' = no cover
+                     "  last_used   INTEGER NOT NULL,"
+                     "  PRIMARY KEY (identity, edge)"
+                     ");"
+                     "CREATE INDEX IF NOT EXISTS ix_thumb_used ON thumb(last_used);"
+                     "CREATE INDEX IF NOT EXISTS ix_thumb_hash ON thumb(hash);",
+                     nullptr, nullptr, &errmsg);
+        if (errmsg)
+        {
+            Log() << "foo_monthly_stats: thumbnail cache schema error: " << errmsg;
+            sqlite3_free(errmsg);
+        }
+
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db, "SELECT COALESCE(MAX(last_used), 0) FROM thumb", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                m_clock = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        return true;
+    }
+
+    void ThumbnailCache::close()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_db)
+            return;
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+
+    bool ThumbnailCache::find(const std::string &identity, int edge, Entry &entry)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_db)
+            return false;
+        sqlite3_stmt *stmt = nullptr;
+        const char *sql =
+            "SELECT t.source, t.source_size, t.source_time, COALESCE(b.mime, ''), b.data"
+            " FROM thumb t LEFT JOIN blob b ON b.hash = t.hash"
+            " WHERE t.identity = ? AND t.edge = ?";
+        if (sqlite3_prepare_v2(m_db, sql, -1, &stmt, nullptr) != SQLITE_OK)
+            return false;
+        sqlite3_bind_text(stmt, 1, identity.c_str(), -1, SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt, 2, edge);
+        bool found = false;
+        if (sqlite3_step(stmt) == SQLITE_ROW)
+        {
+            const char *source = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 0));
+            entry.source = source ? source : "";
+            entry.sourceSize = sqlite3_column_int64(stmt, 1);
+            entry.sourceTime = sqlite3_column_int64(stmt, 2);
+            entry.mime = reinterpret_cast<const char *>(sqlite3_column_text(stmt, 3));
+            const void *data = sqlite3_column_blob(stmt, 4);
+            entry.data.assign(static_cast<const char *>(data), data ? sqlite3_column_bytes(stmt, 4) : 0);
+            found = true;
+        }
+        sqlite3_finalize(stmt);
+
+        if (found && sqlite3_prepare_v2(m_db, "UPDATE thumb SET last_used = ? WHERE identity = ? AND edge = ?",
+                                        -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_int64(stmt, 1, ++m_clock);
+            sqlite3_bind_text(stmt, 2, identity.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 3, edge);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+        return found;
+    }
+
+    void ThumbnailCache::store(const std::string &identity, int edge, const Entry &entry)
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_db)
+            return;
+        const std::string hash = entry.mime.empty() ? std::string() : contentHash(entry.data);
+
+        sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr);
+        sqlite3_stmt *stmt = nullptr;
+        if (!hash.empty() &&
+            sqlite3_prepare_v2(m_db, "INSERT OR IGNORE INTO blob(hash, mime, data) VALUES(?,?,?)", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, hash.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, entry.mime.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_blob(stmt, 3, entry.data.data(), static_cast<int>(entry.data.size()), SQLITE_TRANSIENT);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+        if (sqlite3_prepare_v2(m_db,
+                               "INSERT OR REPLACE INTO thumb(identity, edge, source, source_size, source_time, hash, last_used)"
+                               " VALUES(?,?,?,?,?,?,?)",
+                               -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            sqlite3_bind_text(stmt, 1, identity.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 2, edge);
+            sqlite3_bind_text(stmt, 3, entry.source.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 4, entry.sourceSize);
+            sqlite3_bind_int64(stmt, 5, entry.sourceTime);
+            sqlite3_bind_text(stmt, 6, hash.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int64(stmt, 7, ++m_clock);
+            sqlite3_step(stmt);
+            sqlite3_finalize(stmt);
+        }
+        // A replaced thumb may have been the last user of its old blob; trim() collects it
+        if (sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr) != SQLITE_OK)
+        {
+            Log() << "foo_monthly_stats: thumbnail cache write error: " << sqlite3_errmsg(m_db);
+            sqlite3_exec(m_db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        }
+    }
+
+    int64_t ThumbnailCache::blobBytes()
+    {
+        int64_t total = 0;
+        sqlite3_stmt *stmt = nullptr;
+        if (sqlite3_prepare_v2(m_db, "SELECT COALESCE(SUM(LENGTH(data)), 0) FROM blob", -1, &stmt, nullptr) == SQLITE_OK)
+        {
+            if (sqlite3_step(stmt) == SQLITE_ROW)
+                total = sqlite3_column_int64(stmt, 0);
+            sqlite3_finalize(stmt);
+        }
+        return total;
+    }
+
+    int64_t ThumbnailCache::bytes()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        return m_db ? blobBytes() : 0;
+    }
+
+    void ThumbnailCache::trim()
+    {
+        std::lock_guard<std::mutex> lk(m_mutex);
+        if (!m_db)
+            return;
+        sqlite3_exec(m_db, "BEGIN;", nullptr, nullptr, nullptr);
+        // Blobs left behind by replaced thumbs
+        sqlite3_exec(m_db, "DELETE FROM blob WHERE hash NOT IN (SELECT hash FROM thumb)", nullptr, nullptr, nullptr);
+        int64_t total = blobBytes();
+        int evicted = 0;
+        if (total > m_capBytes)
+        {
+            // Oldest thumb first; its blob goes only with the last thumb using it
+            sqlite3_stmt *oldest = nullptr, *drop = nullptr, *orphan = nullptr;
+            sqlite3_prepare_v2(m_db, "SELECT rowid, hash FROM thumb ORDER BY last_used LIMIT 1", -1, &oldest, nullptr);
+            sqlite3_prepare_v2(m_db, "DELETE FROM thumb WHERE rowid = ?", -1, &drop, nullptr);
+            sqlite3_prepare_v2(m_db,
+                               "DELETE FROM blob WHERE hash = ?1 AND NOT EXISTS (SELECT 1 FROM thumb WHERE hash = ?1)"
+                               " RETURNING LENGTH(data)",
+                               -1, &orphan, nullptr);
+            while (oldest && drop && orphan && total > m_capBytes && sqlite3_step(oldest) == SQLITE_ROW)
+            {
+                const int64_t rowid = sqlite3_column_int64(oldest, 0);
+                const std::string hash = reinterpret_cast<const char *>(sqlite3_column_text(oldest, 1));
+                sqlite3_reset(oldest);
+
+                sqlite3_bind_int64(drop, 1, rowid);
+                sqlite3_step(drop);
+                sqlite3_reset(drop);
+                ++evicted;
+
+                sqlite3_bind_text(orphan, 1, hash.c_str(), -1, SQLITE_TRANSIENT);
+                while (sqlite3_step(orphan) == SQLITE_ROW)
+                    total -= sqlite3_column_int64(orphan, 0);
+                sqlite3_reset(orphan);
+            }
+            sqlite3_finalize(oldest);
+            sqlite3_finalize(drop);
+            sqlite3_finalize(orphan);
+        }
+        sqlite3_exec(m_db, "COMMIT;", nullptr, nullptr, nullptr);
+        if (evicted > 0)
+            Log() << "foo_monthly_stats: thumbnail cache evicted " << evicted << " entries (" << total / 1024 << " KiB kept)";
+    }
+
+} // namespace fms
@@ -0,0 +1,62 @@
+#pragma once
+#include "core.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // ThumbnailCache – report thumbnails kept across exports
+    //
+    // SQLite file next to the DB ("foo_monthly_stats_thumbs.db"). thumb rows
+    // map an album identity and thumbnail edge to the file the cover was read
+    // from (with its size and timestamp, so the caller can tell whether it
+    // changed) and to a content hash; the image bytes live once per hash in
+    // blob, so every track of an album and every size that produced the same
+    // bytes share them. Covers that were not found are cached too (no blob).
+    //
+    // Least recently used thumbs are evicted once the blobs exceed the cap
+    // (trim). Safe to call from several threads; every method is a no-op
+    // while the cache is closed.
+    // -----------------------------------------------------------------------
+    class ThumbnailCache
+    {
+    public:
+        static constexpr int64_t kDefaultCapBytes = 64LL * 1024 * 1024;
+
+        struct Entry
+        {
+            std::string source;      // file the cover came from
+            int64_t sourceSize = 0;  // its size and timestamp when it was read
+            int64_t sourceTime = 0;
+            std::string mime;        // empty: the album has no cover
+            std::string data;        // image bytes
+        };
+
+        explicit ThumbnailCache(int64_t capBytes = kDefaultCapBytes) : m_capBytes(capBytes) {}
+        ~ThumbnailCache() { close(); }
+
+        bool open(const std::string &path);
+        void close();
+
+        // Marks the thumb as used; false when absent
+        bool find(const std::string &identity, int edge, Entry &entry);
+        void store(const std::string &identity, int edge, const Entry &entry);
+
+        // Evicts least recently used thumbs until the blobs fit the cap
+        void trim();
+
+        // Total size of the cached image bytes
+        int64_t bytes();
+
+        static ThumbnailCache &get();
+
+    private:
+        int64_t blobBytes(); // m_mutex held
+
+        int64_t m_capBytes;
+        sqlite3 *m_db{nullptr};
+        int64_t m_clock{0}; // last_used counter: recency without wall-clock ties
+        std::mutex m_mutex;
+    };
+
+} // namespace fms
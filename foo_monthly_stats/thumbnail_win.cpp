@@ -0,0 +1,120 @@
+#include "stdafx.h"
+#include "thumbnail.h"
+
+#include <wincodec.h>
+
+namespace fms
+{
+
+    // WIC parts of thumbnail.h; sniffImageMime lives in thumbnail.cpp (core)
+
+    struct Thumbnailer::Impl
+    {
+        bool comInitialized = false;
+        CComPtr<IWICImagingFactory> factory;
+    };
+
+    Thumbnailer::Thumbnailer() : m_impl(std::make_unique<Impl>())
+    {
+        // S_FALSE: already initialized on this thread, still needs the matching CoUninitialize
+        HRESULT hr = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        m_impl->comInitialized = SUCCEEDED(hr);
+        if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                                    IID_PPV_ARGS(&m_impl->factory))))
+            m_impl->factory.Release();
+    }
+
+    Thumbnailer::~Thumbnailer()
+    {
+        m_impl->factory.Release();
+        if (m_impl->comInitialized)
+            CoUninitialize();
+    }
+
+    bool Thumbnailer::makeJpeg(const void *data, size_t size, int maxEdge, std::vector<uint8_t> &jpeg)
+    {
+        IWICImagingFactory *factory = m_impl->factory;
+        if (!factory || size == 0 || size > MAXDWORD || maxEdge <= 0)
+            return false;
+
+        // Decode the first frame straight from memory
+        CComPtr<IWICStream> input;
+        CComPtr<IWICBitmapDecoder> decoder;
+        CComPtr<IWICBitmapFrameDecode> frame;
+        if (FAILED(factory->CreateStream(&input)) ||
+            FAILED(input->InitializeFromMemory(static_cast<BYTE *>(const_cast<void *>(data)), static_cast<DWORD>(size))) ||
+            FAILED(factory->CreateDecoderFromStream(input, nullptr, WICDecodeMetadataCacheOnDemand, &decoder)) ||
+            FAILED(decoder->GetFrame(0, &frame)))
+            return false;
+
+        UINT width = 0, height = 0;
+        if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0)
+            return false;
+        const UINT edge = static_cast<UINT>(maxEdge);
+        UINT outWidth = width, outHeight = height;
+        if (width > edge || height > edge)
+        {
+            if (width >= height)
+            {
+                outWidth = edge;
+                outHeight = (std::max)(1u, static_cast<UINT>(static_cast<uint64_t>(height) * edge / width));
+            }
+            else
+            {
+                outHeight = edge;
+                outWidth = (std::max)(1u, static_cast<UINT>(static_cast<uint64_t>(width) * edge / height));
+            }
+        }
+
+        // Fant averages every source pixel into the target: a box filter, cheap for
+        // large reduction ratios, and WIC runs it with its vectorized code paths
+        CComPtr<IWICBitmapScaler> scaler;
+        CComPtr<IWICFormatConverter> converter;
+        if (FAILED(factory->CreateBitmapScaler(&scaler)) ||
+            FAILED(scaler->Initialize(frame, outWidth, outHeight, WICBitmapInterpolationModeFant)) ||
+            FAILED(factory->CreateFormatConverter(&converter)) ||
+            FAILED(converter->Initialize(scaler, GUID_WICPixelFormat24bppBGR, WICBitmapDitherTypeNone, nullptr, 0.0,
+                                         WICBitmapPaletteTypeCustom)))
+            return false;
+
+        // Encode to a growable memory stream
+        CComPtr<IStream> output;
+        CComPtr<IWICBitmapEncoder> encoder;
+        CComPtr<IWICBitmapFrameEncode> target;
+        CComPtr<IPropertyBag2> options;
+        if (FAILED(CreateStreamOnHGlobal(nullptr, TRUE, &output)) ||
+            FAILED(factory->CreateEncoder(GUID_ContainerFormatJpeg, nullptr, &encoder)) ||
+            FAILED(encoder->Initialize(output, WICBitmapEncoderNoCache)) ||
+            FAILED(encoder->CreateNewFrame(&target, &options)))
+            return false;
+
+        PROPBAG2 quality = {};
+        quality.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+        VARIANT value;
+        VariantInit(&value);
+        value.vt = VT_R4;
+        value.fltVal = 0.85f;
+        options->Write(1, &quality, &value);
+
+        WICPixelFormatGUID format = GUID_WICPixelFormat24bppBGR;
+        if (FAILED(target->Initialize(options)) ||
+            FAILED(target->SetSize(outWidth, outHeight)) ||
+            FAILED(target->SetPixelFormat(&format)) ||
+            FAILED(target->WriteSource(converter, nullptr)) ||
+            FAILED(target->Commit()) ||
+            FAILED(encoder->Commit()))
+            return false;
+
+        STATSTG stat = {};
+        HGLOBAL memory = nullptr;
+        if (FAILED(output->Stat(&stat, STATFLAG_NONAME)) || FAILED(GetHGlobalFromStream(output, &memory)))
+            return false;
+        const void *bytes = GlobalLock(memory);
+        if (!bytes)
+            return false;
+        jpeg.assign(static_cast<const uint8_t *>(bytes), static_cast<const uint8_t *>(bytes) + stat.cbSize.QuadPart);
+        GlobalUnlock(memory);
+        return true;
+    }
+
+} // namespace fms
@@ -0,0 +1,116 @@
+#include "stdafx.h"
+#include "track_meta_cache.h"
+
+namespace fms
+{
+
+    // CRC64 – must match db_manager.cpp's implementation
+    static uint64_t crc64(const char *data, size_t len)
+    {
+        static const uint64_t POLY = 0xad93d23594c935a9ULL;
+        uint64_t crc = 0;
+        for (size_t i = 0; i < len; ++i)
+        {
+            crc ^= static_cast<uint8_t>(data[i]);
+            for (int j = 0; j < 8; ++j)
+            {
+                if (crc & 1)
+                    crc = (crc >> 1) ^ POLY;
+                else
+                    crc >>= 1;
+            }
+        }
+        return crc;
+    }
+
+    static const char *metaOrEmpty(const file_info &fi, const char *name)
+    {
+        const char *value = fi.meta_get(name, 0);
+        return value ? value : "";
+    }
+
+    TrackMetaCache &TrackMetaCache::get()
+    {
+        static TrackMetaCache instance;
+        return instance;
+    }
+
+    bool TrackMetaCache::fill(const metadb_handle_ptr &track, TrackInfo &ti)
+    {
+        auto it = m_index.find(track.get_ptr());
+        if (it != m_index.end())
+        {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+        }
+        else
+        {
+            // Shared, immutable info of the metadb: no file_info copy
+            metadb_info_container::ptr info;
+            if (!track->get_info_ref(info))
+                return false;
+            const file_info &fi = info->info();
+
+            const char *path = track->get_path();
+            char crcHex[17];
+            snprintf(crcHex, sizeof(crcHex), "%016llx", (unsigned long long)crc64(path, strlen(path)));
+
+            m_lru.push_front(Entry{track, crcHex, path, metaOrEmpty(fi, "TITLE"), metaOrEmpty(fi, "ARTIST"),
+                                   metaOrEmpty(fi, "ALBUM")});
+            m_index[track.get_ptr()] = m_lru.begin();
+            while (m_lru.size() > m_capacity)
+            {
+                m_index.erase(m_lru.back().handle.get_ptr());
+                m_lru.pop_back();
+            }
+        }
+
+        const Entry &e = m_lru.front();
+        ti.track_crc = e.track_crc;
+        ti.path = e.path;
+        ti.title = e.title;
+        ti.artist = e.artist;
+        ti.album = e.album;
+        return true;
+    }
+
+    void TrackMetaCache::invalidate(metadb_handle_list_cref tracks)
+    {
+        for (t_size i = 0; i < tracks.get_count(); ++i)
+        {
+            auto it = m_index.find(tracks[i].get_ptr());
+            if (it == m_index.end())
+                continue;
+            m_lru.erase(it->second);
+            m_index.erase(it);
+        }
+    }
+
+    void TrackMetaCache::clear()
+    {
+        m_index.clear();
+        m_lru.clear();
+    }
+
+    // ---------------------------------------------------------------------------
+    // Invalidation and shutdown
+    // ---------------------------------------------------------------------------
+    class TrackMetaInvalidator : public metadb_io_callback
+    {
+    public:
+        void on_changed_sorted(metadb_handle_list_cref items, bool fromHook) override
+        {
+            if (!fromHook) // hooks only change display formatting, not tags
+                TrackMetaCache::get().invalidate(items);
+        }
+    };
+
+    class TrackMetaCacheQuit : public initquit
+    {
+    public:
+        void on_quit() override { TrackMetaCache::get().clear(); }
+    };
+
+    static service_factory_single_t<TrackMetaInvalidator> g_trackMetaInvalidator;
+    static initquit_factory_t<TrackMetaCacheQuit> g_trackMetaCacheQuit;
+
+} // namespace fms
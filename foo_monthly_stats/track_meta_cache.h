@@ -0,0 +1,49 @@
+#pragma once
+#include "stdafx.h"
+#include "db_manager.h"
+
+namespace fms
+{
+
+    // -----------------------------------------------------------------------
+    // TrackMetaCache – LRU of the TrackInfo fields derived from a track
+    //
+    // Keyed by metadb handle: path, path CRC and TITLE/ARTIST/ALBUM are read
+    // and computed once, then reused by every play/stop event of the track
+    // (repeats, gapless albums, stop/start) while it stays in the cache.
+    // Entries are dropped when metadb_io_callback reports changed tags.
+    // Main thread only, like the playback and metadb callbacks that use it.
+    // -----------------------------------------------------------------------
+    class TrackMetaCache
+    {
+    public:
+        explicit TrackMetaCache(size_t capacity = 256) : m_capacity(capacity) {}
+
+        // Fills track_crc, path, title, artist and album of ti; false if the track has no info
+        bool fill(const metadb_handle_ptr &track, TrackInfo &ti);
+
+        // Tags of these tracks changed
+        void invalidate(metadb_handle_list_cref tracks);
+
+        // Releases every handle (on_quit)
+        void clear();
+
+        static TrackMetaCache &get();
+
+    private:
+        struct Entry
+        {
+            metadb_handle_ptr handle; // keeps the key pointer from being reused
+            std::string track_crc;
+            std::string path;
+            std::string title;
+            std::string artist;
+            std::string album;
+        };
+
+        size_t m_capacity;
+        std::list<Entry> m_lru; // most recently used first
+        std::unordered_map<const metadb_handle *, std::list<Entry>::iterator> m_index;
+    };
+
+} // namespace fms